@@ -0,0 +1,345 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "adaptive_sampler.h"
+#include "aggregate.h"
+#include "alarm.h"
+#include "app_config.h"
+#include "app_publish.h"
+#include "mqtt_client.h"
+#include "nvs.h"
+#include "publisher.h"
+#include "sample_filter.h"
+#include "sample_seq.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// MICROBENCHMARKS DO CAMINHO QUENTE
+//
+// Mede ns/op e alocações/op de cada função que roda por leitura ou por requisição, sobre os mocks de
+// host/mock. Cada caso roda até somar BENCH_MIN_NS; o resultado é a melhor de BENCH_ROUNDS rodadas.
+// Os números servem para comparar commits na mesma máquina, não para prever o tempo no ESP32.
+// -----------------------------------------------------------------------------------------------------------
+
+#define BENCH_MIN_NS   (50 * 1000 * 1000LL)
+#define BENCH_ROUNDS   5
+
+static volatile uint32_t s_sink;   // impede que o compilador descarte os resultados
+
+// -----------------------------------------------------------------------------------------------------------
+// CONTAGEM DE ALOCAÇÕES (-Wl,--wrap, ver CMakeLists.txt)
+// -----------------------------------------------------------------------------------------------------------
+
+static uint64_t s_allocs = 0;
+static uint64_t s_alloc_bytes = 0;
+
+#if BENCH_COUNT_ALLOCS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+  s_allocs++;
+  s_alloc_bytes += size;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+  s_allocs++;
+  s_alloc_bytes += n * size;
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+  s_allocs++;
+  s_alloc_bytes += size;
+  return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+  __real_free(ptr);
+}
+#endif
+
+// -----------------------------------------------------------------------------------------------------------
+// CASOS
+// -----------------------------------------------------------------------------------------------------------
+
+static const char *const CONFIG_BODY =
+  "mode=raw&window=60&interval_min=2000&interval_max=60000&mqtt=5&delivery=seq&low_power=0"
+  "&sleep=60&pool_slots=96&t_max=350&t_min=off&t_rate=20&u_max=900&u_min=100&u_rate=off";
+
+static char s_topic[64];
+static const char *const s_topics[] = { s_topic, s_topic };
+static app_config_t s_cfg;
+static app_change_filter_t s_filter;
+static welford_t s_welford;
+static adaptive_sampler_t s_sampler;
+static alarm_t s_alarm;
+static sample_filter_t s_sample_filter;
+
+// Série de leituras plausível: rampa lenta com ruído de ±0,2
+static int16_t reading(uint32_t i)
+{
+  return 250 + (int16_t)((i / 64) % 50) + (int16_t)(i * 2654435761u >> 30) - 2;
+}
+
+// Mesma série com um pico de +20,0 a cada 97 leituras, como os que o AM2301 devolve com checksum válido
+static int16_t reading_spiky(uint32_t i)
+{
+  return reading(i) + (i % 97 == 0 ? 200 : 0);
+}
+
+static void bench_form_value(uint32_t iters)
+{
+  char value[16];
+  for (uint32_t i = 0; i < iters; i++) {
+    s_sink += app_form_value(CONFIG_BODY, "u_rate", value, sizeof(value));
+  }
+}
+
+static void bench_config_parse(uint32_t iters)
+{
+  const char *error;
+  for (uint32_t i = 0; i < iters; i++) {
+    s_sink += app_config_parse_form(&s_cfg, CONFIG_BODY, 2000, &error);
+  }
+}
+
+static void bench_config_json(uint32_t iters)
+{
+  char buf[384];
+  for (uint32_t i = 0; i < iters; i++) {
+    s_sink += app_config_format_json(&s_cfg, buf, sizeof(buf));
+  }
+}
+
+static void bench_config_save_load(uint32_t iters)
+{
+  for (uint32_t i = 0; i < iters; i++) {
+    app_config_save(&s_cfg, 1);
+    app_config_load(&s_cfg, 1, 2000);
+  }
+  s_sink += nvs_mock_commits();
+}
+
+static void bench_format_tenths(uint32_t iters)
+{
+  char buf[APP_TENTHS_MAX_LEN];
+  for (uint32_t i = 0; i < iters; i++) {
+    s_sink += app_format_tenths(reading(i) - 300, buf);
+  }
+}
+
+// Referência: o que publish_sample() fazia antes de app_format_tenths()
+static void bench_format_tenths_printf(uint32_t iters)
+{
+  char buf[16];
+  for (uint32_t i = 0; i < iters; i++) {
+    s_sink += sprintf(buf, "%.1f", (reading(i) - 300) / 10.0f);
+  }
+}
+
+static void bench_append_stamps(uint32_t iters)
+{
+  char buf[APP_TENTHS_MAX_LEN + APP_STAMPS_MAX_LEN];
+  app_stamps_t stamps = { 1767225600000LL, 1767225600004LL, 3600 };
+  for (uint32_t i = 0; i < iters; i++) {
+    int len = app_format_tenths(reading(i), buf);
+    stamps.enqueued_ms += i & 3;
+    s_sink += app_append_stamps(buf, sizeof(buf), len, &stamps);
+  }
+}
+
+static void bench_format_topic(uint32_t iters)
+{
+  char buf[64];
+  for (uint32_t i = 0; i < iters; i++) {
+    s_sink += app_format_topic(buf, sizeof(buf), "24:6F:28:AA:BB:CC", "temperatura");
+  }
+}
+
+static void bench_change_filter(uint32_t iters)
+{
+  for (uint32_t i = 0; i < iters; i++) {
+    s_sink += app_change_filter_update(&s_filter, i & 1, reading(i));
+  }
+}
+
+static void bench_publish_qos1(uint32_t iters)
+{
+  char msg[APP_TENTHS_MAX_LEN];
+  for (uint32_t i = 0; i < iters; i++) {
+    size_t len = app_format_tenths(reading(i), msg);
+    int msg_id = publisher_publish(s_topic, msg, len, 1, 0);
+    publisher_on_published(msg_id);
+  }
+}
+
+static void bench_sample_seq(uint32_t iters)
+{
+  for (uint32_t i = 0; i < iters; i++) {
+    s_sink += sample_seq_publish(i & 1, reading(i), NULL);
+  }
+}
+
+static void bench_welford_add(uint32_t iters)
+{
+  for (uint32_t i = 0; i < iters; i++) {
+    welford_add(&s_welford, reading(i));
+  }
+  s_sink += s_welford.count;
+}
+
+static void bench_aggregate_format(uint32_t iters)
+{
+  char buf[96];
+  for (uint32_t i = 0; i < iters; i++) {
+    s_sink += aggregate_format(&s_welford, i & 7, buf, sizeof(buf));
+  }
+}
+
+static void bench_adaptive_update(uint32_t iters)
+{
+  for (uint32_t i = 0; i < iters; i++) {
+    s_sink += adaptive_update(&s_sampler, i * 2000, reading(i), 600 - reading(i));
+  }
+}
+
+static void bench_alarm_eval(uint32_t iters)
+{
+  alarm_event_t events[ALARM_KINDS];
+  for (uint32_t i = 0; i < iters; i++) {
+    s_sink += alarm_eval(&s_alarm, (int64_t)i * 2000, reading(i), events);
+  }
+}
+
+static void bench_sample_filter(uint32_t iters, sample_filter_config_t cfg)
+{
+  for (uint32_t i = 0; i < iters; i++) {
+    int16_t value = reading_spiky(i);
+    s_sink += sample_filter_apply(&s_sample_filter, &cfg, &value) + value;
+  }
+}
+
+static void bench_sample_filter_hampel(uint32_t iters)
+{
+  bench_sample_filter(iters, (sample_filter_config_t) SAMPLE_FILTER_CONFIG_DEFAULT());
+}
+
+static void bench_sample_filter_full(uint32_t iters)
+{
+  sample_filter_config_t cfg = { .window = SAMPLE_FILTER_MAX_WINDOW, .median = 1, .hampel_k = 3, .ema_shift = 2 };
+  bench_sample_filter(iters, cfg);
+}
+
+static void bench_sample_filter_ema(uint32_t iters)
+{
+  sample_filter_config_t cfg = { .window = 1, .ema_shift = 2 };
+  bench_sample_filter(iters, cfg);
+}
+
+typedef struct {
+  const char *name;
+  void (*fn)(uint32_t iters);
+} bench_case_t;
+
+static const bench_case_t s_cases[] = {
+  { "app_form_value", bench_form_value },
+  { "app_config_parse_form", bench_config_parse },
+  { "app_config_format_json", bench_config_json },
+  { "app_config_save+load", bench_config_save_load },
+  { "app_format_tenths", bench_format_tenths },
+  { "sprintf(\"%.1f\")", bench_format_tenths_printf },
+  { "app_append_stamps", bench_append_stamps },
+  { "app_format_topic", bench_format_topic },
+  { "app_change_filter_update", bench_change_filter },
+  { "publisher_publish(qos1)", bench_publish_qos1 },
+  { "sample_seq_publish", bench_sample_seq },
+  { "welford_add", bench_welford_add },
+  { "aggregate_format", bench_aggregate_format },
+  { "adaptive_update", bench_adaptive_update },
+  { "alarm_eval", bench_alarm_eval },
+  { "sample_filter(hampel 5)", bench_sample_filter_hampel },
+  { "sample_filter(9+mediana+ema)", bench_sample_filter_full },
+  { "sample_filter(ema)", bench_sample_filter_ema },
+};
+
+// -----------------------------------------------------------------------------------------------------------
+// EXECUÇÃO
+// -----------------------------------------------------------------------------------------------------------
+
+static int64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void setup(void)
+{
+  app_config_defaults(&s_cfg);
+  app_change_filter_reset(&s_filter);
+  welford_reset(&s_welford);
+
+  adaptive_config_t sampler_cfg = ADAPTIVE_CONFIG_DEFAULT();
+  adaptive_init(&s_sampler, &sampler_cfg);
+
+  alarm_config_t alarm_cfg = { 280, 220, 20, 5 };
+  alarm_init(&s_alarm, &alarm_cfg);
+  sample_filter_reset(&s_sample_filter);
+
+  nvs_mock_reset();
+  app_format_topic(s_topic, sizeof(s_topic), "24:6F:28:AA:BB:CC", "temperatura");
+  publisher_init(mqtt_mock_client(), MQTT_PROTOCOL_V_3_1_1);
+  publisher_on_connected();
+  sample_seq_init(1, s_topics, 2);
+}
+
+static void run(const bench_case_t *c)
+{
+  // Calibra: dobra as iterações até a rodada passar de BENCH_MIN_NS
+  uint32_t iters = 1;
+  for (;;) {
+    int64_t start = now_ns();
+    c->fn(iters);
+    if (now_ns() - start >= BENCH_MIN_NS || iters >= (1u << 30)) break;
+    iters *= 2;
+  }
+
+  double best_ns = 0;
+  uint64_t allocs = s_allocs, bytes = s_alloc_bytes;
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    int64_t start = now_ns();
+    c->fn(iters);
+    double ns = (double)(now_ns() - start) / iters;
+    if (round == 0 || ns < best_ns) best_ns = ns;
+  }
+  double ops = (double)iters * BENCH_ROUNDS;
+
+  printf("%-28s %12.1f %12.3f %12.1f %12" PRIu32 "\n", c->name, best_ns,
+         (s_allocs - allocs) / ops, (s_alloc_bytes - bytes) / ops, iters);
+}
+
+int main(int argc, char **argv)
+{
+  const char *filter = argc > 1 ? argv[1] : NULL;
+
+  setup();
+#if !BENCH_COUNT_ALLOCS
+  fprintf(stderr, "aviso: alocações não são contadas nesta plataforma\n");
+#endif
+  printf("%-28s %12s %12s %12s %12s\n", "caso", "ns/op", "allocs/op", "bytes/op", "iterações");
+  for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+    if (filter && strstr(s_cases[i].name, filter) == NULL) continue;
+    run(&s_cases[i]);
+  }
+  printf("(sink %" PRIu32 ")\n", s_sink);
+  return 0;
+}
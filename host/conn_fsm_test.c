@@ -0,0 +1,351 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "conn_fsm.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// TESTE DA MÁQUINA DE CONECTIVIDADE
+//
+// Roda o conn_fsm.c do firmware contra um conn_ops_t falso que só registra as chamadas: o timer guarda o
+// atraso pedido e a geração em que foi armado, e disparar o timer é chamar conn_fsm_timer_fired() com
+// ela, como faz o conn_timer_cb do main.c. O sorteio é um xorshift fixo, ou um valor forçado para testar
+// os extremos do jitter. Confere transições, limites do backoff, orçamentos de tentativas, fallback e
+// desmontagem do AP e o descarte de disparos de timers já parados ou reprogramados.
+//
+//   ./build-host/conn_fsm_test   (ou ctest --test-dir build-host)
+// Sai com 1 se alguma verificação falhar.
+// -----------------------------------------------------------------------------------------------------------
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                \
+  do {                                  \
+    if (!(cond)) {                      \
+      printf("FALHOU: " __VA_ARGS__);   \
+      printf("\n");                     \
+      s_failures++;                     \
+    }                                   \
+  } while (0)
+
+// -----------------------------------------------------------------------------------------------------------
+// conn_ops_t FALSO
+// -----------------------------------------------------------------------------------------------------------
+
+typedef struct {
+  uint32_t wifi_connect;
+  uint32_t wifi_disconnect;
+  uint32_t ap_start;
+  uint32_t ap_stop;
+  uint32_t mqtt_connect;
+  uint32_t timer_starts;
+  bool timer_armed;
+  uint32_t timer_ms;
+  uint32_t timer_gen;
+  bool random_forced;
+  uint32_t random_value;
+  uint32_t rng;
+  conn_state_t last_from;
+  conn_state_t last_to;
+} fake_t;
+
+static fake_t s_fake;
+static conn_fsm_t s_fsm;
+
+static void fake_wifi_connect(void) { s_fake.wifi_connect++; }
+static void fake_wifi_disconnect(void) { s_fake.wifi_disconnect++; }
+static void fake_ap_start(void) { s_fake.ap_start++; }
+static void fake_ap_stop(void) { s_fake.ap_stop++; }
+static void fake_mqtt_connect(void) { s_fake.mqtt_connect++; }
+
+static void fake_timer_start(uint32_t ms)
+{
+  s_fake.timer_starts++;
+  s_fake.timer_armed = true;
+  s_fake.timer_ms = ms;
+  s_fake.timer_gen = s_fsm.timer_gen;
+}
+
+static void fake_timer_stop(void)
+{
+  s_fake.timer_armed = false;
+}
+
+static uint32_t fake_random(void)
+{
+  if (s_fake.random_forced) return s_fake.random_value;
+  s_fake.rng ^= s_fake.rng << 13;
+  s_fake.rng ^= s_fake.rng >> 17;
+  s_fake.rng ^= s_fake.rng << 5;
+  return s_fake.rng;
+}
+
+static void fake_on_transition(const conn_fsm_t *fsm, conn_state_t from, conn_state_t to)
+{
+  s_fake.last_from = from;
+  s_fake.last_to = to;
+}
+
+static const conn_ops_t fake_ops = {
+  .wifi_connect = fake_wifi_connect,
+  .wifi_disconnect = fake_wifi_disconnect,
+  .ap_start = fake_ap_start,
+  .ap_stop = fake_ap_stop,
+  .mqtt_connect = fake_mqtt_connect,
+  .timer_start = fake_timer_start,
+  .timer_stop = fake_timer_stop,
+  .random = fake_random,
+  .on_transition = fake_on_transition,
+};
+
+static void reset(uint32_t spread_ms)
+{
+  memset(&s_fake, 0, sizeof(s_fake));
+  s_fake.rng = 0x2545F491;
+  conn_fsm_init(&s_fsm, &fake_ops);
+  s_fsm.spread_ms = spread_ms;
+}
+
+// O timer armado vence: o callback posta a geração atual e o event loop entrega
+static void fire_timer(void)
+{
+  CHECK(s_fake.timer_armed, "timer disparado sem estar armado (estado %s)", conn_state_name(s_fsm.state));
+  s_fake.timer_armed = false;
+  conn_fsm_timer_fired(&s_fsm, s_fake.timer_gen);
+}
+
+static uint32_t backoff_cap(uint32_t attempt)
+{
+  uint64_t delay = (uint64_t)CONN_BACKOFF_BASE_MS << (attempt < 16 ? attempt : 16);
+  return delay > CONN_BACKOFF_MAX_MS ? CONN_BACKOFF_MAX_MS : (uint32_t)delay;
+}
+
+static void expect_state(const char *step, conn_state_t state)
+{
+  CHECK(s_fsm.state == state, "%s: estado %s, esperado %s", step, conn_state_name(s_fsm.state),
+        conn_state_name(state));
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// CASOS
+// -----------------------------------------------------------------------------------------------------------
+
+static void test_backoff_bounds(void)
+{
+  static const uint32_t randoms[] = { 0, 1, 499, 500, 501, 29999, 30000, 30001, 0x7FFFFFFF, UINT32_MAX };
+
+  for (uint32_t attempt = 0; attempt < 40; attempt++) {
+    uint32_t d = backoff_cap(attempt);
+    for (size_t i = 0; i < sizeof(randoms) / sizeof(randoms[0]); i++) {
+      uint32_t ms = conn_backoff_ms(attempt, randoms[i]);
+      CHECK(ms >= d / 2 && ms <= d, "backoff(%" PRIu32 ", %" PRIu32 ") = %" PRIu32 ", fora de [%" PRIu32
+            ", %" PRIu32 "]", attempt, randoms[i], ms, d / 2, d);
+    }
+    // Os dois extremos do equal jitter são alcançáveis
+    CHECK(conn_backoff_ms(attempt, 0) == d / 2, "backoff(%" PRIu32 ") mínimo", attempt);
+    CHECK(conn_backoff_ms(attempt, d / 2) == d, "backoff(%" PRIu32 ") máximo", attempt);
+  }
+  CHECK(backoff_cap(6) == CONN_BACKOFF_MAX_MS, "teto de 60 s a partir da 7ª tentativa");
+  CHECK(conn_backoff_ms(UINT32_MAX, UINT32_MAX) <= CONN_BACKOFF_MAX_MS, "teto com tentativa enorme");
+}
+
+static void test_boot(void)
+{
+  reset(0);
+  expect_state("init", CONN_IDLE);
+  conn_fsm_handle(&s_fsm, CONN_EV_START);
+  expect_state("start sem espalhamento", CONN_STA_CONNECTING);
+  CHECK(s_fake.wifi_connect == 1, "start: wifi_connect %" PRIu32, s_fake.wifi_connect);
+  CHECK(s_fake.timer_ms == CONN_STA_CONNECT_TIMEOUT_MS, "start: timeout do STA %" PRIu32, s_fake.timer_ms);
+
+  // START repetido não reinicia nada
+  conn_fsm_handle(&s_fsm, CONN_EV_START);
+  CHECK(s_fake.wifi_connect == 1 && s_fsm.transitions == 1, "start repetido");
+
+  // Com espalhamento o boot espera em STA_BACKOFF até spread_ms
+  for (uint32_t seed = 1; seed <= 64; seed++) {
+    reset(CONN_SPREAD_MS);
+    s_fake.rng = seed * 0x9E3779B9u;
+    conn_fsm_handle(&s_fsm, CONN_EV_START);
+    if (s_fsm.backoff_ms == 0) {
+      expect_state("start com espalhamento 0", CONN_STA_CONNECTING);
+      continue;
+    }
+    expect_state("start com espalhamento", CONN_STA_BACKOFF);
+    CHECK(s_fake.timer_ms <= CONN_SPREAD_MS, "espalhamento %" PRIu32 " > %d", s_fake.timer_ms, CONN_SPREAD_MS);
+    CHECK(s_fake.wifi_connect == 0, "espalhamento: conectou antes do timer");
+    fire_timer();
+    expect_state("fim do espalhamento", CONN_STA_CONNECTING);
+  }
+}
+
+static void test_sta_budget_and_ap(void)
+{
+  reset(0);
+  conn_fsm_handle(&s_fsm, CONN_EV_START);
+
+  // CONN_STA_RETRY_BUDGET - 1 falhas ficam no backoff exponencial, alternando timeout e desconexão
+  for (uint32_t n = 1; n < CONN_STA_RETRY_BUDGET; n++) {
+    if (n % 2) {
+      fire_timer();
+      CHECK(s_fake.wifi_disconnect == (n + 1) / 2, "timeout %" PRIu32 " do STA sem wifi_disconnect", n);
+    } else {
+      conn_fsm_handle(&s_fsm, CONN_EV_STA_DISCONNECTED);
+    }
+    expect_state("falha do STA", CONN_STA_BACKOFF);
+    CHECK(s_fsm.sta_attempts == n, "sta_attempts %" PRIu32 ", esperado %" PRIu32, s_fsm.sta_attempts, n);
+    uint32_t d = backoff_cap(n - 1);
+    CHECK(s_fake.timer_ms >= d / 2 && s_fake.timer_ms <= d, "backoff do STA %" PRIu32 ": %" PRIu32 " ms", n,
+          s_fake.timer_ms);
+    CHECK(s_fake.ap_start == 0, "AP antes do orçamento esgotar");
+    fire_timer();
+    expect_state("nova tentativa do STA", CONN_STA_CONNECTING);
+  }
+
+  // A falha que esgota o orçamento sobe o AP
+  uint32_t disconnects = s_fake.wifi_disconnect;
+  conn_fsm_handle(&s_fsm, CONN_EV_STA_DISCONNECTED);
+  expect_state("orçamento do STA esgotado", CONN_AP_FALLBACK);
+  CHECK(s_fsm.sta_attempts == CONN_STA_RETRY_BUDGET, "fallback com %" PRIu32 " tentativas", s_fsm.sta_attempts);
+  CHECK(s_fake.ap_start == 1 && s_fsm.ap_active, "fallback sem ap_start");
+  CHECK(s_fake.wifi_disconnect == disconnects + 1, "fallback sem wifi_disconnect");
+  CHECK(s_fake.timer_ms == CONN_AP_RETRY_MS, "fallback: timer %" PRIu32, s_fake.timer_ms);
+
+  // No fallback o STA continua sendo tentado a cada CONN_AP_RETRY_MS, sem subir o AP de novo
+  for (int i = 0; i < 3; i++) {
+    fire_timer();
+    expect_state("tentativa no fallback", CONN_STA_CONNECTING);
+    fire_timer();
+    expect_state("falha no fallback", CONN_AP_FALLBACK);
+    CHECK(s_fake.timer_ms == CONN_AP_RETRY_MS, "fallback: timer %" PRIu32, s_fake.timer_ms);
+  }
+  CHECK(s_fake.ap_start == 1, "ap_start chamado %" PRIu32 " vezes", s_fake.ap_start);
+
+  // Credenciais novas antecipam a tentativa
+  conn_fsm_handle(&s_fsm, CONN_EV_RETRY);
+  expect_state("retry no fallback", CONN_STA_CONNECTING);
+
+  // IP + MQTT: o AP só cai quando a sessão MQTT abre
+  conn_fsm_handle(&s_fsm, CONN_EV_GOT_IP);
+  expect_state("got_ip", CONN_MQTT_CONNECTING);
+  CHECK(s_fsm.sta_attempts == 0, "got_ip não zerou sta_attempts");
+  CHECK(s_fake.mqtt_connect == 1 && s_fake.timer_ms == CONN_MQTT_CONNECT_TIMEOUT_MS, "got_ip sem mqtt_connect");
+  CHECK(s_fake.ap_stop == 0 && s_fsm.ap_active, "AP desmontado antes do MQTT");
+  conn_fsm_handle(&s_fsm, CONN_EV_MQTT_CONNECTED);
+  expect_state("mqtt conectado", CONN_ONLINE);
+  CHECK(s_fake.ap_stop == 1 && !s_fsm.ap_active, "AP não desmontado no ONLINE");
+  CHECK(!s_fake.timer_armed, "timer armado no ONLINE");
+  CHECK(s_fsm.entered[CONN_AP_FALLBACK] == 4, "entered[ap_fallback] %" PRIu32, s_fsm.entered[CONN_AP_FALLBACK]);
+}
+
+static void go_online(uint32_t spread_ms)
+{
+  reset(0);
+  conn_fsm_handle(&s_fsm, CONN_EV_START);
+  conn_fsm_handle(&s_fsm, CONN_EV_GOT_IP);
+  conn_fsm_handle(&s_fsm, CONN_EV_MQTT_CONNECTED);
+  s_fsm.spread_ms = spread_ms;
+  expect_state("online", CONN_ONLINE);
+}
+
+static void test_mqtt_budget(void)
+{
+  go_online(0);
+
+  // Queda do ONLINE e timeouts seguidos do MQTT
+  conn_fsm_handle(&s_fsm, CONN_EV_MQTT_DISCONNECTED);
+  for (uint32_t n = 1; n < CONN_MQTT_RETRY_BUDGET; n++) {
+    expect_state("falha do MQTT", CONN_MQTT_BACKOFF);
+    CHECK(s_fsm.mqtt_attempts == n, "mqtt_attempts %" PRIu32 ", esperado %" PRIu32, s_fsm.mqtt_attempts, n);
+    uint32_t d = backoff_cap(n - 1);
+    CHECK(s_fake.timer_ms >= d / 2 && s_fake.timer_ms <= d, "backoff do MQTT %" PRIu32 ": %" PRIu32 " ms", n,
+          s_fake.timer_ms);
+    fire_timer();
+    expect_state("nova tentativa do MQTT", CONN_MQTT_CONNECTING);
+    fire_timer();
+  }
+
+  // A falha que esgota o orçamento derruba o Wi-Fi e recomeça do STA
+  expect_state("orçamento do MQTT esgotado", CONN_STA_BACKOFF);
+  CHECK(s_fsm.mqtt_attempts == 0, "orçamento do MQTT não zerado");
+  CHECK(s_fake.wifi_disconnect == 1, "wifi_disconnect %" PRIu32, s_fake.wifi_disconnect);
+  CHECK(s_fake.timer_ms >= CONN_BACKOFF_BASE_MS / 2 && s_fake.timer_ms <= CONN_BACKOFF_BASE_MS,
+        "backoff depois do MQTT: %" PRIu32 " ms", s_fake.timer_ms);
+  CHECK(s_fake.mqtt_connect == CONN_MQTT_RETRY_BUDGET, "mqtt_connect %" PRIu32, s_fake.mqtt_connect);
+  CHECK(s_fake.ap_start == 0, "AP no caminho do MQTT");
+  fire_timer();
+  expect_state("STA depois do MQTT", CONN_STA_CONNECTING);
+
+  // Perder o AP com a sessão aberta não gasta orçamento do STA e espalha a reconexão
+  go_online(CONN_SPREAD_MS);
+  s_fake.random_forced = true;
+  s_fake.random_value = UINT32_MAX;
+  conn_fsm_handle(&s_fsm, CONN_EV_STA_DISCONNECTED);
+  expect_state("perdeu o AP online", CONN_STA_BACKOFF);
+  CHECK(s_fsm.sta_attempts == 0, "queda do AP gastou orçamento");
+  CHECK(s_fake.timer_ms <= CONN_BACKOFF_BASE_MS + CONN_SPREAD_MS, "reconexão espalhada: %" PRIu32 " ms",
+        s_fake.timer_ms);
+  CHECK(s_fake.last_from == CONN_ONLINE && s_fake.last_to == CONN_STA_BACKOFF, "on_transition %s -> %s",
+        conn_state_name(s_fake.last_from), conn_state_name(s_fake.last_to));
+
+  // Com o pior sorteio o backoff do MQTT fica no teto mesmo nas últimas tentativas
+  go_online(0);
+  s_fake.random_forced = true;
+  s_fake.random_value = UINT32_MAX;
+  conn_fsm_handle(&s_fsm, CONN_EV_MQTT_DISCONNECTED);
+  for (uint32_t n = 1; n < CONN_MQTT_RETRY_BUDGET; n++) {
+    CHECK(s_fake.timer_ms <= CONN_BACKOFF_MAX_MS, "backoff %" PRIu32 " ms acima do teto", s_fake.timer_ms);
+    fire_timer();
+    fire_timer();
+  }
+}
+
+static void test_stale_timer(void)
+{
+  reset(CONN_SPREAD_MS);
+  s_fake.random_forced = true;
+  s_fake.random_value = 1000;
+  conn_fsm_handle(&s_fsm, CONN_EV_START);
+  expect_state("start espalhado", CONN_STA_BACKOFF);
+
+  // O timer do espalhamento dispara, mas antes de o evento ser entregue chegam credenciais novas
+  uint32_t stale = s_fake.timer_gen;
+  conn_fsm_handle(&s_fsm, CONN_EV_RETRY);
+  expect_state("retry", CONN_STA_CONNECTING);
+  uint32_t disconnects = s_fake.wifi_disconnect;
+  conn_fsm_timer_fired(&s_fsm, stale);
+  expect_state("disparo velho", CONN_STA_CONNECTING);
+  CHECK(s_fake.wifi_disconnect == disconnects && s_fsm.sta_attempts == 0, "disparo velho contou como timeout");
+  CHECK(s_fsm.stale_timers == 1, "stale_timers %" PRIu32, s_fsm.stale_timers);
+
+  // Timer parado (GOT_IP) e depois disparo velho: continua em MQTT_CONNECTING
+  stale = s_fake.timer_gen;
+  conn_fsm_handle(&s_fsm, CONN_EV_GOT_IP);
+  conn_fsm_timer_fired(&s_fsm, stale);
+  expect_state("disparo do timeout do STA depois do IP", CONN_MQTT_CONNECTING);
+  CHECK(s_fsm.mqtt_attempts == 0, "disparo velho contou como timeout do MQTT");
+
+  // Timer parado sem rearmar (ONLINE): nenhuma geração antiga passa
+  stale = s_fake.timer_gen;
+  conn_fsm_handle(&s_fsm, CONN_EV_MQTT_CONNECTED);
+  conn_fsm_timer_fired(&s_fsm, stale);
+  expect_state("disparo velho no online", CONN_ONLINE);
+  CHECK(s_fsm.stale_timers == 3, "stale_timers %" PRIu32, s_fsm.stale_timers);
+
+  // O disparo da geração atual passa
+  conn_fsm_handle(&s_fsm, CONN_EV_MQTT_DISCONNECTED);
+  fire_timer();
+  expect_state("disparo atual", CONN_MQTT_CONNECTING);
+}
+
+int main(void)
+{
+  test_backoff_bounds();
+  test_boot();
+  test_sta_budget_and_ap();
+  test_mqtt_budget();
+  test_stale_timer();
+
+  printf("%s\n", s_failures ? "FALHOU" : "OK");
+  return s_failures ? 1 : 0;
+}
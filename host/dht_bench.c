@@ -0,0 +1,216 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dht_emu.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// VARREDURA DO DECODIFICADOR DO DHT
+//
+// Roda o dht.c do esp-idf-lib contra o emulador numa grade de skew x jitter x custo de leitura x
+// perturbação e imprime, por célula, taxa de acerto, falhas por tipo e tempo bloqueado por leitura.
+// Com --gate vira critério de regressão para qualquer mudança no decodificador:
+//   - na região nominal (|skew| <= 10%, jitter <= 4 µs, custo <= 1 µs, sem glitch/ruído) toda leitura
+//     tem de decodificar;
+//   - nenhuma célula pode perder acerto, nem ganhar leituras erradas que passaram no checksum, além
+//     da variação amostral (3 desvios da binomial, mínimo de 1 ponto) em relação ao CSV de referência.
+// As formas de onda dependem só da semente e do índice da leitura, então a mesma semente compara
+// versões do decodificador com as mesmas entradas.
+// O checksum do protocolo é uma soma de 8 bits: com glitches, erros que se compensam passam por ele,
+// por isso a referência registra quantos já passam hoje em vez de exigir zero.
+//
+//   ./build-host/dht_bench [--type am2301|dht11|si7021] [--runs N] [--seed S] [--csv] [--gate ref.csv]
+//   ./build-host/dht_bench --csv > host/dht_baseline.csv     (regrava a referência)
+// -----------------------------------------------------------------------------------------------------------
+
+#define NOMINAL_SKEW      0.10f
+#define NOMINAL_JITTER_US 4.0f
+#define NOMINAL_COST_US   1.0f
+#define BASELINE_MAX_ROWS 1024
+
+typedef struct {
+  const char *name;
+  float glitch_rate;
+  float glitch_us;
+  float noise_rate;
+} disturbance_t;
+
+static const float s_skews[] = { -0.30f, -0.20f, -0.10f, 0.0f, 0.10f, 0.20f, 0.30f };
+static const float s_jitters[] = { 0.0f, 4.0f, 10.0f };
+static const float s_costs[] = { 0.25f, 1.0f, 3.0f };
+static const disturbance_t s_disturbances[] = {
+  { "limpo", 0, 0, 0 },
+  { "glitch", 0.02f, 3.0f, 0 },
+  { "ruido", 0, 0, 0.001f },
+};
+
+static const struct {
+  const char *name;
+  dht_sensor_type_t type;
+} s_types[] = {
+  { "am2301", DHT_TYPE_AM2301 },
+  { "dht11", DHT_TYPE_DHT11 },
+  { "si7021", DHT_TYPE_SI7021 },
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+typedef struct {
+  char key[48];
+  double ok_pct;
+  double wrong_pct;
+} baseline_row_t;
+
+static baseline_row_t s_baseline[BASELINE_MAX_ROWS];
+static size_t s_baseline_rows = 0;
+
+static void cell_key(char *buf, size_t len, const char *type, const dht_emu_config_t *cfg, const char *disturbance)
+{
+  snprintf(buf, len, "%s,%.2f,%.1f,%.2f,%s", type, cfg->skew, cfg->jitter_us, cfg->read_cost_us, disturbance);
+}
+
+// Mesmo formato de --csv; linhas que não casam com a grade atual são ignoradas
+static bool baseline_load(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return false;
+
+  char line[160];
+  while (fgets(line, sizeof(line), f) && s_baseline_rows < BASELINE_MAX_ROWS) {
+    char type[16], disturbance[16];
+    float skew, jitter, cost;
+    unsigned runs, ok, wrong;
+    if (sscanf(line, "%15[^,],%f,%f,%f,%15[^,],%u,%u,%u", type, &skew, &jitter, &cost, disturbance,
+               &runs, &ok, &wrong) != 8 || runs == 0) {
+      continue;
+    }
+    baseline_row_t *row = &s_baseline[s_baseline_rows++];
+    dht_emu_config_t cfg = { .skew = skew, .jitter_us = jitter, .read_cost_us = cost };
+    cell_key(row->key, sizeof(row->key), type, &cfg, disturbance);
+    row->ok_pct = 100.0 * ok / runs;
+    row->wrong_pct = 100.0 * wrong / runs;
+  }
+  fclose(f);
+  return s_baseline_rows > 0;
+}
+
+// Variação aceitável de uma taxa (em pontos percentuais) medida com 'runs' leituras
+static double tolerance_pct(double pct, uint32_t runs)
+{
+  double p = pct / 100.0;
+  double sigma = sqrt(p * (1 - p) / runs) * 100.0;
+  return fmax(1.0, 3 * sigma);
+}
+
+static const baseline_row_t *baseline_find(const char *key)
+{
+  for (size_t i = 0; i < s_baseline_rows; i++) {
+    if (strcmp(s_baseline[i].key, key) == 0) return &s_baseline[i];
+  }
+  return NULL;
+}
+
+static bool nominal(const dht_emu_config_t *cfg)
+{
+  return cfg->skew >= -NOMINAL_SKEW - 1e-6f && cfg->skew <= NOMINAL_SKEW + 1e-6f &&
+         cfg->jitter_us <= NOMINAL_JITTER_US && cfg->read_cost_us <= NOMINAL_COST_US &&
+         cfg->glitch_rate == 0 && cfg->noise_rate == 0;
+}
+
+int main(int argc, char **argv)
+{
+  const char *only = NULL;
+  uint32_t runs = 200;
+  uint32_t seed = 1;
+  bool csv = false;
+  const char *gate = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--type") == 0 && i + 1 < argc) {
+      only = argv[++i];
+    } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+      runs = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--csv") == 0) {
+      csv = true;
+    } else if (strcmp(argv[i], "--gate") == 0 && i + 1 < argc) {
+      gate = argv[++i];
+    } else {
+      fprintf(stderr, "uso: %s [--type am2301|dht11|si7021] [--runs N] [--seed S] [--csv] [--gate ref.csv]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (runs == 0) runs = 1;
+  if (gate && !baseline_load(gate)) {
+    fprintf(stderr, "não foi possível ler a referência %s\n", gate);
+    return 2;
+  }
+
+  dht_emu_seed(seed);
+  if (csv) {
+    printf("tipo,skew,jitter_us,custo_us,perturbacao,leituras,ok,errado,crc,timeout,bloqueado_us,host_ns\n");
+  } else {
+    printf("%-7s %6s %6s %6s %-7s %7s %6s %6s %6s %11s %9s\n",
+           "tipo", "skew", "jitter", "custo", "pert.", "ok%", "errado", "crc", "tmout", "bloq. (us)", "host ns");
+  }
+
+  uint32_t gate_failures = 0;
+  for (size_t t = 0; t < COUNT(s_types); t++) {
+    if (only && strcmp(only, s_types[t].name) != 0) continue;
+
+    for (size_t d = 0; d < COUNT(s_disturbances); d++) {
+      for (size_t c = 0; c < COUNT(s_costs); c++) {
+        for (size_t s = 0; s < COUNT(s_skews); s++) {
+          for (size_t j = 0; j < COUNT(s_jitters); j++) {
+            dht_emu_config_t cfg = {
+              .type = s_types[t].type,
+              .skew = s_skews[s],
+              .jitter_us = s_jitters[j],
+              .glitch_rate = s_disturbances[d].glitch_rate,
+              .glitch_us = s_disturbances[d].glitch_us,
+              .noise_rate = s_disturbances[d].noise_rate,
+              .read_cost_us = s_costs[c],
+            };
+            dht_emu_result_t r;
+            dht_emu_run(&cfg, runs, &r);
+
+            if (csv) {
+              printf("%s,%.2f,%.1f,%.2f,%s,%u,%u,%u,%u,%u,%.0f,%.0f\n", s_types[t].name, cfg.skew, cfg.jitter_us,
+                     cfg.read_cost_us, s_disturbances[d].name, r.runs, r.ok, r.wrong, r.crc, r.timeout,
+                     r.busy_us, r.host_ns);
+            } else {
+              printf("%-7s %+5.0f%% %6.1f %6.2f %-7s %6.1f%% %6u %6u %6u %11.0f %9.0f\n", s_types[t].name,
+                     cfg.skew * 100, cfg.jitter_us, cfg.read_cost_us, s_disturbances[d].name,
+                     100.0 * r.ok / r.runs, r.wrong, r.crc, r.timeout, r.busy_us, r.host_ns);
+            }
+
+            if (!gate) continue;
+
+            char key[48];
+            cell_key(key, sizeof(key), s_types[t].name, &cfg, s_disturbances[d].name);
+            const baseline_row_t *base = baseline_find(key);
+            double ok_pct = 100.0 * r.ok / r.runs;
+            double wrong_pct = 100.0 * r.wrong / r.runs;
+            bool failed = nominal(&cfg) && r.ok != r.runs;
+            if (base) {
+              failed |= ok_pct < base->ok_pct - tolerance_pct(base->ok_pct, r.runs);
+              failed |= wrong_pct > base->wrong_pct + tolerance_pct(base->wrong_pct, r.runs);
+            }
+            if (failed) {
+              fprintf(stderr, "GATE: %s: %.1f%% ok (ref. %.1f%%), %.1f%% errado (ref. %.1f%%)\n", key, ok_pct,
+                      base ? base->ok_pct : 100.0, wrong_pct, base ? base->wrong_pct : 0.0);
+              gate_failures++;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if (gate) {
+    fprintf(stderr, gate_failures ? "GATE: %u células reprovadas\n" : "GATE: ok\n", gate_failures);
+  }
+  return gate_failures ? 1 : 0;
+}
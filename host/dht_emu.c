@@ -0,0 +1,244 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dht_emu.h"
+#include "driver/gpio.h"
+#include "ets_sys.h"
+
+typedef struct {
+  uint32_t start_min_us;  // pulso de start mínimo para o sensor responder
+  float go_us;            // linha solta até o sensor puxar
+  float response_low_us;
+  float response_high_us;
+  float bit_low_us;
+  float bit_zero_us;
+  float bit_one_us;
+  float end_low_us;
+} dht_timing_t;
+
+// Valores típicos dos datasheets; o Si7021 da Itead usa o protocolo do AM2301 com start curto
+static const dht_timing_t s_timings[] = {
+  [DHT_TYPE_DHT11]  = { 18000, 30, 80, 80, 54, 24, 71, 54 },
+  [DHT_TYPE_AM2301] = { 800, 30, 80, 80, 50, 26, 70, 50 },
+  [DHT_TYPE_SI7021] = { 500, 30, 80, 80, 50, 26, 70, 50 },
+};
+
+typedef struct {
+  double end_us;
+  int level;
+} segment_t;
+
+static const dht_emu_config_t *s_cfg;
+static uint32_t s_seed = 1;
+static uint32_t s_rng = 1;        // valores e forma de onda
+static uint32_t s_noise_rng = 1;  // ruído: separado porque o número de leituras depende do decodificador
+static double s_now_us;
+static uint32_t s_host_level;
+static double s_host_low_since;
+static uint8_t s_data[5];
+
+static segment_t s_segments[DHT_EMU_MAX_SEGMENTS];
+static int s_num_segments;
+static int s_cursor;
+static double s_glitch_start[DHT_EMU_MAX_SEGMENTS];
+static double s_glitch_end[DHT_EMU_MAX_SEGMENTS];
+static int s_num_glitches;
+
+// -----------------------------------------------------------------------------------------------------------
+// AUXILIARES
+// -----------------------------------------------------------------------------------------------------------
+
+static uint32_t xorshift(uint32_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static uint32_t rng_next(void)
+{
+  return xorshift(&s_rng);
+}
+
+static double rng_unit(void)
+{
+  return (rng_next() >> 8) / (double)(1u << 24);
+}
+
+// Estado inicial de cada leitura depende só da semente e do índice: duas versões do decodificador
+// recebem exatamente as mesmas formas de onda
+static uint32_t mix(uint32_t seed, uint32_t index, uint32_t stream)
+{
+  uint32_t x = seed + index * 0x9E3779B9u + stream * 0x85EBCA6Bu;
+  x = (x ^ (x >> 16)) * 0x7FEB352Du;
+  x = (x ^ (x >> 15)) * 0x846CA68Bu;
+  x ^= x >> 16;
+  return x ? x : 1;
+}
+
+static int32_t rng_range(int32_t min, int32_t max)
+{
+  return min + (int32_t)(rng_next() % (uint32_t)(max - min + 1));
+}
+
+static void add_segment(double *t, int level, float nominal_us)
+{
+  double duration = nominal_us * (1.0 + s_cfg->skew) + (rng_unit() * 2 - 1) * s_cfg->jitter_us;
+  if (duration < 1) duration = 1;
+
+  if (s_cfg->glitch_rate > 0 && rng_unit() < s_cfg->glitch_rate) {
+    double start = *t + rng_unit() * duration;
+    s_glitch_start[s_num_glitches] = start;
+    s_glitch_end[s_num_glitches] = start + s_cfg->glitch_us;
+    s_num_glitches++;
+  }
+
+  *t += duration;
+  s_segments[s_num_segments++] = (segment_t) { .end_us = *t, .level = level };
+}
+
+// Resposta completa do sensor a partir do instante em que o host soltou a linha
+static void build_response(double t)
+{
+  const dht_timing_t *timing = &s_timings[s_cfg->type];
+
+  s_num_segments = 0;
+  s_num_glitches = 0;
+  s_cursor = 0;
+
+  add_segment(&t, 1, timing->go_us);
+  add_segment(&t, 0, timing->response_low_us);
+  add_segment(&t, 1, timing->response_high_us);
+  for (int i = 0; i < 40; i++) {
+    int bit = (s_data[i / 8] >> (7 - i % 8)) & 1;
+    add_segment(&t, 0, timing->bit_low_us);
+    add_segment(&t, 1, bit ? timing->bit_one_us : timing->bit_zero_us);
+  }
+  add_segment(&t, 0, timing->end_low_us);
+}
+
+static int sensor_level(double t)
+{
+  // Relógio só anda para frente dentro de uma leitura
+  while (s_cursor < s_num_segments && t >= s_segments[s_cursor].end_us) s_cursor++;
+  int level = (s_cursor < s_num_segments) ? s_segments[s_cursor].level : 1;
+
+  for (int i = 0; i < s_num_glitches; i++) {
+    if (t >= s_glitch_start[i] && t < s_glitch_end[i]) return !level;
+  }
+  return level;
+}
+
+static void encode(int16_t humidity, int16_t temperature)
+{
+  if (s_cfg->type == DHT_TYPE_DHT11) {
+    s_data[0] = humidity / 10;
+    s_data[1] = 0;
+    s_data[2] = temperature / 10;
+    s_data[3] = 0;
+  } else {
+    uint16_t magnitude = temperature < 0 ? -temperature : temperature;
+    s_data[0] = humidity >> 8;
+    s_data[1] = humidity & 0xFF;
+    s_data[2] = (magnitude >> 8) | (temperature < 0 ? 0x80 : 0);
+    s_data[3] = magnitude & 0xFF;
+  }
+  s_data[4] = s_data[0] + s_data[1] + s_data[2] + s_data[3];
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// GPIO E ESPERA ATIVA EMULADOS
+// -----------------------------------------------------------------------------------------------------------
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+  if (level && !s_host_level && s_now_us - s_host_low_since >= s_timings[s_cfg->type].start_min_us) {
+    build_response(s_now_us);
+  }
+  if (!level && s_host_level) s_host_low_since = s_now_us;
+  s_host_level = level;
+  return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+  double t = s_now_us;
+  s_now_us += s_cfg->read_cost_us;
+
+  // Dreno aberto: host em 0 prende a linha, senão vale o que o sensor (ou o pull-up) impõe
+  int level = s_host_level ? sensor_level(t) : 0;
+  if (s_cfg->noise_rate > 0 && (xorshift(&s_noise_rng) >> 8) < s_cfg->noise_rate * (1u << 24)) level = !level;
+  return level;
+}
+
+void ets_delay_us(uint32_t us)
+{
+  s_now_us += us;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// API
+// -----------------------------------------------------------------------------------------------------------
+
+void dht_emu_seed(uint32_t seed)
+{
+  s_seed = seed;
+}
+
+void dht_emu_run(const dht_emu_config_t *cfg, uint32_t runs, dht_emu_result_t *result)
+{
+  double busy_sum = 0, host_sum = 0;
+  s_cfg = cfg;
+  memset(result, 0, sizeof(*result));
+
+  for (uint32_t i = 0; i < runs; i++) {
+    s_rng = mix(s_seed, i, 0);
+    s_noise_rng = mix(s_seed, i, 1);
+
+    int16_t humidity, temperature;
+    if (cfg->type == DHT_TYPE_DHT11) {
+      humidity = rng_range(20, 90) * 10;
+      temperature = rng_range(0, 50) * 10;
+    } else {
+      humidity = rng_range(0, 1000);
+      temperature = rng_range(-400, 800);
+    }
+    encode(humidity, temperature);
+
+    s_now_us = 0;
+    s_host_level = 1;
+    s_num_segments = 0;
+    s_num_glitches = 0;
+    s_cursor = 0;
+
+    int16_t got_humidity = 0, got_temperature = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    esp_err_t err = dht_read_data(cfg->type, 0, &got_humidity, &got_temperature);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    busy_sum += s_now_us;
+    host_sum += (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    result->runs++;
+    if (err == ESP_OK) {
+      if (got_humidity == humidity && got_temperature == temperature) {
+        result->ok++;
+      } else {
+        result->wrong++;
+      }
+    } else if (err == ESP_ERR_INVALID_CRC) {
+      result->crc++;
+    } else {
+      result->timeout++;
+    }
+  }
+
+  result->busy_us = busy_sum / runs;
+  result->host_ns = host_sum / runs;
+}
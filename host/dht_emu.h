@@ -0,0 +1,44 @@
+#ifndef DHT_EMU_H
+#define DHT_EMU_H
+
+#include <stdint.h>
+#include "dht.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// EMULADOR DE FORMA DE ONDA DO DHT
+//
+// Faz o papel do sensor do outro lado do GPIO para o decodificador do esp-idf-lib (dht.c compilado
+// sem alterações). O tempo é virtual: ets_delay_us() avança o relógio e cada gpio_get_level() custa
+// read_cost_us, que modela o que a iteração de dht_await_pin_state() gasta além dos 2 µs nominais.
+// Quando o host solta a linha depois de um pulso de start longo o bastante, o sensor responde com a
+// sequência de bits dos valores armados, deformada por skew, jitter, glitches e ruído.
+// -----------------------------------------------------------------------------------------------------------
+
+#define DHT_EMU_MAX_SEGMENTS  (3 + 2 * 40 + 1)
+
+typedef struct {
+  dht_sensor_type_t type;
+  float skew;             // fator sobre todas as durações do sensor: 0,1 = oscilador 10% mais lento
+  float jitter_us;        // ± uniforme em cada segmento
+  float glitch_rate;      // probabilidade, por segmento, de um pico do nível oposto
+  float glitch_us;
+  float noise_rate;       // probabilidade, por leitura do GPIO, de vir o nível trocado
+  float read_cost_us;     // custo de cada gpio_get_level() no relógio virtual
+} dht_emu_config_t;
+
+typedef struct {
+  uint32_t runs;
+  uint32_t ok;
+  uint32_t wrong;         // ESP_OK com valor diferente do armado: corrupção silenciosa
+  uint32_t crc;
+  uint32_t timeout;
+  double busy_us;         // média de tempo bloqueado em dht_read_data() (relógio virtual)
+  double host_ns;         // média de CPU do host por leitura
+} dht_emu_result_t;
+
+void dht_emu_seed(uint32_t seed);
+
+// Roda 'runs' leituras com valores aleatórios dentro da faixa do sensor e preenche result
+void dht_emu_run(const dht_emu_config_t *cfg, uint32_t runs, dht_emu_result_t *result);
+
+#endif // DHT_EMU_H
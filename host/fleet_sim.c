@@ -0,0 +1,990 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <mosquitto.h>
+#include "adaptive_sampler.h"
+#include "app_config.h"
+#include "app_publish.h"
+#include "conn_fsm.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// SIMULADOR DE FROTA
+//
+// N dispositivos virtuais contra um broker de verdade (mosquitto local), cada um com o MAC, os
+// tópicos e o comportamento de publicação do firmware: mesmo amostrador adaptativo, mesmo filtro de
+// mudança (republica a cada 0,1), mesma formatação em décimos, QoS 1 em <mac>/umidade e
+// <mac>/temperatura, e a mesma máquina de conectividade (backoff com jitter) decidindo quando
+// reconectar. O que muda é só a borda: o sensor vem de um traço (CSV do replay) ou de um passeio
+// aleatório por dispositivo, o Wi-Fi é um atraso de associação com quedas sorteadas, e o esp-mqtt
+// vira um cliente libmosquitto. Como no esp-mqtt, o que é publicado offline fica na fila do cliente
+// e sai na reconexão; uma queda de energia (--storm-at) perde a fila e reinicia todos juntos.
+//
+// Como no firmware, cada dispositivo lê na fase tirada do seu MAC (app_phase_delay_ms) e espera um
+// atraso sorteado de até CONN_SPREAD_MS antes de conectar no boot e depois de cair do ONLINE.
+// --no-stagger volta ao comportamento antigo (leitura no ritmo do boot, conexão imediata) para
+// comparar: o resumo traz o pico de CONNECTs e de mensagens aceitas pelo broker (PUBACK) em janelas
+// de 100 ms, no total e a partir da volta da energia.
+//
+// Tudo roda numa thread, com poll() sobre os sockets de todos os clientes. A cada --report s sai uma
+// linha com conectados, publicações/s, PUBACKs/s, bytes/s no fio (estimados pelo tamanho dos pacotes
+// MQTT) e percentis da latência publish -> PUBACK; com o broker mosquitto, também a carga que o próprio
+// broker reporta em $SYS (média de 1 min, atualizada a cada sys_interval).
+//
+//   ./build-host/fleet_sim --devices 10000 --duration 300 --storm-at 120 --outage-mtbf 600
+//   ./build-host/fleet_sim --devices 2000 --trace main/traces/replay.csv --csv > fleet.csv
+//   ./build-host/fleet_sim --devices 5000 --duration 90 --storm-at 30 --no-stagger   (antes)
+//   ./build-host/fleet_sim --devices 5000 --duration 90 --storm-at 30                (depois)
+// -----------------------------------------------------------------------------------------------------------
+
+#define FLEET_KEEPALIVE_S      120      // padrão do esp-mqtt
+#define FLEET_PENDING_SLOTS    64       // envios aguardando PUBACK com horário registrado, por dispositivo
+#define FLEET_BOOT_MS          1500     // do reset até o primeiro esp_wifi_connect()
+#define FLEET_BOOT_JITTER_MS   100
+#define FLEET_ASSOC_MS         1500     // associação + DHCP
+#define FLEET_ASSOC_JITTER_MS  1000
+#define FLEET_MISC_PERIOD_MS   1000     // keepalive e reenvios do libmosquitto
+#define FLEET_POLL_MS          5
+#define FLEET_TOPIC_LEN        48
+#define FLEET_TRACE_MAX        100000
+#define FLEET_PEAK_SLOT_MS     100      // janela dos picos do resumo
+
+// Histograma logarítmico de latência: 8 faixas por oitava, de 1 µs a ~2^28 µs
+#define LAT_SUB_BUCKETS        8
+#define LAT_BUCKETS            (28 * LAT_SUB_BUCKETS)
+
+enum {
+  TOPIC_UMIDADE = METRIC_UMIDADE,
+  TOPIC_TEMPERATURA = METRIC_TEMPERATURA,
+  TOPIC_AMOSTRAGEM,
+  TOPIC_CONECTIVIDADE,
+  TOPIC_COUNT,
+};
+
+static const char *const s_topic_suffix[TOPIC_COUNT] = {
+  [TOPIC_UMIDADE] = "umidade",
+  [TOPIC_TEMPERATURA] = "temperatura",
+  [TOPIC_AMOSTRAGEM] = "amostragem",
+  [TOPIC_CONECTIVIDADE] = "conectividade",
+};
+
+typedef struct {
+  int mid;
+  int64_t sent_us;
+} pending_t;
+
+typedef struct {
+  uint32_t index;
+  char mac[18];
+  char topics[TOPIC_COUNT][FLEET_TOPIC_LEN];
+  uint8_t topic_len[TOPIC_COUNT];
+  uint32_t rng;
+
+  struct mosquitto *mosq;       // NULL até a primeira conexão, como global_mqtt_client
+  bool mqtt_up;
+  conn_fsm_t conn;
+  int64_t timer_at_ms;          // timer da máquina de conectividade; 0 = parado
+  int64_t assoc_at_ms;          // associação em curso: GOT_IP neste instante
+  bool wifi_up;
+
+  int64_t boot_at_ms;           // desligado até aqui; 0 = rodando
+  int64_t outage_until_ms;      // Wi-Fi fora do ar até aqui
+  int64_t next_outage_ms;
+
+  adaptive_sampler_t sampler;
+  app_change_filter_t changed;
+  int64_t next_sample_ms;
+  uint32_t phase_seed;
+  uint32_t trace_pos;
+  double walk[APP_METRICS];     // passeio aleatório em décimos, em torno da base
+  double base[APP_METRICS];
+  double phase;
+
+  pending_t pending[FLEET_PENDING_SLOTS];
+  uint32_t pending_head;
+} vdev_t;
+
+typedef struct {
+  uint64_t published;
+  uint64_t queued_offline;
+  uint64_t acked;
+  uint64_t bytes_out;
+  uint64_t bytes_in;
+  uint64_t connects;
+  uint64_t drops;
+  uint64_t unmeasured;          // PUBACK sem horário: slot sobrescrito por fila longa
+  uint32_t lat[LAT_BUCKETS];
+  uint64_t lat_count;
+} fleet_stats_t;
+
+// Picos por janela curta: a média de 1 s do relatório esconde a rajada de uma frota sincronizada
+typedef struct {
+  int64_t slot;
+  uint32_t connects;            // CONNECTs enviados na janela corrente
+  uint32_t acked;               // mensagens que o broker aceitou na janela corrente
+  uint32_t peak_connects;
+  uint32_t peak_acked;
+  uint32_t storm_peak_connects; // a partir da volta da energia
+  uint32_t storm_peak_acked;
+} fleet_peaks_t;
+
+typedef struct {
+  uint32_t devices;
+  const char *host;
+  int port;
+  const char *username;
+  const char *password;
+  uint32_t duration_s;
+  uint32_t boot_spread_s;
+  const char *trace;
+  double noise;
+  uint32_t interval_min_ms;
+  uint32_t interval_max_ms;
+  uint32_t outage_mtbf_s;
+  uint32_t outage_min_s;
+  uint32_t outage_max_s;
+  uint32_t storm_at_s;
+  uint32_t storm_down_s;
+  uint32_t report_s;
+  uint32_t seed;
+  uint32_t mac_base;
+  bool csv;
+  bool sys;
+  bool stagger;
+} fleet_args_t;
+
+static fleet_args_t s_args = {
+  .devices = 100,
+  .host = "localhost",
+  .port = 1883,
+  .duration_s = 60,
+  .boot_spread_s = 10,
+  .noise = 1.0,
+  .outage_min_s = 5,
+  .outage_max_s = 60,
+  .storm_down_s = 5,
+  .report_s = 1,
+  .seed = 1,
+  .sys = true,
+  .stagger = true,
+};
+
+static vdev_t *s_devs;
+static vdev_t *s_current;       // dispositivo em que as callbacks de conn_ops_t atuam
+static int64_t s_now_ms;
+static int64_t s_start_ms;
+static fleet_stats_t s_interval;
+static fleet_stats_t s_total;
+static fleet_peaks_t s_peaks;
+static int64_t s_storm_back_ms;
+static uint32_t s_online;
+static app_config_t s_cfg;
+
+static int16_t (*s_trace)[APP_METRICS];
+static uint32_t s_trace_len;
+
+// $SYS do mosquitto: carga vista pelo broker
+static struct mosquitto *s_sys;
+static double s_sys_msgs_min = -1;
+static double s_sys_bytes_min = -1;
+static long s_sys_clients = -1;
+
+// -----------------------------------------------------------------------------------------------------------
+// AUXILIARES
+// -----------------------------------------------------------------------------------------------------------
+
+static int64_t now_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static uint32_t xorshift(uint32_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static double rng_unit(uint32_t *state)
+{
+  return (xorshift(state) >> 8) / (double)(1u << 24);
+}
+
+// Aproximação de normal padrão pela soma de 4 uniformes
+static double rng_gauss(uint32_t *state)
+{
+  double sum = 0;
+  for (int i = 0; i < 4; i++) sum += rng_unit(state);
+  return (sum - 2.0) * sqrt(3.0);
+}
+
+static int64_t rng_range_ms(uint32_t *state, int64_t base, int64_t jitter)
+{
+  return base + (int64_t)((rng_unit(state) * 2 - 1) * jitter);
+}
+
+static uint32_t mix(uint32_t seed, uint32_t index)
+{
+  uint32_t x = seed + index * 0x9E3779B9u;
+  x = (x ^ (x >> 16)) * 0x7FEB352Du;
+  x = (x ^ (x >> 15)) * 0x846CA68Bu;
+  x ^= x >> 16;
+  return x ? x : 1;
+}
+
+// Tamanho no fio de um PUBLISH: cabeçalho fixo + comprimento variável + tópico + packet id + payload
+static uint32_t publish_wire_bytes(size_t topic_len, size_t payload_len, int qos)
+{
+  uint32_t remaining = 2 + topic_len + (qos ? 2 : 0) + payload_len;
+  uint32_t header = 1;
+  for (uint32_t r = remaining; ; r >>= 7) {
+    header++;
+    if (r < 128) break;
+  }
+  return header + remaining;
+}
+
+static void lat_add(fleet_stats_t *stats, int64_t us)
+{
+  uint32_t bucket = 0;
+  if (us >= 1) {
+    double b = log2((double)us) * LAT_SUB_BUCKETS;
+    bucket = b >= LAT_BUCKETS - 1 ? LAT_BUCKETS - 1 : (uint32_t)b;
+  }
+  stats->lat[bucket]++;
+  stats->lat_count++;
+}
+
+// Limite superior da faixa que contém o percentil, em ms
+static double lat_percentile_ms(const fleet_stats_t *stats, double p)
+{
+  if (stats->lat_count == 0) return 0;
+  uint64_t target = (uint64_t)ceil(stats->lat_count * p);
+  uint64_t seen = 0;
+  for (uint32_t b = 0; b < LAT_BUCKETS; b++) {
+    seen += stats->lat[b];
+    if (seen >= target) return exp2((b + 1.0) / LAT_SUB_BUCKETS) / 1000.0;
+  }
+  return exp2((double)LAT_BUCKETS / LAT_SUB_BUCKETS) / 1000.0;
+}
+
+// Fecha a janela corrente quando o relógio passa dela
+static void peaks_roll(int64_t now_ms)
+{
+  int64_t slot = now_ms / FLEET_PEAK_SLOT_MS;
+  if (slot == s_peaks.slot) return;
+
+  if (s_peaks.connects > s_peaks.peak_connects) s_peaks.peak_connects = s_peaks.connects;
+  if (s_peaks.acked > s_peaks.peak_acked) s_peaks.peak_acked = s_peaks.acked;
+  if (s_storm_back_ms && s_peaks.slot * FLEET_PEAK_SLOT_MS >= s_storm_back_ms) {
+    if (s_peaks.connects > s_peaks.storm_peak_connects) s_peaks.storm_peak_connects = s_peaks.connects;
+    if (s_peaks.acked > s_peaks.storm_peak_acked) s_peaks.storm_peak_acked = s_peaks.acked;
+  }
+  s_peaks.slot = slot;
+  s_peaks.connects = 0;
+  s_peaks.acked = 0;
+}
+
+static void stats_add(fleet_stats_t *into, const fleet_stats_t *from)
+{
+  into->published += from->published;
+  into->queued_offline += from->queued_offline;
+  into->acked += from->acked;
+  into->bytes_out += from->bytes_out;
+  into->bytes_in += from->bytes_in;
+  into->connects += from->connects;
+  into->drops += from->drops;
+  into->unmeasured += from->unmeasured;
+  for (uint32_t b = 0; b < LAT_BUCKETS; b++) into->lat[b] += from->lat[b];
+  into->lat_count += from->lat_count;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// SENSOR VIRTUAL
+// -----------------------------------------------------------------------------------------------------------
+
+// Mesmo formato do traço do replay (main/traces/replay.csv): "temperatura,umidade" em décimos
+static bool trace_load(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return false;
+
+  s_trace = malloc(sizeof(*s_trace) * FLEET_TRACE_MAX);
+  char line[64];
+  while (s_trace && fgets(line, sizeof(line), f) && s_trace_len < FLEET_TRACE_MAX) {
+    int t, u;
+    if (line[0] == '#' || sscanf(line, "%d,%d", &t, &u) != 2) continue;
+    s_trace[s_trace_len][METRIC_TEMPERATURA] = t;
+    s_trace[s_trace_len][METRIC_UMIDADE] = u;
+    s_trace_len++;
+  }
+  fclose(f);
+  return s_trace_len > 0;
+}
+
+// Traço com início próprio por dispositivo, ou passeio aleatório com retorno à média, ciclo de um
+// "dia" de 10 min e ruído de leitura; --noise é o desvio do ruído em décimos
+static void sensor_read(vdev_t *dev, int16_t *temperatura, int16_t *umidade)
+{
+  if (s_trace_len) {
+    const int16_t *row = s_trace[dev->trace_pos++ % s_trace_len];
+    *temperatura = row[METRIC_TEMPERATURA];
+    *umidade = row[METRIC_UMIDADE];
+    return;
+  }
+
+  double day = sin(2 * M_PI * (s_now_ms - s_start_ms) / 600000.0 + dev->phase);
+  double v[APP_METRICS];
+  for (int m = 0; m < APP_METRICS; m++) {
+    dev->walk[m] = 0.98 * dev->walk[m] + rng_gauss(&dev->rng) * 2.0;
+    v[m] = dev->base[m] + dev->walk[m] + rng_gauss(&dev->rng) * s_args.noise;
+  }
+  v[METRIC_TEMPERATURA] += 20 * day;
+  v[METRIC_UMIDADE] -= 40 * day;
+  if (v[METRIC_UMIDADE] < 0) v[METRIC_UMIDADE] = 0;
+  if (v[METRIC_UMIDADE] > 1000) v[METRIC_UMIDADE] = 1000;
+  *temperatura = (int16_t)lround(v[METRIC_TEMPERATURA]);
+  *umidade = (int16_t)lround(v[METRIC_UMIDADE]);
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// PUBLICAÇÃO
+// -----------------------------------------------------------------------------------------------------------
+
+static void dev_publish(vdev_t *dev, int topic, const char *payload, size_t len)
+{
+  int mid = 0;
+  int64_t sent_us = now_us();
+  int rc = mosquitto_publish(dev->mosq, &mid, dev->topics[topic], (int)len, payload, 1, false);
+
+  // Desconectado o libmosquitto guarda o QoS 1 na fila e reenvia na reconexão, como o outbox do esp-mqtt
+  if (rc != MOSQ_ERR_SUCCESS && rc != MOSQ_ERR_NO_CONN) return;
+  if (rc == MOSQ_ERR_NO_CONN) s_interval.queued_offline++;
+
+  s_interval.published++;
+  s_interval.bytes_out += publish_wire_bytes(dev->topic_len[topic], len, 1);
+  dev->pending[dev->pending_head++ % FLEET_PENDING_SLOTS] = (pending_t) { .mid = mid, .sent_us = sent_us };
+}
+
+static void dev_sample(vdev_t *dev)
+{
+  int16_t temperatura, umidade;
+  sensor_read(dev, &temperatura, &umidade);
+
+  adaptive_reason_t reason = adaptive_update(&dev->sampler, (uint32_t)(s_now_ms - s_start_ms), temperatura, umidade);
+  if (reason != ADAPTIVE_HOLD && dev->mosq) {
+    char msg[64];
+    int len = snprintf(msg, sizeof(msg), "{\"ms\":%" PRIu32 ",\"motivo\":\"%s\",\"n\":%" PRIu32 "}",
+                       adaptive_interval_ms(&dev->sampler), reason == ADAPTIVE_FAST ? "rapido" : "estavel",
+                       dev->sampler.transitions);
+    dev_publish(dev, TOPIC_AMOSTRAGEM, msg, len);
+  }
+
+  if (dev->mosq && app_change_filter_update(&dev->changed, METRIC_UMIDADE, umidade)) {
+    char msg[APP_TENTHS_MAX_LEN];
+    dev_publish(dev, TOPIC_UMIDADE, msg, app_format_tenths(umidade, msg));
+  }
+  if (dev->mosq && app_change_filter_update(&dev->changed, METRIC_TEMPERATURA, temperatura)) {
+    char msg[APP_TENTHS_MAX_LEN];
+    dev_publish(dev, TOPIC_TEMPERATURA, msg, app_format_tenths(temperatura, msg));
+  }
+
+  uint32_t interval = adaptive_interval_ms(&dev->sampler);
+  if (s_args.stagger) {
+    // s_now_ms é o mesmo relógio para todos, como o relógio de parede acertado por SNTP no firmware
+    interval = app_phase_delay_ms(dev->phase_seed, s_now_ms, interval);
+  }
+  dev->next_sample_ms = s_now_ms + (interval ? interval : 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// CLIENTE MQTT
+// -----------------------------------------------------------------------------------------------------------
+
+static void dev_event(vdev_t *dev, conn_event_t event)
+{
+  s_current = dev;
+  conn_fsm_handle(&dev->conn, event);
+}
+
+static void dev_mqtt_lost(vdev_t *dev)
+{
+  if (!dev->mqtt_up) return;
+  dev->mqtt_up = false;
+  s_online--;
+  s_interval.drops++;
+}
+
+static void on_connect(struct mosquitto *mosq, void *obj, int rc)
+{
+  vdev_t *dev = obj;
+  if (rc != 0) {
+    dev_event(dev, CONN_EV_MQTT_DISCONNECTED);
+    return;
+  }
+  if (!dev->mqtt_up) {
+    dev->mqtt_up = true;
+    s_online++;
+    s_interval.connects++;
+  }
+  dev_event(dev, CONN_EV_MQTT_CONNECTED);
+}
+
+static void on_disconnect(struct mosquitto *mosq, void *obj, int rc)
+{
+  vdev_t *dev = obj;
+  bool was_up = dev->mqtt_up;
+  dev_mqtt_lost(dev);
+  // Sem Wi-Fi a máquina já foi avisada pela queda do STA
+  if (dev->wifi_up && (was_up || dev->conn.state == CONN_MQTT_CONNECTING)) {
+    dev_event(dev, CONN_EV_MQTT_DISCONNECTED);
+  }
+}
+
+static void on_publish(struct mosquitto *mosq, void *obj, int mid)
+{
+  vdev_t *dev = obj;
+  int64_t t = now_us();
+
+  s_interval.acked++;
+  s_interval.bytes_in += 4;
+  s_peaks.acked++;
+  for (uint32_t i = 0; i < FLEET_PENDING_SLOTS; i++) {
+    pending_t *p = &dev->pending[i];
+    if (p->sent_us && p->mid == mid) {
+      lat_add(&s_interval, t - p->sent_us);
+      p->sent_us = 0;
+      return;
+    }
+  }
+  s_interval.unmeasured++;
+}
+
+static bool dev_client_new(vdev_t *dev)
+{
+  char id[32];
+  snprintf(id, sizeof(id), "fleet-%s", dev->mac);
+  dev->mosq = mosquitto_new(id, true, dev);
+  if (dev->mosq == NULL) return false;
+
+  if (s_args.username) mosquitto_username_pw_set(dev->mosq, s_args.username, s_args.password);
+  mosquitto_max_inflight_messages_set(dev->mosq, 0);   // esp-mqtt não limita mensagens em voo
+  mosquitto_connect_callback_set(dev->mosq, on_connect);
+  mosquitto_disconnect_callback_set(dev->mosq, on_disconnect);
+  mosquitto_publish_callback_set(dev->mosq, on_publish);
+  return true;
+}
+
+static void dev_power_off(vdev_t *dev)
+{
+  dev_mqtt_lost(dev);
+  if (dev->mosq) {
+    mosquitto_destroy(dev->mosq);   // fecha o socket sem DISCONNECT e descarta a fila
+    dev->mosq = NULL;
+  }
+  dev->wifi_up = false;
+  dev->assoc_at_ms = 0;
+  dev->timer_at_ms = 0;
+  dev->next_sample_ms = 0;
+  memset(dev->pending, 0, sizeof(dev->pending));
+}
+
+// Queda do Wi-Fi: o socket morre sem DISCONNECT, o broker só percebe pelo TCP
+static void dev_wifi_lost(vdev_t *dev)
+{
+  if (dev->mosq && mosquitto_socket(dev->mosq) >= 0) {
+    shutdown(mosquitto_socket(dev->mosq), SHUT_RDWR);
+  }
+  dev_mqtt_lost(dev);
+  bool was_up = dev->wifi_up;
+  dev->wifi_up = false;
+  dev->assoc_at_ms = 0;
+  if (was_up) dev_event(dev, CONN_EV_STA_DISCONNECTED);
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// CONECTIVIDADE (conn_ops_t sobre o dispositivo corrente)
+// -----------------------------------------------------------------------------------------------------------
+
+static void sim_wifi_connect(void)
+{
+  // Fora do ar a associação não completa e o timeout da máquina conta como falha
+  if (s_current->outage_until_ms > s_now_ms) return;
+  s_current->assoc_at_ms = rng_range_ms(&s_current->rng, s_now_ms + FLEET_ASSOC_MS, FLEET_ASSOC_JITTER_MS);
+}
+
+static void sim_wifi_disconnect(void)
+{
+  s_current->assoc_at_ms = 0;
+  s_current->wifi_up = false;
+  if (s_current->mosq && mosquitto_socket(s_current->mosq) >= 0) {
+    shutdown(mosquitto_socket(s_current->mosq), SHUT_RDWR);
+  }
+}
+
+static void sim_ap_start(void)
+{
+}
+
+static void sim_ap_stop(void)
+{
+}
+
+static void sim_mqtt_connect(void)
+{
+  vdev_t *dev = s_current;
+
+  s_peaks.connects++;
+  if (dev->mosq == NULL) {
+    if (!dev_client_new(dev)) return;
+    mosquitto_connect_async(dev->mosq, s_args.host, s_args.port, FLEET_KEEPALIVE_S);
+  } else {
+    dev_mqtt_lost(dev);
+    mosquitto_reconnect_async(dev->mosq);
+  }
+}
+
+static void sim_timer_start(uint32_t ms)
+{
+  s_current->timer_at_ms = s_now_ms + (ms ? ms : 1);
+}
+
+static void sim_timer_stop(void)
+{
+  s_current->timer_at_ms = 0;
+}
+
+static uint32_t sim_random(void)
+{
+  return xorshift(&s_current->rng);
+}
+
+// Igual ao firmware: cada transição vai para <mac>/conectividade em QoS 1
+static void sim_on_transition(const conn_fsm_t *fsm, conn_state_t from, conn_state_t to)
+{
+  if (s_current->mosq == NULL) return;
+
+  char msg[128];
+  int len = snprintf(msg, sizeof(msg), "{\"de\":\"%s\",\"para\":\"%s\",\"n\":%" PRIu32 ",\"backoff_ms\":%" PRIu32 "}",
+                     conn_state_name(from), conn_state_name(to), fsm->transitions, fsm->backoff_ms);
+  dev_publish(s_current, TOPIC_CONECTIVIDADE, msg, len);
+}
+
+static const conn_ops_t sim_conn_ops = {
+  .wifi_connect = sim_wifi_connect,
+  .wifi_disconnect = sim_wifi_disconnect,
+  .ap_start = sim_ap_start,
+  .ap_stop = sim_ap_stop,
+  .mqtt_connect = sim_mqtt_connect,
+  .timer_start = sim_timer_start,
+  .timer_stop = sim_timer_stop,
+  .random = sim_random,
+  .on_transition = sim_on_transition,
+};
+
+// -----------------------------------------------------------------------------------------------------------
+// CICLO DE VIDA DO DISPOSITIVO
+// -----------------------------------------------------------------------------------------------------------
+
+static void dev_boot(vdev_t *dev)
+{
+  dev->boot_at_ms = 0;
+
+  adaptive_config_t sampler_cfg = ADAPTIVE_CONFIG_DEFAULT();
+  sampler_cfg.min_interval_ms = s_cfg.interval_min_ms;
+  sampler_cfg.max_interval_ms = s_cfg.interval_max_ms;
+  adaptive_init(&dev->sampler, &sampler_cfg);
+  app_change_filter_reset(&dev->changed);
+  dev->next_sample_ms = s_now_ms;
+
+  conn_fsm_init(&dev->conn, &sim_conn_ops);
+  dev->conn.spread_ms = s_args.stagger ? CONN_SPREAD_MS : 0;
+  dev_event(dev, CONN_EV_START);
+}
+
+static void dev_schedule_outage(vdev_t *dev)
+{
+  if (s_args.outage_mtbf_s == 0) return;
+  double gap = -log(1.0 - rng_unit(&dev->rng)) * s_args.outage_mtbf_s * 1000.0;
+  dev->next_outage_ms = s_now_ms + (int64_t)gap;
+}
+
+static void dev_init(vdev_t *dev, uint32_t index)
+{
+  memset(dev, 0, sizeof(*dev));
+  dev->index = index;
+  dev->rng = mix(s_args.seed, index);
+
+  uint32_t mac = s_args.mac_base + index;
+  snprintf(dev->mac, sizeof(dev->mac), "24:6F:28:%02X:%02X:%02X", (mac >> 16) & 0xFF, (mac >> 8) & 0xFF, mac & 0xFF);
+  for (int t = 0; t < TOPIC_COUNT; t++) {
+    dev->topic_len[t] = app_format_topic(dev->topics[t], FLEET_TOPIC_LEN, dev->mac, s_topic_suffix[t]);
+  }
+
+  dev->phase_seed = app_phase_seed(dev->mac);
+  dev->base[METRIC_TEMPERATURA] = 180 + rng_unit(&dev->rng) * 100;
+  dev->base[METRIC_UMIDADE] = 400 + rng_unit(&dev->rng) * 300;
+  dev->phase = rng_unit(&dev->rng) * 2 * M_PI;
+  dev->trace_pos = xorshift(&dev->rng);
+
+  dev->boot_at_ms = s_start_ms + (int64_t)(rng_unit(&dev->rng) * s_args.boot_spread_s * 1000.0);
+  dev_schedule_outage(dev);
+}
+
+static void dev_tick(vdev_t *dev)
+{
+  if (dev->boot_at_ms) {
+    if (s_now_ms >= dev->boot_at_ms) dev_boot(dev);
+    return;
+  }
+
+  if (dev->next_outage_ms && s_now_ms >= dev->next_outage_ms) {
+    uint32_t span = s_args.outage_max_s > s_args.outage_min_s ? s_args.outage_max_s - s_args.outage_min_s : 0;
+    dev->outage_until_ms = s_now_ms + (int64_t)((s_args.outage_min_s + rng_unit(&dev->rng) * span) * 1000.0);
+    dev_wifi_lost(dev);
+    dev_schedule_outage(dev);
+  }
+
+  if (dev->assoc_at_ms && s_now_ms >= dev->assoc_at_ms) {
+    dev->assoc_at_ms = 0;
+    dev->wifi_up = true;
+    dev_event(dev, CONN_EV_GOT_IP);
+  }
+
+  if (dev->timer_at_ms && s_now_ms >= dev->timer_at_ms) {
+    dev->timer_at_ms = 0;
+    dev_event(dev, CONN_EV_TIMER);
+  }
+
+  if (s_now_ms >= dev->next_sample_ms) dev_sample(dev);
+}
+
+// Falta de energia em todos: filas perdidas, todos religam no mesmo instante (mais o tempo de boot)
+static void storm(void)
+{
+  int64_t back_ms = s_now_ms + s_args.storm_down_s * 1000LL;
+  for (uint32_t i = 0; i < s_args.devices; i++) {
+    vdev_t *dev = &s_devs[i];
+    dev_power_off(dev);
+    dev->boot_at_ms = rng_range_ms(&dev->rng, back_ms + FLEET_BOOT_MS, FLEET_BOOT_JITTER_MS);
+  }
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// MONITOR $SYS
+// -----------------------------------------------------------------------------------------------------------
+
+static void sys_on_connect(struct mosquitto *mosq, void *obj, int rc)
+{
+  if (rc != 0) return;
+  mosquitto_subscribe(mosq, NULL, "$SYS/broker/load/messages/received/1min", 0);
+  mosquitto_subscribe(mosq, NULL, "$SYS/broker/load/bytes/received/1min", 0);
+  mosquitto_subscribe(mosq, NULL, "$SYS/broker/clients/connected", 0);
+}
+
+static void sys_on_message(struct mosquitto *mosq, void *obj, const struct mosquitto_message *msg)
+{
+  char value[32];
+  int len = msg->payloadlen < (int)sizeof(value) - 1 ? msg->payloadlen : (int)sizeof(value) - 1;
+  memcpy(value, msg->payload, len);
+  value[len] = '\0';
+
+  if (strstr(msg->topic, "messages/received")) {
+    s_sys_msgs_min = atof(value);
+  } else if (strstr(msg->topic, "bytes/received")) {
+    s_sys_bytes_min = atof(value);
+  } else if (strstr(msg->topic, "clients/connected")) {
+    s_sys_clients = atol(value);
+  }
+}
+
+static void sys_start(void)
+{
+  s_sys = mosquitto_new(NULL, true, NULL);
+  if (s_sys == NULL) return;
+  if (s_args.username) mosquitto_username_pw_set(s_sys, s_args.username, s_args.password);
+  mosquitto_connect_callback_set(s_sys, sys_on_connect);
+  mosquitto_message_callback_set(s_sys, sys_on_message);
+  if (mosquitto_connect_async(s_sys, s_args.host, s_args.port, 60) != MOSQ_ERR_SUCCESS) {
+    fprintf(stderr, "aviso: monitor $SYS não conectou; só as métricas do lado dos clientes\n");
+  }
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// LAÇO PRINCIPAL
+// -----------------------------------------------------------------------------------------------------------
+
+static void io_service(struct pollfd *fds, struct mosquitto **owners, bool misc)
+{
+  nfds_t n = 0;
+  for (uint32_t i = 0; i <= s_args.devices; i++) {
+    struct mosquitto *mosq = i < s_args.devices ? s_devs[i].mosq : s_sys;
+    if (mosq == NULL) continue;
+    int sock = mosquitto_socket(mosq);
+    if (sock < 0) continue;
+    fds[n] = (struct pollfd) { .fd = sock, .events = POLLIN | (mosquitto_want_write(mosq) ? POLLOUT : 0) };
+    owners[n++] = mosq;
+  }
+
+  if (poll(fds, n, FLEET_POLL_MS) < 0 && errno != EINTR) {
+    perror("poll");
+    return;
+  }
+
+  for (nfds_t k = 0; k < n; k++) {
+    struct mosquitto *mosq = owners[k];
+    vdev_t *dev = mosq == s_sys ? NULL : mosquitto_userdata(mosq);
+    if (dev) s_current = dev;
+
+    int rc = MOSQ_ERR_SUCCESS;
+    if (fds[k].revents & (POLLIN | POLLERR | POLLHUP)) rc = mosquitto_loop_read(mosq, 1);
+    if (rc == MOSQ_ERR_SUCCESS && (fds[k].revents & POLLOUT)) rc = mosquitto_loop_write(mosq, 1);
+    // Conexão perdida sem callback (versões antigas do libmosquitto): a máquina precisa saber
+    if (rc != MOSQ_ERR_SUCCESS && dev && dev->mqtt_up) on_disconnect(mosq, dev, rc);
+  }
+
+  if (misc) {
+    for (nfds_t k = 0; k < n; k++) mosquitto_loop_misc(owners[k]);
+  }
+}
+
+static void report_header(void)
+{
+  if (s_args.csv) {
+    printf("t_s,conectados,pub_s,puback_s,fila_offline,bytes_out_s,bytes_in_s,conexoes,quedas,"
+           "p50_ms,p95_ms,p99_ms,broker_msgs_s,broker_bytes_s,broker_clientes\n");
+  } else {
+    printf("%6s %7s %9s %9s %8s %11s %10s %6s %6s %8s %8s %8s %10s %9s\n", "t (s)", "online", "pub/s",
+           "puback/s", "fila off", "bytes out/s", "bytes in/s", "conex", "quedas", "p50 ms", "p95 ms", "p99 ms",
+           "broker m/s", "clientes");
+  }
+}
+
+static void report(double elapsed_s, double window_s)
+{
+  const fleet_stats_t *st = &s_interval;
+  double p50 = lat_percentile_ms(st, 0.50), p95 = lat_percentile_ms(st, 0.95), p99 = lat_percentile_ms(st, 0.99);
+  double broker_msgs = s_sys_msgs_min >= 0 ? s_sys_msgs_min / 60.0 : -1;
+  double broker_bytes = s_sys_bytes_min >= 0 ? s_sys_bytes_min / 60.0 : -1;
+
+  if (s_args.csv) {
+    printf("%.1f,%" PRIu32 ",%.1f,%.1f,%" PRIu64 ",%.0f,%.0f,%" PRIu64 ",%" PRIu64 ",%.2f,%.2f,%.2f,%.1f,%.0f,%ld\n",
+           elapsed_s, s_online, st->published / window_s, st->acked / window_s, st->queued_offline,
+           st->bytes_out / window_s, st->bytes_in / window_s, st->connects, st->drops, p50, p95, p99, broker_msgs,
+           broker_bytes, s_sys_clients);
+  } else {
+    printf("%6.0f %7" PRIu32 " %9.1f %9.1f %8" PRIu64 " %11.0f %10.0f %6" PRIu64 " %6" PRIu64 " %8.2f %8.2f %8.2f "
+           "%10.1f %9ld\n", elapsed_s, s_online, st->published / window_s, st->acked / window_s, st->queued_offline,
+           st->bytes_out / window_s, st->bytes_in / window_s, st->connects, st->drops, p50, p95, p99, broker_msgs,
+           s_sys_clients);
+  }
+  fflush(stdout);
+}
+
+static void summary(double elapsed_s, int64_t storm_recovered_ms)
+{
+  const fleet_stats_t *st = &s_total;
+  FILE *out = s_args.csv ? stderr : stdout;
+
+  fprintf(out, "\n%" PRIu32 " dispositivos, %.0f s\n", s_args.devices, elapsed_s);
+  fprintf(out, "publicadas      %" PRIu64 " (%.1f/s, %" PRIu64 " enquanto offline)\n", st->published,
+          st->published / elapsed_s, st->queued_offline);
+  fprintf(out, "PUBACKs         %" PRIu64 " (%.1f/s, %" PRIu64 " pendentes no fim)\n", st->acked,
+          st->acked / elapsed_s, st->published - st->acked);
+  fprintf(out, "bytes no fio    %.0f/s saindo, %.0f/s voltando\n", st->bytes_out / elapsed_s, st->bytes_in / elapsed_s);
+  fprintf(out, "por dispositivo %.3f msgs/s, %.1f bytes/s\n", st->published / elapsed_s / s_args.devices,
+          st->bytes_out / elapsed_s / s_args.devices);
+  fprintf(out, "conexões        %" PRIu64 ", quedas %" PRIu64 "\n", st->connects, st->drops);
+  fprintf(out, "latência PUBACK p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, p99.9 %.2f ms (%" PRIu64 " sem horário)\n",
+          lat_percentile_ms(st, 0.50), lat_percentile_ms(st, 0.95), lat_percentile_ms(st, 0.99),
+          lat_percentile_ms(st, 0.999), st->unmeasured);
+  fprintf(out, "pico (%d ms)    %.0f CONNECT/s, %.0f msgs aceitas/s%s\n", FLEET_PEAK_SLOT_MS,
+          s_peaks.peak_connects * 1000.0 / FLEET_PEAK_SLOT_MS, s_peaks.peak_acked * 1000.0 / FLEET_PEAK_SLOT_MS,
+          s_args.stagger ? "" : " (--no-stagger)");
+  if (s_args.storm_at_s) {
+    fprintf(out, "pico pós-volta  %.0f CONNECT/s, %.0f msgs aceitas/s\n",
+            s_peaks.storm_peak_connects * 1000.0 / FLEET_PEAK_SLOT_MS,
+            s_peaks.storm_peak_acked * 1000.0 / FLEET_PEAK_SLOT_MS);
+    if (storm_recovered_ms >= 0) {
+      fprintf(out, "tempestade      99%% online de novo %.1f s depois da volta da energia\n", storm_recovered_ms / 1000.0);
+    } else {
+      fprintf(out, "tempestade      a frota não voltou a 99%% online até o fim\n");
+    }
+  }
+}
+
+// Cada dispositivo é um socket: sobe o limite de descritores até o máximo permitido
+static void raise_fd_limit(void)
+{
+  struct rlimit lim;
+  if (getrlimit(RLIMIT_NOFILE, &lim) != 0) return;
+  lim.rlim_cur = lim.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &lim);
+  getrlimit(RLIMIT_NOFILE, &lim);
+  if (lim.rlim_cur != RLIM_INFINITY && lim.rlim_cur < s_args.devices + 64) {
+    fprintf(stderr, "aviso: limite de descritores %lu < %" PRIu32 " dispositivos (ulimit -n)\n",
+            (unsigned long)lim.rlim_cur, s_args.devices);
+  }
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+          "uso: %s [--devices N] [--host H] [--port P] [--username U --password S] [--duration S]\n"
+          "          [--boot-spread S] [--trace arquivo.csv] [--noise D] [--interval-min MS] [--interval-max MS]\n"
+          "          [--outage-mtbf S] [--outage-min S] [--outage-max S] [--storm-at S] [--storm-down S]\n"
+          "          [--report S] [--seed N] [--mac-base N] [--csv] [--no-sys] [--no-stagger]\n", prog);
+}
+
+static bool parse_args(int argc, char **argv)
+{
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+    bool takes = true;
+
+    if (strcmp(a, "--csv") == 0) {
+      s_args.csv = true;
+      takes = false;
+    } else if (strcmp(a, "--no-sys") == 0) {
+      s_args.sys = false;
+      takes = false;
+    } else if (strcmp(a, "--no-stagger") == 0) {
+      s_args.stagger = false;
+      takes = false;
+    } else if (v == NULL) {
+      return false;
+    } else if (strcmp(a, "--devices") == 0) {
+      s_args.devices = strtoul(v, NULL, 10);
+    } else if (strcmp(a, "--host") == 0) {
+      s_args.host = v;
+    } else if (strcmp(a, "--port") == 0) {
+      s_args.port = atoi(v);
+    } else if (strcmp(a, "--username") == 0) {
+      s_args.username = v;
+    } else if (strcmp(a, "--password") == 0) {
+      s_args.password = v;
+    } else if (strcmp(a, "--duration") == 0) {
+      s_args.duration_s = strtoul(v, NULL, 10);
+    } else if (strcmp(a, "--boot-spread") == 0) {
+      s_args.boot_spread_s = strtoul(v, NULL, 10);
+    } else if (strcmp(a, "--trace") == 0) {
+      s_args.trace = v;
+    } else if (strcmp(a, "--noise") == 0) {
+      s_args.noise = atof(v);
+    } else if (strcmp(a, "--interval-min") == 0) {
+      s_args.interval_min_ms = strtoul(v, NULL, 10);
+    } else if (strcmp(a, "--interval-max") == 0) {
+      s_args.interval_max_ms = strtoul(v, NULL, 10);
+    } else if (strcmp(a, "--outage-mtbf") == 0) {
+      s_args.outage_mtbf_s = strtoul(v, NULL, 10);
+    } else if (strcmp(a, "--outage-min") == 0) {
+      s_args.outage_min_s = strtoul(v, NULL, 10);
+    } else if (strcmp(a, "--outage-max") == 0) {
+      s_args.outage_max_s = strtoul(v, NULL, 10);
+    } else if (strcmp(a, "--storm-at") == 0) {
+      s_args.storm_at_s = strtoul(v, NULL, 10);
+    } else if (strcmp(a, "--storm-down") == 0) {
+      s_args.storm_down_s = strtoul(v, NULL, 10);
+    } else if (strcmp(a, "--report") == 0) {
+      s_args.report_s = strtoul(v, NULL, 10);
+    } else if (strcmp(a, "--seed") == 0) {
+      s_args.seed = strtoul(v, NULL, 10);
+    } else if (strcmp(a, "--mac-base") == 0) {
+      s_args.mac_base = strtoul(v, NULL, 0);
+    } else {
+      return false;
+    }
+    if (takes) i++;
+  }
+  return s_args.devices > 0 && s_args.report_s > 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (!parse_args(argc, argv)) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (s_args.trace && !trace_load(s_args.trace)) {
+    fprintf(stderr, "não foi possível ler o traço %s\n", s_args.trace);
+    return 2;
+  }
+
+  app_config_defaults(&s_cfg);
+  if (s_args.interval_min_ms) s_cfg.interval_min_ms = s_args.interval_min_ms;
+  if (s_args.interval_max_ms) s_cfg.interval_max_ms = s_args.interval_max_ms;
+  if (s_cfg.interval_max_ms < s_cfg.interval_min_ms) s_cfg.interval_max_ms = s_cfg.interval_min_ms;
+
+  raise_fd_limit();
+  mosquitto_lib_init();
+
+  s_devs = calloc(s_args.devices, sizeof(*s_devs));
+  struct pollfd *fds = calloc(s_args.devices + 1, sizeof(*fds));
+  struct mosquitto **owners = calloc(s_args.devices + 1, sizeof(*owners));
+  if (s_devs == NULL || fds == NULL || owners == NULL) {
+    fprintf(stderr, "sem memória para %" PRIu32 " dispositivos\n", s_args.devices);
+    return 1;
+  }
+
+  s_start_ms = s_now_ms = now_us() / 1000;
+  for (uint32_t i = 0; i < s_args.devices; i++) dev_init(&s_devs[i], i);
+  if (s_args.sys) sys_start();
+
+  report_header();
+  int64_t end_ms = s_start_ms + s_args.duration_s * 1000LL;
+  int64_t storm_ms = s_args.storm_at_s ? s_start_ms + s_args.storm_at_s * 1000LL : 0;
+  int64_t storm_recovered_ms = -1;
+  int64_t last_report_ms = s_start_ms, last_misc_ms = s_start_ms;
+
+  while ((s_now_ms = now_us() / 1000) < end_ms) {
+    if (storm_ms && s_now_ms >= storm_ms) {
+      storm();
+      storm_ms = 0;
+      s_storm_back_ms = s_now_ms + s_args.storm_down_s * 1000LL;
+    }
+    if (s_storm_back_ms && storm_recovered_ms < 0 && s_now_ms >= s_storm_back_ms &&
+        s_online * 100ULL >= s_args.devices * 99ULL) {
+      storm_recovered_ms = s_now_ms - s_storm_back_ms;
+    }
+    peaks_roll(s_now_ms);
+
+    for (uint32_t i = 0; i < s_args.devices; i++) dev_tick(&s_devs[i]);
+
+    bool misc = s_now_ms - last_misc_ms >= FLEET_MISC_PERIOD_MS;
+    if (misc) last_misc_ms = s_now_ms;
+    io_service(fds, owners, misc);
+
+    if (s_now_ms - last_report_ms >= s_args.report_s * 1000LL) {
+      report((s_now_ms - s_start_ms) / 1000.0, (s_now_ms - last_report_ms) / 1000.0);
+      stats_add(&s_total, &s_interval);
+      memset(&s_interval, 0, sizeof(s_interval));
+      last_report_ms = s_now_ms;
+    }
+  }
+  stats_add(&s_total, &s_interval);
+  peaks_roll(s_now_ms + FLEET_PEAK_SLOT_MS);
+
+  summary((s_now_ms - s_start_ms) / 1000.0, storm_recovered_ms);
+
+  for (uint32_t i = 0; i < s_args.devices; i++) {
+    if (s_devs[i].mosq) mosquitto_destroy(s_devs[i].mosq);
+  }
+  if (s_sys) mosquitto_destroy(s_sys);
+  mosquitto_lib_cleanup();
+  free(owners);
+  free(fds);
+  free(s_devs);
+  free(s_trace);
+  return 0;
+}
@@ -0,0 +1,209 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_partition.h"
+#include "flash_log.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// BENCHMARK DO HISTÓRICO EM FLASH
+//
+// Roda o flash_log.c do firmware sobre uma partição em RAM do tamanho da de partitions.csv: enche o
+// anel até dar a volta, mede a taxa de gravação e a latência de consultas típicas de /api/history e
+// confere o conteúdo (ordem, valores, remontagem e CRC de um registro corrompido).
+// O tempo de host mede só a CPU. O tempo de flash no ESP32 é estimado a partir das operações contadas
+// pelo mock, com os tempos típicos de uma NOR SPI de 4 MB (programação de página, apagamento de setor
+// de 4 KB, leitura a 40 MHz); o pior caso do chip é bem maior, principalmente no apagamento.
+//
+//   ./build-host/history_bench [--size bytes]
+// Sai com 1 se alguma verificação falhar.
+// -----------------------------------------------------------------------------------------------------------
+
+#define PARTITION_SIZE     (2 * 1024 * 1024)
+#define PERIOD_S           10            // HISTORY_PERIOD_S do main.c
+#define START_EPOCH        1735689600    // 01/01/2025
+
+#define FLASH_PROGRAM_US   700           // uma gravação (até uma página de 256 B)
+#define FLASH_ERASE_US     45000         // um setor de 4 KB
+#define FLASH_READ_CALL_US 15            // comando + endereço de cada leitura
+#define FLASH_READ_KB_US   100           // ~10 MB/s em DIO a 40 MHz
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                \
+  do {                                  \
+    if (!(cond)) {                      \
+      printf("FALHOU: " __VA_ARGS__);   \
+      printf("\n");                     \
+      s_failures++;                     \
+    }                                   \
+  } while (0)
+
+static int16_t temperatura_at(uint32_t i)
+{
+  return (int16_t)(i % 1200) - 400;   // -40,0..79,9 °C
+}
+
+static int16_t umidade_at(uint32_t i)
+{
+  return (int16_t)((i * 7) % 1001);
+}
+
+static int64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static double flash_us(const esp_partition_mock_stats_t *a, const esp_partition_mock_stats_t *b)
+{
+  return (b->writes - a->writes) * (double)FLASH_PROGRAM_US + (b->erases - a->erases) * (double)FLASH_ERASE_US +
+         (b->reads - a->reads) * (double)FLASH_READ_CALL_US +
+         (b->read_bytes - a->read_bytes) / 1024.0 * FLASH_READ_KB_US;
+}
+
+typedef struct {
+  uint32_t records;
+  uint32_t last_ts;
+  uint32_t out_of_order;
+  uint32_t wrong_values;
+  bool check_values;
+} query_ctx_t;
+
+static esp_err_t query_cb(const flash_log_record_t *records, size_t count, void *arg)
+{
+  query_ctx_t *ctx = arg;
+  for (size_t i = 0; i < count; i++) {
+    if (records[i].timestamp < ctx->last_ts) ctx->out_of_order++;
+    ctx->last_ts = records[i].timestamp;
+    if (ctx->check_values) {
+      uint32_t index = (records[i].timestamp - START_EPOCH) / PERIOD_S;
+      if (records[i].temperatura != temperatura_at(index) || records[i].umidade != umidade_at(index)) {
+        ctx->wrong_values++;
+      }
+    }
+    ctx->records++;
+  }
+  return ESP_OK;
+}
+
+static void query(const char *name, uint32_t from, uint32_t to, uint32_t expected)
+{
+  esp_partition_mock_stats_t before, after;
+  query_ctx_t ctx = { .check_values = true };
+
+  esp_partition_mock_get_stats(&before);
+  int64_t start = now_ns();
+  esp_err_t err = flash_log_query(from, to, query_cb, &ctx);
+  double host_us = (now_ns() - start) / 1000.0;
+  esp_partition_mock_get_stats(&after);
+
+  printf("%-18s %9" PRIu32 " %10.1f %8" PRIu64 " %10" PRIu64 " %12.1f\n", name, ctx.records, host_us,
+         after.reads - before.reads, after.read_bytes - before.read_bytes, flash_us(&before, &after) / 1000.0);
+  CHECK(err == ESP_OK, "%s: %s", name, esp_err_to_name(err));
+  CHECK(ctx.records == expected, "%s: %" PRIu32 " registros, esperado %" PRIu32, name, ctx.records, expected);
+  CHECK(ctx.out_of_order == 0, "%s: %" PRIu32 " registros fora de ordem", name, ctx.out_of_order);
+  CHECK(ctx.wrong_values == 0, "%s: %" PRIu32 " valores errados", name, ctx.wrong_values);
+}
+
+int main(int argc, char **argv)
+{
+  size_t size = PARTITION_SIZE;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      size = strtoul(argv[++i], NULL, 0);
+    } else {
+      fprintf(stderr, "uso: %s [--size bytes]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  esp_partition_mock_reset(FLASH_LOG_PARTITION, size);
+  if (flash_log_init() != ESP_OK) {
+    fprintf(stderr, "flash_log_init falhou\n");
+    return 1;
+  }
+
+  // Capacidade
+  uint32_t capacity = flash_log_capacity();
+  uint32_t segment_records = capacity / (size / FLASH_LOG_SEGMENT_SIZE);
+  uint32_t retained = capacity - segment_records;   // depois da volta, um segmento está sempre recém-apagado
+  printf("partição %zu KB: %" PRIu32 " registros (%" PRIu32 " por segmento)\n", size / 1024, capacity,
+         segment_records);
+  printf("retenção: %.1f dias a 1 registro / %d s, %.1f dias a 1 / 2,5 s\n\n",
+         retained * (double)PERIOD_S / 86400, PERIOD_S, retained * 2.5 / 86400);
+
+  // Gravação: enche o anel e dá mais meia volta
+  uint32_t total = capacity + capacity / 2;
+  esp_partition_mock_stats_t before, after;
+  esp_partition_mock_get_stats(&before);
+  int64_t start = now_ns();
+  int64_t worst_ns = 0;
+  for (uint32_t i = 0; i < total; i++) {
+    int64_t t0 = now_ns();
+    esp_err_t err = flash_log_append(START_EPOCH + i * PERIOD_S, temperatura_at(i), umidade_at(i));
+    int64_t dt = now_ns() - t0;
+    if (dt > worst_ns) worst_ns = dt;
+    if (err != ESP_OK) {
+      CHECK(false, "append %" PRIu32 ": %s", i, esp_err_to_name(err));
+      break;
+    }
+  }
+  int64_t host_ns = now_ns() - start;
+  esp_partition_mock_get_stats(&after);
+
+  double per_append_us = flash_us(&before, &after) / total;
+  printf("gravação: %" PRIu32 " registros\n", total);
+  printf("  host: %.0f ns/registro (pior %.1f us)\n", (double)host_ns / total, worst_ns / 1000.0);
+  printf("  flash: %.2f gravações e %.4f setores apagados por registro, %" PRIu64 " apagamentos no total\n",
+         (double)(after.writes - before.writes) / total, (double)(after.erases - before.erases) / total,
+         after.erases - before.erases);
+  printf("  ESP32 (estimado): %.0f us/registro em média, %.0f registros/s; troca de segmento +%.0f ms\n\n",
+         per_append_us, 1e6 / per_append_us, FLASH_LOG_SEGMENT_SIZE / ESP_PARTITION_MOCK_SECTOR * FLASH_ERASE_US / 1000.0);
+  CHECK(after.bad_writes == 0, "%" PRIu64 " gravações sobre bits já programados", after.bad_writes);
+
+  flash_log_stats_t stats;
+  flash_log_get_stats(&stats);
+  uint32_t first = total - stats.records;
+  uint32_t last_ts = START_EPOCH + (total - 1) * PERIOD_S;
+  CHECK(stats.records >= retained && stats.records <= capacity, "%" PRIu32 " registros retidos", stats.records);
+  CHECK(stats.newest_ts == last_ts, "newest_ts %" PRIu32, stats.newest_ts);
+  CHECK(stats.oldest_ts == START_EPOCH + first * PERIOD_S, "oldest_ts %" PRIu32, stats.oldest_ts);
+
+  // Consultas típicas de /api/history
+  uint32_t per_hour = 3600 / PERIOD_S;
+  printf("%-18s %9s %10s %8s %10s %12s\n", "consulta", "registros", "host us", "leituras", "bytes", "ESP32 ms est");
+  query("última hora", last_ts - 3600 + PERIOD_S, UINT32_MAX, per_hour);
+  query("último dia", last_ts - 86400 + PERIOD_S, UINT32_MAX, 24 * per_hour);
+  query("1 h no meio", stats.oldest_ts + stats.records / 2 * PERIOD_S,
+        stats.oldest_ts + stats.records / 2 * PERIOD_S + 3600 - 1, per_hour);
+  uint32_t point_ts = stats.oldest_ts + stats.records / 4 * PERIOD_S;
+  query("ponto", point_ts, point_ts, 1);
+  query("tudo", 0, UINT32_MAX, stats.records);
+
+  // Remontagem: mesmo estado depois de um reboot
+  flash_log_stats_t remounted;
+  CHECK(flash_log_init() == ESP_OK, "remontagem");
+  flash_log_get_stats(&remounted);
+  CHECK(remounted.records == stats.records && remounted.oldest_ts == stats.oldest_ts &&
+        remounted.newest_ts == stats.newest_ts, "remontagem mudou o estado");
+
+  // Registro corrompido: some da consulta e conta um erro de CRC
+  uint8_t *data = esp_partition_mock_data();
+  size_t corrupt = size / 2 + 2048;   // início de um registro, longe do cabeçalho e do índice do segmento
+  data[corrupt] ^= 0x01;
+  data[corrupt + 4] ^= 0x08;
+  query_ctx_t ctx = { 0 };
+  flash_log_query(0, UINT32_MAX, query_cb, &ctx);
+  flash_log_get_stats(&remounted);
+  printf("\ncorrupção: %" PRIu32 " de %" PRIu32 " registros lidos, %" PRIu32 " erro(s) de CRC\n", ctx.records,
+         stats.records, remounted.crc_errors);
+  CHECK(ctx.records + 1 >= stats.records && remounted.crc_errors >= 1, "registro corrompido passou pelo CRC");
+
+  printf("%s\n", s_failures ? "FALHOU" : "OK");
+  return s_failures ? 1 : 0;
+}
@@ -0,0 +1,8 @@
+#ifndef MOCK_ESP_IDF_LIB_HELPERS_H
+#define MOCK_ESP_IDF_LIB_HELPERS_H
+
+// O host se passa por ESP32 para os componentes do esp-idf-lib
+#define HELPER_TARGET_IS_ESP32    1
+#define HELPER_TARGET_IS_ESP8266  0
+
+#endif // MOCK_ESP_IDF_LIB_HELPERS_H
@@ -0,0 +1,44 @@
+#ifndef MOCK_ESP_PARTITION_H
+#define MOCK_ESP_PARTITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Partição de dados em RAM com a semântica de NOR flash: apagar deixa 0xFF e gravar só derruba bits.
+// Conta leituras, gravações e apagamentos para estimar o tempo de flash no ESP32.
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00, ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+#define ESP_PARTITION_MOCK_SECTOR  4096
+
+typedef struct {
+  esp_partition_type_t type;
+  uint32_t address;
+  uint32_t size;
+  uint32_t erase_size;
+  char label[17];
+} esp_partition_t;
+
+typedef struct {
+  uint64_t reads;
+  uint64_t read_bytes;
+  uint64_t writes;
+  uint64_t write_bytes;
+  uint64_t erases;          // setores de ESP_PARTITION_MOCK_SECTOR
+  uint64_t bad_writes;      // gravações que tentaram subir um bit de 0 para 1
+} esp_partition_mock_stats_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size);
+
+// Cria (ou recria, toda apagada) a partição com o rótulo e o tamanho dados; size 0 remove
+void esp_partition_mock_reset(const char *label, size_t size);
+void esp_partition_mock_get_stats(esp_partition_mock_stats_t *stats);
+// Acesso direto ao conteúdo, para simular corrupção
+uint8_t *esp_partition_mock_data(void);
+
+#endif // MOCK_ESP_PARTITION_H
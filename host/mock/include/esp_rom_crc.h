@@ -0,0 +1,10 @@
+#ifndef MOCK_ESP_ROM_CRC_H
+#define MOCK_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// Mesmos polinômios e convenção (valor inicial e final invertidos) das funções da ROM
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len);
+uint8_t esp_rom_crc8_le(uint8_t crc, uint8_t const *buf, uint32_t len);
+
+#endif // MOCK_ESP_ROM_CRC_H
@@ -0,0 +1,9 @@
+#ifndef MOCK_ESP_TIMER_H
+#define MOCK_ESP_TIMER_H
+
+#include <stdint.h>
+
+// Relógio monotônico do host em microssegundos
+int64_t esp_timer_get_time(void);
+
+#endif // MOCK_ESP_TIMER_H
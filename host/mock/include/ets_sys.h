@@ -0,0 +1,9 @@
+#ifndef MOCK_ETS_SYS_H
+#define MOCK_ETS_SYS_H
+
+#include <stdint.h>
+
+// Espera ativa: no emulador só avança o relógio virtual
+void ets_delay_us(uint32_t us);
+
+#endif // MOCK_ETS_SYS_H
@@ -0,0 +1,22 @@
+#ifndef MOCK_FREERTOS_H
+#define MOCK_FREERTOS_H
+
+#include <stdint.h>
+
+// Os programas de host rodam numa thread só: mutexes e seções críticas viram no-ops
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define pdTRUE          1
+#define pdFALSE         0
+#define portMAX_DELAY   ((TickType_t)0xffffffffUL)
+
+typedef struct {
+  int locked;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED  { 0 }
+#define portENTER_CRITICAL(mux)       ((mux)->locked = 1)
+#define portEXIT_CRITICAL(mux)        ((mux)->locked = 0)
+
+#endif // MOCK_FREERTOS_H
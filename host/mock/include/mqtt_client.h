@@ -0,0 +1,31 @@
+#ifndef MOCK_MQTT_CLIENT_H
+#define MOCK_MQTT_CLIENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Cliente esp-mqtt falso: aceita tudo, devolve msg_ids crescentes e só conta o que recebeu
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+
+typedef enum {
+  MQTT_PROTOCOL_UNDEFINED = 0,
+  MQTT_PROTOCOL_V_3_1,
+  MQTT_PROTOCOL_V_3_1_1,
+  MQTT_PROTOCOL_V_5,
+} esp_mqtt_protocol_ver_t;
+
+typedef struct {
+  uint32_t published;
+  uint32_t enqueued;
+  uint32_t bytes;
+  int fail_next;       // quantas chamadas seguintes devolvem -1
+} mqtt_mock_t;
+
+esp_mqtt_client_handle_t mqtt_mock_client(void);
+mqtt_mock_t *mqtt_mock_state(void);
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain);
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain, bool store);
+
+#endif // MOCK_MQTT_CLIENT_H
@@ -0,0 +1,32 @@
+#ifndef MOCK_NVS_H
+#define MOCK_NVS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// NVS em memória: um namespace só, tipos inteiros, tamanho fixo
+typedef uint32_t nvs_handle_t;
+typedef nvs_handle_t nvs_handle;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+
+#define NVS_MOCK_MAX_KEYS  64
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value);
+esp_err_t nvs_set_i16(nvs_handle_t handle, const char *key, int16_t value);
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char *key, uint16_t value);
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value);
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *value);
+esp_err_t nvs_get_i16(nvs_handle_t handle, const char *key, int16_t *value);
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char *key, uint16_t *value);
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *value);
+
+// Apaga tudo e zera os contadores
+void nvs_mock_reset(void);
+uint32_t nvs_mock_commits(void);
+
+#endif // MOCK_NVS_H
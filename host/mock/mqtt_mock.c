@@ -0,0 +1,45 @@
+#include <string.h>
+#include "mqtt_client.h"
+
+static mqtt_mock_t s_state;
+static int s_msg_id = 0;
+static int s_client;   // só o endereço importa
+
+esp_mqtt_client_handle_t mqtt_mock_client(void)
+{
+  return (esp_mqtt_client_handle_t)&s_client;
+}
+
+mqtt_mock_t *mqtt_mock_state(void)
+{
+  return &s_state;
+}
+
+static int accept(const char *topic, int len, int qos)
+{
+  if (s_state.fail_next > 0) {
+    s_state.fail_next--;
+    return -1;
+  }
+  s_state.bytes += strlen(topic) + len;
+  // Como o esp-mqtt: QoS 0 devolve 0, QoS>0 um msg_id novo
+  if (qos == 0) return 0;
+  s_msg_id = (s_msg_id % 0xFFFF) + 1;
+  return s_msg_id;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain)
+{
+  if (len == 0) len = strlen(data);
+  int msg_id = accept(topic, len, qos);
+  if (msg_id >= 0) s_state.published++;
+  return msg_id;
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain, bool store)
+{
+  if (len == 0) len = strlen(data);
+  int msg_id = accept(topic, len, qos);
+  if (msg_id >= 0) s_state.enqueued++;
+  return msg_id;
+}
@@ -0,0 +1,106 @@
+#include <string.h>
+#include "nvs.h"
+
+typedef enum { TYPE_U8, TYPE_I16, TYPE_U16, TYPE_U32 } nvs_type_t;
+
+typedef struct {
+  char key[16];   // limite de chave do NVS: 15 caracteres
+  nvs_type_t type;
+  uint32_t value;
+} nvs_entry_t;
+
+static nvs_entry_t s_entries[NVS_MOCK_MAX_KEYS];
+static int s_count = 0;
+static uint32_t s_commits = 0;
+
+static nvs_entry_t *find(const char *key)
+{
+  for (int i = 0; i < s_count; i++) {
+    if (strcmp(s_entries[i].key, key) == 0) return &s_entries[i];
+  }
+  return NULL;
+}
+
+static esp_err_t set(const char *key, nvs_type_t type, uint32_t value)
+{
+  if (strlen(key) >= sizeof(s_entries[0].key)) return ESP_ERR_INVALID_ARG;
+  nvs_entry_t *entry = find(key);
+  if (entry == NULL) {
+    if (s_count == NVS_MOCK_MAX_KEYS) return ESP_ERR_NO_MEM;
+    entry = &s_entries[s_count++];
+    strcpy(entry->key, key);
+  }
+  entry->type = type;
+  entry->value = value;
+  return ESP_OK;
+}
+
+// Como no NVS real, ler com tipo diferente do gravado é "não encontrado"
+static esp_err_t get(const char *key, nvs_type_t type, uint32_t *value)
+{
+  nvs_entry_t *entry = find(key);
+  if (entry == NULL || entry->type != type) return ESP_ERR_NVS_NOT_FOUND;
+  *value = entry->value;
+  return ESP_OK;
+}
+
+void nvs_mock_reset(void)
+{
+  s_count = 0;
+  s_commits = 0;
+}
+
+uint32_t nvs_mock_commits(void)
+{
+  return s_commits;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle)
+{
+  *handle = 1;
+  return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+  s_commits++;
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value) { return set(key, TYPE_U8, value); }
+esp_err_t nvs_set_i16(nvs_handle_t handle, const char *key, int16_t value) { return set(key, TYPE_I16, (uint16_t)value); }
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char *key, uint16_t value) { return set(key, TYPE_U16, value); }
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value) { return set(key, TYPE_U32, value); }
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *value)
+{
+  uint32_t v;
+  esp_err_t err = get(key, TYPE_U8, &v);
+  if (err == ESP_OK) *value = v;
+  return err;
+}
+
+esp_err_t nvs_get_i16(nvs_handle_t handle, const char *key, int16_t *value)
+{
+  uint32_t v;
+  esp_err_t err = get(key, TYPE_I16, &v);
+  if (err == ESP_OK) *value = (int16_t)v;
+  return err;
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char *key, uint16_t *value)
+{
+  uint32_t v;
+  esp_err_t err = get(key, TYPE_U16, &v);
+  if (err == ESP_OK) *value = v;
+  return err;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *value)
+{
+  return get(key, TYPE_U32, value);
+}
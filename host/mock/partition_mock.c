@@ -0,0 +1,95 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+static esp_partition_t s_part;
+static uint8_t *s_data = NULL;
+static esp_partition_mock_stats_t s_stats;
+
+void esp_partition_mock_reset(const char *label, size_t size)
+{
+  free(s_data);
+  s_data = NULL;
+  memset(&s_part, 0, sizeof(s_part));
+  memset(&s_stats, 0, sizeof(s_stats));
+  if (size == 0) return;
+
+  s_data = malloc(size);
+  memset(s_data, 0xFF, size);
+  s_part.type = ESP_PARTITION_TYPE_DATA;
+  s_part.size = size;
+  s_part.erase_size = ESP_PARTITION_MOCK_SECTOR;
+  strncpy(s_part.label, label, sizeof(s_part.label) - 1);
+}
+
+void esp_partition_mock_get_stats(esp_partition_mock_stats_t *stats)
+{
+  *stats = s_stats;
+}
+
+uint8_t *esp_partition_mock_data(void)
+{
+  return s_data;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+  if (s_data == NULL || type != s_part.type || (label != NULL && strcmp(label, s_part.label) != 0)) return NULL;
+  return &s_part;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t size)
+{
+  if (offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+  memcpy(dst, s_data + offset, size);
+  s_stats.reads++;
+  s_stats.read_bytes += size;
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t size)
+{
+  if (offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+  const uint8_t *bytes = src;
+  bool bad = false;
+  for (size_t i = 0; i < size; i++) {
+    if (bytes[i] & ~s_data[offset + i]) bad = true;
+    s_data[offset + i] &= bytes[i];
+  }
+  s_stats.writes++;
+  s_stats.write_bytes += size;
+  if (bad) s_stats.bad_writes++;
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size)
+{
+  if (offset % ESP_PARTITION_MOCK_SECTOR || size % ESP_PARTITION_MOCK_SECTOR) return ESP_ERR_INVALID_ARG;
+  if (offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+  memset(s_data + offset, 0xFF, size);
+  s_stats.erases += size / ESP_PARTITION_MOCK_SECTOR;
+  return ESP_OK;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+  }
+  return ~crc;
+}
+
+uint8_t esp_rom_crc8_le(uint8_t crc, uint8_t const *buf, uint32_t len)
+{
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0x8C & -(crc & 1));
+  }
+  return ~crc;
+}
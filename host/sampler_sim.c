@@ -0,0 +1,180 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "adaptive_sampler.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// SIMULAÇÃO DO AMOSTRADOR ADAPTATIVO
+//
+// Reproduz traços CSV (o formato de main/traces/, uma linha "temperatura,umidade" em décimos por passo
+// de --step ms) como sinal de verdade e deixa o adaptive_sampler do firmware escolher quando ler. Entre
+// uma leitura e a seguinte o consumidor vê o último valor publicado (retenção), que é comparado com o
+// traço em cada passo. Para cada intervalo máximo da varredura imprime leituras feitas, economia em
+// relação a ler sempre no mínimo e erro de reconstrução (máximo e RMS, em décimos) por métrica.
+// --fast e --stable trocam os limiares (taxa em décimos/min, desvio em décimos) de ADAPTIVE_CONFIG_DEFAULT.
+//
+//   ./build-host/sampler_sim [--step ms] [--repeat N] [--max ms,...] [--fast taxa,dp] [--stable taxa,dp]
+//                            main/traces/replay.csv ...
+// -----------------------------------------------------------------------------------------------------------
+
+#define DEFAULT_STEP_MS  2000
+#define MAX_SWEEP        16
+
+typedef struct {
+  int16_t *values[2];
+  size_t count;
+} trace_t;
+
+typedef struct {
+  uint32_t samples;
+  double max_err[2];
+  double rms_err[2];
+  uint32_t transitions;
+} sim_result_t;
+
+static int load_trace(const char *path, uint32_t repeat, trace_t *trace)
+{
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+
+  size_t cap = 256, n = 0;
+  int16_t *t = malloc(cap * sizeof(int16_t)), *u = malloc(cap * sizeof(int16_t));
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    int temperatura, umidade;
+    if (line[0] == '#' || sscanf(line, "%d,%d", &temperatura, &umidade) != 2) continue;
+    if (n == cap) {
+      cap *= 2;
+      t = realloc(t, cap * sizeof(int16_t));
+      u = realloc(u, cap * sizeof(int16_t));
+    }
+    t[n] = temperatura;
+    u[n] = umidade;
+    n++;
+  }
+  fclose(f);
+  if (n == 0) {
+    fprintf(stderr, "%s: nenhuma leitura\n", path);
+    return -1;
+  }
+
+  // O backend replay volta ao início quando o traço acaba; --repeat faz o mesmo
+  trace->count = n * repeat;
+  trace->values[0] = malloc(trace->count * sizeof(int16_t));
+  trace->values[1] = malloc(trace->count * sizeof(int16_t));
+  for (size_t i = 0; i < trace->count; i++) {
+    trace->values[0][i] = t[i % n];
+    trace->values[1][i] = u[i % n];
+  }
+  free(t);
+  free(u);
+  return 0;
+}
+
+static int parse_pair(const char *arg, uint16_t *a, uint16_t *b)
+{
+  unsigned x, y;
+  if (sscanf(arg, "%u,%u", &x, &y) != 2) return -1;
+  *a = x;
+  *b = y;
+  return 0;
+}
+
+static void simulate(const trace_t *trace, uint32_t step_ms, const adaptive_config_t *cfg, sim_result_t *r)
+{
+  adaptive_sampler_t sampler;
+  adaptive_init(&sampler, cfg);
+  memset(r, 0, sizeof(*r));
+
+  double sum2[2] = { 0, 0 };
+  int16_t held[2] = { 0, 0 };
+  uint64_t next_ms = 0;
+  for (size_t i = 0; i < trace->count; i++) {
+    uint64_t now_ms = (uint64_t)i * step_ms;
+    if (now_ms >= next_ms) {
+      held[0] = trace->values[0][i];
+      held[1] = trace->values[1][i];
+      adaptive_update(&sampler, (uint32_t)now_ms, held[0], held[1]);
+      next_ms = now_ms + adaptive_interval_ms(&sampler);
+      r->samples++;
+    }
+    for (int m = 0; m < 2; m++) {
+      double err = fabs((double)trace->values[m][i] - held[m]);
+      if (err > r->max_err[m]) r->max_err[m] = err;
+      sum2[m] += err * err;
+    }
+  }
+  for (int m = 0; m < 2; m++) {
+    r->rms_err[m] = sqrt(sum2[m] / trace->count);
+  }
+  r->transitions = sampler.transitions;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t step_ms = DEFAULT_STEP_MS;
+  uint32_t repeat = 1;
+  uint32_t sweep[MAX_SWEEP] = { DEFAULT_STEP_MS, 10000, 30000, 60000, ADAPTIVE_MAX_INTERVAL_MS };
+  size_t sweep_count = 5;
+  int first_trace = argc;
+  adaptive_config_t base = ADAPTIVE_CONFIG_DEFAULT();
+  int bad = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+      step_ms = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+      repeat = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) {
+      sweep_count = 0;
+      for (char *tok = strtok(argv[++i], ","); tok && sweep_count < MAX_SWEEP; tok = strtok(NULL, ",")) {
+        sweep[sweep_count++] = strtoul(tok, NULL, 10);
+      }
+    } else if (strcmp(argv[i], "--fast") == 0 && i + 1 < argc) {
+      bad |= parse_pair(argv[++i], &base.fast_slope, &base.fast_stddev);
+    } else if (strcmp(argv[i], "--stable") == 0 && i + 1 < argc) {
+      bad |= parse_pair(argv[++i], &base.stable_slope, &base.stable_stddev);
+    } else if (argv[i][0] == '-') {
+      bad = 1;
+      break;
+    } else {
+      first_trace = i;
+      break;
+    }
+  }
+  if (bad || first_trace >= argc || step_ms == 0 || repeat == 0) {
+    fprintf(stderr, "uso: %s [--step ms] [--repeat N] [--max ms,...] [--fast taxa,dp] [--stable taxa,dp] "
+            "traço.csv ...\n", argv[0]);
+    return 2;
+  }
+
+  for (int f = first_trace; f < argc; f++) {
+    trace_t trace;
+    if (load_trace(argv[f], repeat, &trace) != 0) return 1;
+
+    printf("%s: %zu passos de %" PRIu32 " ms (%.1f h); rápido >= %u/min ou dp %u, parado <= %u/min e dp %u\n",
+           argv[f], trace.count, step_ms, trace.count * (double)step_ms / 3600000, base.fast_slope,
+           base.fast_stddev, base.stable_slope, base.stable_stddev);
+    printf("%10s %9s %9s %7s %9s %9s %9s %9s\n", "max_ms", "leituras", "economia", "trocas", "t_max", "t_rms",
+           "u_max", "u_rms");
+    for (size_t s = 0; s < sweep_count; s++) {
+      adaptive_config_t cfg = base;
+      cfg.min_interval_ms = step_ms;
+      cfg.max_interval_ms = sweep[s];
+      sim_result_t r;
+      simulate(&trace, step_ms, &cfg, &r);
+      printf("%10" PRIu32 " %9" PRIu32 " %8.1f%% %7" PRIu32 " %9.0f %9.2f %9.0f %9.2f\n", sweep[s], r.samples,
+             100.0 * (1.0 - (double)r.samples / trace.count), r.transitions, r.max_err[0], r.rms_err[0],
+             r.max_err[1], r.rms_err[1]);
+    }
+    printf("\n");
+    free(trace.values[0]);
+    free(trace.values[1]);
+  }
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include <math.h>
+#include <string.h>
+#include "adaptive_sampler.h"
+
+void adaptive_init(adaptive_sampler_t *s, const adaptive_config_t *cfg)
+{
+  memset(s, 0, sizeof(*s));
+  s->cfg = *cfg;
+  if (s->cfg.min_interval_ms == 0) s->cfg.min_interval_ms = 1;
+  if (s->cfg.max_interval_ms < s->cfg.min_interval_ms) s->cfg.max_interval_ms = s->cfg.min_interval_ms;
+  s->interval_ms = s->cfg.min_interval_ms;
+}
+
+// Taxa da reta de mínimos quadrados sobre a janela inteira e desvio padrão dos resíduos em torno dela.
+// Com só a primeira e a última amostra, um degrau de quantização (1 décimo) em ~14 s já dava ~4/min e a
+// janela nunca parecia parada; a reta dilui o ruído por todas as amostras, e o resíduo separa ruído de
+// tendência (uma rampa limpa tem desvio quase zero e é pega pela taxa)
+static void window_dynamics(const adaptive_sampler_t *s, int metric, float *slope, float *stddev)
+{
+  uint8_t oldest = (s->head + ADAPTIVE_WINDOW - s->count) % ADAPTIVE_WINDOW;
+  uint32_t t0 = s->t_ms[oldest];
+
+  // Tempo em minutos a partir da amostra mais antiga, valor relativo a ela: mantém os floats pequenos
+  float st = 0, sv = 0, stt = 0, stv = 0;
+  for (uint8_t i = 0; i < s->count; i++) {
+    uint8_t k = (oldest + i) % ADAPTIVE_WINDOW;
+    float t = (s->t_ms[k] - t0) / 60000.0f;
+    float v = s->values[metric][k] - s->values[metric][oldest];
+    st += t;
+    sv += v;
+    stt += t * t;
+    stv += t * v;
+  }
+  float n = s->count;
+  float den = n * stt - st * st;
+  float b = den > 0 ? (n * stv - st * sv) / den : 0;
+  float a = (sv - b * st) / n;
+  *slope = fabsf(b);
+
+  float sr2 = 0;
+  for (uint8_t i = 0; i < s->count; i++) {
+    uint8_t k = (oldest + i) % ADAPTIVE_WINDOW;
+    float t = (s->t_ms[k] - t0) / 60000.0f;
+    float r = (s->values[metric][k] - s->values[metric][oldest]) - (a + b * t);
+    sr2 += r * r;
+  }
+  *stddev = sqrtf(sr2 / n);
+}
+
+adaptive_reason_t adaptive_update(adaptive_sampler_t *s, uint32_t now_ms, int16_t temperatura, int16_t umidade)
+{
+  s->t_ms[s->head] = now_ms;
+  s->values[0][s->head] = temperatura;
+  s->values[1][s->head] = umidade;
+  s->head = (s->head + 1) % ADAPTIVE_WINDOW;
+  if (s->count < ADAPTIVE_WINDOW) s->count++;
+  if (s->since_change < UINT8_MAX) s->since_change++;
+
+  if (s->count < 2) return ADAPTIVE_HOLD;
+
+  s->slope = 0;
+  s->stddev = 0;
+  for (int metric = 0; metric < 2; metric++) {
+    float slope, stddev;
+    window_dynamics(s, metric, &slope, &stddev);
+    if (slope > s->slope) s->slope = slope;
+    if (stddev > s->stddev) s->stddev = stddev;
+  }
+
+  uint32_t interval = s->interval_ms;
+  adaptive_reason_t reason = ADAPTIVE_HOLD;
+
+  if (s->slope >= s->cfg.fast_slope || s->stddev >= s->cfg.fast_stddev) {
+    // Sinal mexendo: volta direto ao mínimo
+    interval = s->cfg.min_interval_ms;
+    reason = ADAPTIVE_FAST;
+  } else if (s->slope <= s->cfg.stable_slope && s->stddev <= s->cfg.stable_stddev &&
+             s->since_change >= ADAPTIVE_WINDOW / 2) {
+    // Sinal parado: dobra, mas só depois de algumas amostras no intervalo atual
+    interval = s->interval_ms * 2;
+    if (interval > s->cfg.max_interval_ms) interval = s->cfg.max_interval_ms;
+    reason = ADAPTIVE_STABLE;
+  }
+
+  if (interval == s->interval_ms) return ADAPTIVE_HOLD;
+
+  s->interval_ms = interval;
+  s->since_change = 0;
+  s->transitions++;
+  return reason;
+}
@@ -0,0 +1,74 @@
+#ifndef ADAPTIVE_SAMPLER_H
+#define ADAPTIVE_SAMPLER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------------------------------------
+// AMOSTRAGEM ADAPTATIVA
+//
+// Olha as últimas amostras de cada métrica (taxa de variação e desvio padrão) e ajusta o intervalo
+// de leitura: volta ao mínimo assim que o sinal se mexe, e dobra o intervalo aos poucos enquanto
+// o sinal fica parado, até o máximo configurado.
+//
+// A taxa é a inclinação da reta de mínimos quadrados da janela e o desvio é o dos resíduos em torno dela.
+// Os limiares padrão saem do host/sampler_sim sobre main/traces/replay.csv: com 8 amostras a 2 s o ruído
+// de ±2 décimos do AM2301 já dá alguns décimos/min de taxa, daí o "parado" até 8/min e 2 décimos.
+// -----------------------------------------------------------------------------------------------------------
+
+#define ADAPTIVE_WINDOW              8
+#define ADAPTIVE_MIN_INTERVAL_MS     2000     // padrão; o piso real vem do backend do sensor
+#define ADAPTIVE_MAX_INTERVAL_MS     300000
+#define ADAPTIVE_FAST_SLOPE          20       // décimos por minuto
+#define ADAPTIVE_FAST_STDDEV         3        // décimos
+#define ADAPTIVE_STABLE_SLOPE        8
+#define ADAPTIVE_STABLE_STDDEV       2
+
+typedef enum {
+  ADAPTIVE_HOLD = 0,
+  ADAPTIVE_FAST,
+  ADAPTIVE_STABLE,
+} adaptive_reason_t;
+
+typedef struct {
+  uint32_t min_interval_ms;
+  uint32_t max_interval_ms;
+  uint16_t fast_slope;
+  uint16_t fast_stddev;
+  uint16_t stable_slope;
+  uint16_t stable_stddev;
+} adaptive_config_t;
+
+typedef struct {
+  adaptive_config_t cfg;
+  uint32_t t_ms[ADAPTIVE_WINDOW];
+  int16_t values[2][ADAPTIVE_WINDOW];
+  uint8_t head;
+  uint8_t count;
+  uint8_t since_change;
+  uint32_t interval_ms;
+  uint32_t transitions;
+  float slope;     // maior |taxa| entre as métricas, décimos por minuto
+  float stddev;    // maior desvio padrão entre as métricas, décimos
+} adaptive_sampler_t;
+
+#define ADAPTIVE_CONFIG_DEFAULT() {                 \
+    .min_interval_ms = ADAPTIVE_MIN_INTERVAL_MS,    \
+    .max_interval_ms = ADAPTIVE_MAX_INTERVAL_MS,    \
+    .fast_slope = ADAPTIVE_FAST_SLOPE,              \
+    .fast_stddev = ADAPTIVE_FAST_STDDEV,            \
+    .stable_slope = ADAPTIVE_STABLE_SLOPE,          \
+    .stable_stddev = ADAPTIVE_STABLE_STDDEV,        \
+}
+
+void adaptive_init(adaptive_sampler_t *s, const adaptive_config_t *cfg);
+
+// Registra uma amostra; devolve o motivo quando o intervalo mudou ou ADAPTIVE_HOLD
+adaptive_reason_t adaptive_update(adaptive_sampler_t *s, uint32_t now_ms, int16_t temperatura, int16_t umidade);
+
+static inline uint32_t adaptive_interval_ms(const adaptive_sampler_t *s)
+{
+  return s->interval_ms;
+}
+
+#endif // ADAPTIVE_SAMPLER_H
@@ -0,0 +1,40 @@
+#include <math.h>
+#include <stdio.h>
+#include "aggregate.h"
+
+void welford_reset(welford_t *w)
+{
+  w->count = 0;
+  w->min = INT16_MAX;
+  w->max = INT16_MIN;
+  w->mean = 0;
+  w->m2 = 0;
+}
+
+void welford_add(welford_t *w, int16_t value)
+{
+  w->count++;
+  if (value < w->min) w->min = value;
+  if (value > w->max) w->max = value;
+
+  float delta = value - w->mean;
+  w->mean += delta / w->count;
+  w->m2 += delta * (value - w->mean);
+}
+
+float welford_stddev(const welford_t *w)
+{
+  if (w->count < 2) return 0;
+  return sqrtf(w->m2 / (w->count - 1));
+}
+
+int aggregate_format(const welford_t *w, uint32_t failures, char *buf, size_t len)
+{
+  if (w->count == 0) {
+    return snprintf(buf, len, "{\"n\":0,\"f\":%lu}", (unsigned long)failures);
+  }
+
+  return snprintf(buf, len, "{\"n\":%lu,\"f\":%lu,\"min\":%.1f,\"max\":%.1f,\"mean\":%.2f,\"sd\":%.2f}",
+                  (unsigned long)w->count, (unsigned long)failures,
+                  w->min / 10.0f, w->max / 10.0f, w->mean / 10.0f, welford_stddev(w) / 10.0f);
+}
@@ -0,0 +1,29 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------------------------------------
+// ESTATÍSTICAS POR JANELA
+//
+// Acumulador de Welford sobre os valores em décimos devolvidos por dht_read_data(): média e variância
+// são atualizadas a cada amostra, sem guardar a janela em memória.
+// -----------------------------------------------------------------------------------------------------------
+
+typedef struct {
+  uint32_t count;
+  int16_t min;
+  int16_t max;
+  float mean;
+  float m2;
+} welford_t;
+
+void welford_reset(welford_t *w);
+void welford_add(welford_t *w, int16_t value);
+float welford_stddev(const welford_t *w);
+
+// Registro agregado compacto: {"n":..,"f":..,"min":..,"max":..,"mean":..,"sd":..}
+int aggregate_format(const welford_t *w, uint32_t failures, char *buf, size_t len);
+
+#endif // AGGREGATE_H
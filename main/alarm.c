@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include "alarm.h"
+
+static const char *const kind_names[ALARM_KINDS] = { "alta", "baixa", "taxa" };
+
+const char *alarm_kind_name(alarm_kind_t kind)
+{
+  return kind < ALARM_KINDS ? kind_names[kind] : "?";
+}
+
+void alarm_init(alarm_t *alarm, const alarm_config_t *cfg)
+{
+  alarm->cfg = *cfg;
+  alarm->active = 0;
+  alarm->has_last = false;
+  alarm->last_value = 0;
+  alarm->last_ms = 0;
+}
+
+void alarm_configure(alarm_t *alarm, const alarm_config_t *cfg)
+{
+  alarm->cfg = *cfg;
+}
+
+// Aplica a histerese: dispara em trigger, só volta ao normal em clear
+static int update(alarm_t *alarm, alarm_kind_t kind, bool enabled, bool trigger, bool clear,
+                  int16_t value, int32_t measured, int32_t limit, alarm_event_t *events, int n)
+{
+  uint8_t bit = 1u << kind;
+  bool active = (alarm->active & bit) != 0;
+
+  if (!active && enabled && trigger) {
+    alarm->active |= bit;
+  } else if (active && (!enabled || clear)) {
+    alarm->active &= ~bit;
+  } else {
+    return n;
+  }
+
+  events[n] = (alarm_event_t){
+    .kind = kind,
+    .active = !active,
+    .value = value,
+    .measured = measured,
+    .limit = limit,
+  };
+  return n + 1;
+}
+
+int alarm_eval(alarm_t *alarm, int64_t now_ms, int16_t value, alarm_event_t *events)
+{
+  const alarm_config_t *cfg = &alarm->cfg;
+  int32_t hyst = cfg->hysteresis;
+  int n = 0;
+
+  n = update(alarm, ALARM_HIGH, cfg->high != ALARM_DISABLED_HIGH,
+             value >= cfg->high, value <= (int32_t)cfg->high - hyst,
+             value, value, cfg->high, events, n);
+
+  n = update(alarm, ALARM_LOW, cfg->low != ALARM_DISABLED_LOW,
+             value <= cfg->low, value >= (int32_t)cfg->low + hyst,
+             value, value, cfg->low, events, n);
+
+  // Taxa entre amostras consecutivas; sem amostra anterior recente o estado fica como está
+  int64_t dt_ms = now_ms - alarm->last_ms;
+  if (alarm->has_last && dt_ms > 0 && dt_ms <= ALARM_RATE_MAX_GAP_MS) {
+    int32_t rate = (int32_t)((int64_t)(value - alarm->last_value) * 60000 / dt_ms);
+    int32_t limit = cfg->rate_per_min;
+    int32_t clear = limit > hyst ? limit - hyst : 1;
+    n = update(alarm, ALARM_RATE, limit > 0,
+               abs(rate) >= limit, abs(rate) < clear,
+               value, rate, limit, events, n);
+  }
+
+  alarm->has_last = true;
+  alarm->last_value = value;
+  alarm->last_ms = now_ms;
+  return n;
+}
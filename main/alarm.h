@@ -0,0 +1,59 @@
+#ifndef ALARM_H
+#define ALARM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------------------------------------
+// ALARMES DE LIMITE
+//
+// Avaliados no caminho de aquisição, antes de qualquer agregação ou filtro de publicação. Cada métrica
+// tem limite alto, limite baixo e taxa de variação máxima; um alarme ativo só volta ao normal depois de
+// recuar a histerese, para não oscilar em torno do limite. Só as mudanças de estado viram eventos.
+// Valores em décimos, como saem do driver.
+// -----------------------------------------------------------------------------------------------------------
+
+#define ALARM_DISABLED_HIGH   INT16_MAX
+#define ALARM_DISABLED_LOW    INT16_MIN
+#define ALARM_RATE_MAX_GAP_MS (60 * 60 * 1000)   // amostras mais espaçadas que isso não medem taxa
+
+typedef enum {
+  ALARM_HIGH = 0,
+  ALARM_LOW,
+  ALARM_RATE,
+  ALARM_KINDS,
+} alarm_kind_t;
+
+typedef struct {
+  int16_t high;             // ALARM_DISABLED_HIGH desliga
+  int16_t low;              // ALARM_DISABLED_LOW desliga
+  uint16_t rate_per_min;    // décimos por minuto; 0 desliga
+  uint16_t hysteresis;
+} alarm_config_t;
+
+typedef struct {
+  alarm_config_t cfg;
+  uint8_t active;           // bit por alarm_kind_t
+  bool has_last;
+  int16_t last_value;
+  int64_t last_ms;
+} alarm_t;
+
+typedef struct {
+  alarm_kind_t kind;
+  bool active;              // true: disparou; false: voltou ao normal
+  int16_t value;
+  int32_t measured;         // valor ou taxa (décimos/min) que causou a mudança
+  int32_t limit;
+} alarm_event_t;
+
+void alarm_init(alarm_t *alarm, const alarm_config_t *cfg);
+// Mantém o estado atual; só muda os limites
+void alarm_configure(alarm_t *alarm, const alarm_config_t *cfg);
+
+// Devolve quantos eventos foram escritos em events (no máximo ALARM_KINDS)
+int alarm_eval(alarm_t *alarm, int64_t now_ms, int16_t value, alarm_event_t *events);
+
+const char *alarm_kind_name(alarm_kind_t kind);
+
+#endif // ALARM_H
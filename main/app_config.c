@@ -0,0 +1,355 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "adaptive_sampler.h"
+#include "app_config.h"
+#include "low_power.h"
+#include "msg_pool.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// AUXILIARES
+// -----------------------------------------------------------------------------------------------------------
+
+bool app_form_value(const char *body, const char *key, char *value, size_t len)
+{
+  size_t key_len = strlen(key);
+  const char *p = body;
+
+  while (*p) {
+    const char *end = strchr(p, '&');
+    if (end == NULL) end = p + strlen(p);
+
+    if ((size_t)(end - p) > key_len && strncmp(p, key, key_len) == 0 && p[key_len] == '=') {
+      const char *v = p + key_len + 1;
+      size_t n = end - v;
+      if (n >= len) n = len - 1;
+      memcpy(value, v, n);
+      value[n] = '\0';
+      return true;
+    }
+    p = (*end == '&') ? end + 1 : end;
+  }
+  return false;
+}
+
+// Limites de alarme em décimos; desligado vira null
+static void alarm_limit_format(char *buf, size_t len, int32_t value, bool disabled)
+{
+  if (disabled) {
+    snprintf(buf, len, "null");
+  } else {
+    snprintf(buf, len, "%" PRIi32, value);
+  }
+}
+
+// "off" desliga o limite; devolve false se o valor não for um número em décimos dentro da faixa
+static bool alarm_limit_parse(const char *value, int32_t min, int32_t max, int32_t disabled, int32_t *out)
+{
+  if (strcmp(value, "off") == 0) {
+    *out = disabled;
+    return true;
+  }
+  char *end;
+  long parsed = strtol(value, &end, 10);
+  if (*end != '\0' || end == value || parsed < min || parsed > max) return false;
+  *out = parsed;
+  return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// API
+// -----------------------------------------------------------------------------------------------------------
+
+void app_config_defaults(app_config_t *cfg)
+{
+  *cfg = (app_config_t) {
+    .publish_mode = PUBLISH_MODE_RAW,
+    .agg_window_s = AGG_WINDOW_DEFAULT_S,
+    .interval_min_ms = ADAPTIVE_MIN_INTERVAL_MS,
+    .interval_max_ms = ADAPTIVE_MAX_INTERVAL_MS,
+    .mqtt_version = 3,
+    .delivery = DELIVERY_QOS1,
+    .low_power = false,
+    .sleep_s = LOW_POWER_SLEEP_DEFAULT_S,
+    .pool_slots = MSG_POOL_SLOTS_DEFAULT,
+    .stamps = false,
+    .filter = SAMPLE_FILTER_CONFIG_DEFAULT(),
+    .alarm = {
+      [METRIC_UMIDADE] = { ALARM_DISABLED_HIGH, ALARM_DISABLED_LOW, 0, ALARM_HYSTERESIS },
+      [METRIC_TEMPERATURA] = { ALARM_DISABLED_HIGH, ALARM_DISABLED_LOW, 0, ALARM_HYSTERESIS },
+    },
+  };
+}
+
+esp_err_t app_config_parse_form(app_config_t *cfg, const char *body, uint32_t min_interval_ms, const char **error)
+{
+  app_config_t next = *cfg;
+  char value[16];
+
+  if (app_form_value(body, "mode", value, sizeof(value))) {
+    if (strcmp(value, "agg") == 0) {
+      next.publish_mode = PUBLISH_MODE_AGG;
+    } else if (strcmp(value, "raw") == 0) {
+      next.publish_mode = PUBLISH_MODE_RAW;
+    } else {
+      *error = "mode deve ser raw ou agg";
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  if (app_form_value(body, "window", value, sizeof(value))) {
+    unsigned long window = strtoul(value, NULL, 10);
+    if (window == 0 || window > UINT16_MAX) {
+      *error = "window inválida";
+      return ESP_ERR_INVALID_ARG;
+    }
+    next.agg_window_s = window;
+  }
+
+  if (app_form_value(body, "interval_min", value, sizeof(value))) {
+    next.interval_min_ms = strtoul(value, NULL, 10);
+  }
+  if (app_form_value(body, "interval_max", value, sizeof(value))) {
+    next.interval_max_ms = strtoul(value, NULL, 10);
+  }
+  if (next.interval_min_ms < min_interval_ms || next.interval_max_ms < next.interval_min_ms) {
+    *error = "intervalo inválido";
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (app_form_value(body, "mqtt", value, sizeof(value))) {
+    if (strcmp(value, "5") == 0) {
+      next.mqtt_version = 5;
+    } else if (strcmp(value, "3") == 0) {
+      next.mqtt_version = 3;
+    } else {
+      *error = "mqtt deve ser 3 ou 5";
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  if (app_form_value(body, "delivery", value, sizeof(value))) {
+    if (strcmp(value, "seq") == 0) {
+      next.delivery = DELIVERY_SEQ;
+    } else if (strcmp(value, "qos1") == 0) {
+      next.delivery = DELIVERY_QOS1;
+    } else {
+      *error = "delivery deve ser qos1 ou seq";
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  if (app_form_value(body, "low_power", value, sizeof(value))) {
+    if (strcmp(value, "1") == 0) {
+      next.low_power = true;
+    } else if (strcmp(value, "0") == 0) {
+      next.low_power = false;
+    } else {
+      *error = "low_power deve ser 0 ou 1";
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  if (app_form_value(body, "sleep", value, sizeof(value))) {
+    unsigned long sleep_s = strtoul(value, NULL, 10);
+    if (sleep_s == 0 || sleep_s > UINT16_MAX) {
+      *error = "sleep inválido";
+      return ESP_ERR_INVALID_ARG;
+    }
+    next.sleep_s = sleep_s;
+  }
+
+  if (app_form_value(body, "pool_slots", value, sizeof(value))) {
+    unsigned long slots = strtoul(value, NULL, 10);
+    if (slots == 0 || slots > MSG_POOL_SLOTS_MAX) {
+      *error = "pool_slots inválido";
+      return ESP_ERR_INVALID_ARG;
+    }
+    next.pool_slots = slots;
+  }
+
+  if (app_form_value(body, "stamps", value, sizeof(value))) {
+    if (strcmp(value, "1") == 0) {
+      next.stamps = true;
+    } else if (strcmp(value, "0") == 0) {
+      next.stamps = false;
+    } else {
+      *error = "stamps deve ser 0 ou 1";
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  const struct {
+    const char *key;
+    uint8_t min;
+    uint8_t max;
+    uint8_t *field;
+  } filter_keys[] = {
+    { "filter_n", 1, SAMPLE_FILTER_MAX_WINDOW, &next.filter.window },
+    { "filter_median", 0, 1, &next.filter.median },
+    { "filter_k", 0, SAMPLE_FILTER_MAX_K, &next.filter.hampel_k },
+    { "filter_ema", 0, SAMPLE_FILTER_MAX_EMA, &next.filter.ema_shift },
+  };
+  for (size_t i = 0; i < sizeof(filter_keys) / sizeof(filter_keys[0]); i++) {
+    if (!app_form_value(body, filter_keys[i].key, value, sizeof(value))) continue;
+
+    char *end;
+    unsigned long n = strtoul(value, &end, 10);
+    if (*end != '\0' || end == value || n < filter_keys[i].min || n > filter_keys[i].max) {
+      *error = "parâmetro de filtro inválido";
+      return ESP_ERR_INVALID_ARG;
+    }
+    *filter_keys[i].field = n;
+  }
+
+  static const struct {
+    const char *key;
+    uint8_t metric;
+    alarm_kind_t kind;
+  } alarm_keys[] = {
+    { "t_max", METRIC_TEMPERATURA, ALARM_HIGH }, { "t_min", METRIC_TEMPERATURA, ALARM_LOW },
+    { "t_rate", METRIC_TEMPERATURA, ALARM_RATE }, { "u_max", METRIC_UMIDADE, ALARM_HIGH },
+    { "u_min", METRIC_UMIDADE, ALARM_LOW }, { "u_rate", METRIC_UMIDADE, ALARM_RATE },
+  };
+  for (size_t i = 0; i < sizeof(alarm_keys) / sizeof(alarm_keys[0]); i++) {
+    if (!app_form_value(body, alarm_keys[i].key, value, sizeof(value))) continue;
+
+    alarm_config_t *alarm = &next.alarm[alarm_keys[i].metric];
+    int32_t limit;
+    bool ok;
+    if (alarm_keys[i].kind == ALARM_HIGH) {
+      ok = alarm_limit_parse(value, INT16_MIN + 1, INT16_MAX - 1, ALARM_DISABLED_HIGH, &limit);
+      alarm->high = limit;
+    } else if (alarm_keys[i].kind == ALARM_LOW) {
+      ok = alarm_limit_parse(value, INT16_MIN + 1, INT16_MAX - 1, ALARM_DISABLED_LOW, &limit);
+      alarm->low = limit;
+    } else {
+      ok = alarm_limit_parse(value, 1, UINT16_MAX, 0, &limit);
+      alarm->rate_per_min = limit;
+    }
+    if (!ok) {
+      *error = "limite de alarme inválido";
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  *cfg = next;
+  return ESP_OK;
+}
+
+int app_config_format_json(const app_config_t *cfg, char *buf, size_t len)
+{
+  char limits[6][8];
+  const alarm_config_t *t = &cfg->alarm[METRIC_TEMPERATURA];
+  const alarm_config_t *u = &cfg->alarm[METRIC_UMIDADE];
+  alarm_limit_format(limits[0], sizeof(limits[0]), t->high, t->high == ALARM_DISABLED_HIGH);
+  alarm_limit_format(limits[1], sizeof(limits[1]), t->low, t->low == ALARM_DISABLED_LOW);
+  alarm_limit_format(limits[2], sizeof(limits[2]), t->rate_per_min, t->rate_per_min == 0);
+  alarm_limit_format(limits[3], sizeof(limits[3]), u->high, u->high == ALARM_DISABLED_HIGH);
+  alarm_limit_format(limits[4], sizeof(limits[4]), u->low, u->low == ALARM_DISABLED_LOW);
+  alarm_limit_format(limits[5], sizeof(limits[5]), u->rate_per_min, u->rate_per_min == 0);
+
+  return snprintf(buf, len, "{\"mode\":\"%s\",\"window\":%u,\"interval_min\":%" PRIu32 ",\"interval_max\":%" PRIu32
+                  ",\"mqtt\":%d,\"delivery\":\"%s\",\"low_power\":%d,\"sleep\":%u,\"pool_slots\":%u,\"stamps\":%d,"
+                  "\"filter_n\":%u,\"filter_median\":%u,\"filter_k\":%u,\"filter_ema\":%u,"
+                  "\"t_max\":%s,\"t_min\":%s,\"t_rate\":%s,\"u_max\":%s,\"u_min\":%s,\"u_rate\":%s}",
+                  cfg->publish_mode == PUBLISH_MODE_AGG ? "agg" : "raw", cfg->agg_window_s,
+                  cfg->interval_min_ms, cfg->interval_max_ms, cfg->mqtt_version,
+                  cfg->delivery == DELIVERY_SEQ ? "seq" : "qos1", cfg->low_power ? 1 : 0, cfg->sleep_s,
+                  cfg->pool_slots, cfg->stamps ? 1 : 0, cfg->filter.window, cfg->filter.median, cfg->filter.hampel_k,
+                  cfg->filter.ema_shift, limits[0], limits[1], limits[2], limits[3], limits[4], limits[5]);
+}
+
+void app_config_load(app_config_t *cfg, nvs_handle_t handle, uint32_t min_interval_ms)
+{
+  uint8_t mode;
+  if (nvs_get_u8(handle, "pub_mode", &mode) == ESP_OK && mode <= PUBLISH_MODE_AGG) {
+    cfg->publish_mode = mode;
+  }
+
+  uint16_t window;
+  if (nvs_get_u16(handle, "agg_window", &window) == ESP_OK && window > 0) {
+    cfg->agg_window_s = window;
+  }
+
+  uint32_t interval_min, interval_max;
+  if (nvs_get_u32(handle, "int_min", &interval_min) == ESP_OK &&
+      nvs_get_u32(handle, "int_max", &interval_max) == ESP_OK &&
+      interval_min >= min_interval_ms && interval_max >= interval_min) {
+    cfg->interval_min_ms = interval_min;
+    cfg->interval_max_ms = interval_max;
+  }
+
+  uint8_t protocol;
+  if (nvs_get_u8(handle, "mqtt_proto", &protocol) == ESP_OK) {
+    cfg->mqtt_version = (protocol == 5) ? 5 : 3;
+  }
+
+  uint8_t delivery;
+  if (nvs_get_u8(handle, "delivery", &delivery) == ESP_OK && delivery <= DELIVERY_SEQ) {
+    cfg->delivery = delivery;
+  }
+
+  alarm_config_t *t = &cfg->alarm[METRIC_TEMPERATURA];
+  alarm_config_t *u = &cfg->alarm[METRIC_UMIDADE];
+  nvs_get_i16(handle, "al_t_max", &t->high);
+  nvs_get_i16(handle, "al_t_min", &t->low);
+  nvs_get_u16(handle, "al_t_rate", &t->rate_per_min);
+  nvs_get_i16(handle, "al_u_max", &u->high);
+  nvs_get_i16(handle, "al_u_min", &u->low);
+  nvs_get_u16(handle, "al_u_rate", &u->rate_per_min);
+
+  uint8_t low_power;
+  if (nvs_get_u8(handle, "low_power", &low_power) == ESP_OK) {
+    cfg->low_power = low_power != 0;
+  }
+
+  uint16_t sleep_s;
+  if (nvs_get_u16(handle, "sleep_s", &sleep_s) == ESP_OK && sleep_s > 0) {
+    cfg->sleep_s = sleep_s;
+  }
+
+  uint16_t pool_slots;
+  if (nvs_get_u16(handle, "pool_slots", &pool_slots) == ESP_OK && pool_slots > 0 && pool_slots <= MSG_POOL_SLOTS_MAX) {
+    cfg->pool_slots = pool_slots;
+  }
+
+  uint8_t stamps;
+  if (nvs_get_u8(handle, "stamps", &stamps) == ESP_OK) {
+    cfg->stamps = stamps != 0;
+  }
+
+  sample_filter_config_t filter;
+  if (nvs_get_u8(handle, "flt_n", &filter.window) == ESP_OK && nvs_get_u8(handle, "flt_med", &filter.median) == ESP_OK &&
+      nvs_get_u8(handle, "flt_k", &filter.hampel_k) == ESP_OK && nvs_get_u8(handle, "flt_ema", &filter.ema_shift) == ESP_OK &&
+      filter.window >= 1 && filter.window <= SAMPLE_FILTER_MAX_WINDOW && filter.median <= 1 &&
+      filter.hampel_k <= SAMPLE_FILTER_MAX_K && filter.ema_shift <= SAMPLE_FILTER_MAX_EMA) {
+    cfg->filter = filter;
+  }
+}
+
+esp_err_t app_config_save(const app_config_t *cfg, nvs_handle_t handle)
+{
+  nvs_set_u8(handle, "pub_mode", cfg->publish_mode);
+  nvs_set_u16(handle, "agg_window", cfg->agg_window_s);
+  nvs_set_u32(handle, "int_min", cfg->interval_min_ms);
+  nvs_set_u32(handle, "int_max", cfg->interval_max_ms);
+  nvs_set_u8(handle, "mqtt_proto", cfg->mqtt_version);
+  nvs_set_u8(handle, "delivery", cfg->delivery);
+  nvs_set_u8(handle, "low_power", cfg->low_power ? 1 : 0);
+  nvs_set_u16(handle, "sleep_s", cfg->sleep_s);
+  nvs_set_u16(handle, "pool_slots", cfg->pool_slots);
+  nvs_set_u8(handle, "stamps", cfg->stamps ? 1 : 0);
+  nvs_set_u8(handle, "flt_n", cfg->filter.window);
+  nvs_set_u8(handle, "flt_med", cfg->filter.median);
+  nvs_set_u8(handle, "flt_k", cfg->filter.hampel_k);
+  nvs_set_u8(handle, "flt_ema", cfg->filter.ema_shift);
+  nvs_set_i16(handle, "al_t_max", cfg->alarm[METRIC_TEMPERATURA].high);
+  nvs_set_i16(handle, "al_t_min", cfg->alarm[METRIC_TEMPERATURA].low);
+  nvs_set_u16(handle, "al_t_rate", cfg->alarm[METRIC_TEMPERATURA].rate_per_min);
+  nvs_set_i16(handle, "al_u_max", cfg->alarm[METRIC_UMIDADE].high);
+  nvs_set_i16(handle, "al_u_min", cfg->alarm[METRIC_UMIDADE].low);
+  nvs_set_u16(handle, "al_u_rate", cfg->alarm[METRIC_UMIDADE].rate_per_min);
+  return nvs_commit(handle);
+}
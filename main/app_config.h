@@ -0,0 +1,66 @@
+#ifndef APP_CONFIG_H
+#define APP_CONFIG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "alarm.h"
+#include "esp_err.h"
+#include "nvs.h"
+#include "sample_filter.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// CONFIGURAÇÃO DA APLICAÇÃO
+//
+// Tudo o que /api/config lê e grava: modo de publicação, intervalos, protocolo, baixo consumo, filtro de
+// leituras e limites de alarme. Não depende de driver nem do servidor HTTP (só da API de NVS, que tem mock no build de
+// host), para que o parsing do POST e a serialização possam ser medidos fora do dispositivo.
+// -----------------------------------------------------------------------------------------------------------
+
+#define PUBLISH_MODE_RAW      0   // publica cada leitura que mudou
+#define PUBLISH_MODE_AGG      1   // publica min/max/média/desvio por janela
+#define AGG_WINDOW_DEFAULT_S  60
+
+#define DELIVERY_QOS1         0   // cada amostra em QoS 1
+#define DELIVERY_SEQ          1   // QoS 0 com época/sequência e reenvio por NACK
+
+#define METRIC_UMIDADE        0
+#define METRIC_TEMPERATURA    1
+#define APP_METRICS           2
+
+#define ALARM_HYSTERESIS      5   // décimos: 0,5 °C / 0,5 %
+
+#define APP_CONFIG_NVS_NAMESPACE "storage"
+
+typedef struct {
+  uint8_t publish_mode;
+  uint16_t agg_window_s;
+  uint32_t interval_min_ms;
+  uint32_t interval_max_ms;
+  uint8_t mqtt_version;         // 3 (3.1.1) ou 5
+  uint8_t delivery;
+  bool low_power;
+  uint16_t sleep_s;
+  uint16_t pool_slots;
+  bool stamps;                  // carimbos de tempo do dispositivo em cada registro (app_append_stamps)
+  sample_filter_config_t filter;
+  alarm_config_t alarm[APP_METRICS];
+} app_config_t;
+
+void app_config_defaults(app_config_t *cfg);
+
+// Aplica um corpo form-urlencoded sobre cfg. Tudo ou nada: em caso de erro cfg não muda e *error
+// recebe a mensagem para o cliente. min_interval_ms é o piso do backend de sensor.
+esp_err_t app_config_parse_form(app_config_t *cfg, const char *body, uint32_t min_interval_ms, const char **error);
+
+// JSON de GET /api/config; devolve o tamanho como snprintf
+int app_config_format_json(const app_config_t *cfg, char *buf, size_t len);
+
+// Valores ausentes ou inválidos no NVS mantêm o que já está em cfg
+void app_config_load(app_config_t *cfg, nvs_handle_t handle, uint32_t min_interval_ms);
+esp_err_t app_config_save(const app_config_t *cfg, nvs_handle_t handle);
+
+// Mesmo contrato de httpd_query_key_value(): busca key=valor no corpo, sem decodificar %XX
+bool app_form_value(const char *body, const char *key, char *value, size_t len);
+
+#endif // APP_CONFIG_H
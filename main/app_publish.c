@@ -0,0 +1,97 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include "app_publish.h"
+
+void app_change_filter_reset(app_change_filter_t *filter)
+{
+  for (int i = 0; i < APP_METRICS; i++) {
+    filter->last[i] = INT16_MIN;
+  }
+}
+
+bool app_change_filter_update(app_change_filter_t *filter, uint8_t metric, int16_t value)
+{
+  if (metric >= APP_METRICS || filter->last[metric] == value) return false;
+  filter->last[metric] = value;
+  return true;
+}
+
+size_t app_format_tenths(int16_t value, char *buf)
+{
+  char digits[6];
+  size_t n = 0, len = 0;
+  uint32_t magnitude = value < 0 ? -(int32_t)value : value;
+
+  if (value < 0) buf[len++] = '-';
+  do {
+    digits[n++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0);
+  if (n == 1) digits[n++] = '0';   // 0,5 -> "0.5"
+
+  while (n > 1) buf[len++] = digits[--n];
+  buf[len++] = '.';
+  buf[len++] = digits[0];
+  buf[len] = '\0';
+  return len;
+}
+
+int app_format_topic(char *buf, size_t len, const char *mac, const char *suffix)
+{
+  return snprintf(buf, len, "%s/%s", mac, suffix);
+}
+
+int app_append_stamps(char *buf, size_t len, int used, const app_stamps_t *stamps)
+{
+  if (used <= 0 || (size_t)used >= len) return used;
+
+  bool json = buf[used - 1] == '}';
+  int at = json ? used - 1 : used;
+  const char *format = json ? ",\"a\":%" PRId64 ",\"e\":%" PRId64 ",\"s\":%" PRId32 "}"
+                            : ";a=%" PRId64 ";e=%" PRId64 ";s=%" PRId32;
+  int n = snprintf(buf + at, len - at, format, stamps->acquired_ms, stamps->enqueued_ms, stamps->sync_age_s);
+  if (n < 0 || (size_t)(at + n) >= len) {
+    // Não coube: desfaz o que o snprintf truncado escreveu
+    if (json) buf[at] = '}';
+    buf[used] = '\0';
+    return used;
+  }
+  return at + n;
+}
+
+uint32_t app_phase_seed(const char *mac)
+{
+  uint32_t hash = 2166136261u;
+  for (const char *c = mac; *c; c++) {
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+  }
+  return hash;
+}
+
+uint32_t app_phase_delay_ms(uint32_t seed, int64_t now_ms, uint32_t period_ms)
+{
+  if (period_ms == 0) return 0;
+
+  int64_t offset = (now_ms - (int64_t)(seed % period_ms)) % period_ms;
+  if (offset < 0) offset += period_ms;
+  uint32_t delay = period_ms - (uint32_t)offset;
+  if (delay < period_ms / 2) delay += period_ms;
+  return delay;
+}
+
+int app_snapshot_format(const app_snapshot_t *snapshot, char *buf, size_t len)
+{
+  char t[APP_TENTHS_MAX_LEN] = "null";
+  char u[APP_TENTHS_MAX_LEN] = "null";
+  char ts[24] = "null";
+
+  if (snapshot->acquired_ms != 0) {
+    app_format_tenths(snapshot->value[METRIC_TEMPERATURA], t);
+    app_format_tenths(snapshot->value[METRIC_UMIDADE], u);
+    snprintf(ts, sizeof(ts), "%" PRId64, snapshot->acquired_ms);
+  }
+  return snprintf(buf, len, "{\"t\":%s,\"u\":%s,\"ts\":%s,\"al\":{\"t\":%u,\"u\":%u},\"sensor\":\"%s\",\"recente\":%" PRIu32
+                  ",\"ms\":%" PRIu32 ",\"up\":%" PRIu32 "}",
+                  t, u, ts, snapshot->alarm[METRIC_TEMPERATURA], snapshot->alarm[METRIC_UMIDADE], snapshot->health,
+                  snapshot->recent_permille, snapshot->interval_ms, snapshot->uptime_s);
+}
@@ -0,0 +1,76 @@
+#ifndef APP_PUBLISH_H
+#define APP_PUBLISH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "app_config.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// DECISÃO E FORMATAÇÃO DAS PUBLICAÇÕES
+//
+// Partes do caminho de publicação que rodam a cada leitura e não tocam em driver: o filtro de mudança
+// do modo raw, a formatação dos valores em décimos e a montagem dos tópicos <mac>/<sufixo>. Ficam
+// fora do main.c para serem medidas no build de host (ver host/).
+// -----------------------------------------------------------------------------------------------------------
+
+#define APP_TENTHS_MAX_LEN  8   // "-3276.8" + '\0'
+
+typedef struct {
+  int16_t last[APP_METRICS];
+} app_change_filter_t;
+
+void app_change_filter_reset(app_change_filter_t *filter);
+
+// true se o valor difere do último aceito para a métrica (e passa a ser o último)
+bool app_change_filter_update(app_change_filter_t *filter, uint8_t metric, int16_t value);
+
+// Décimos como "%.1f" de value / 10.0, sem ponto flutuante nem printf. Devolve o tamanho escrito.
+size_t app_format_tenths(int16_t value, char *buf);
+
+// "<mac>/<sufixo>"; devolve o tamanho como snprintf
+int app_format_topic(char *buf, size_t len, const char *mac, const char *suffix);
+
+// Carimbos de tempo opcionais de cada registro (stamps=1 em /api/config), em ms do relógio de parede
+typedef struct {
+  int64_t acquired_ms;    // sensor_read() devolveu a leitura
+  int64_t enqueued_ms;    // registro entregue ao publisher
+  int32_t sync_age_s;     // desde a última sincronização SNTP; -1 = nunca sincronizou
+} app_stamps_t;
+
+#define APP_STAMPS_MAX_LEN  56
+
+// Acrescenta os carimbos ao registro já formatado em buf[0..used): num objeto JSON viram os campos
+// "a", "e" e "s"; nos formatos de texto, o sufixo ";a=<ms>;e=<ms>;s=<s>". Devolve o tamanho novo, ou
+// used (registro intacto) se não couber.
+int app_append_stamps(char *buf, size_t len, int used, const app_stamps_t *stamps);
+
+// Fase própria de cada dispositivo no ciclo de amostragem: semente tirada do MAC (FNV-1a), estável entre
+// boots. Depois de uma queda de energia a frota inteira religa junta; com a fase, cada unidade lê e
+// publica num ponto diferente do intervalo em vez de todas no mesmo instante.
+uint32_t app_phase_seed(const char *mac);
+
+// Espera até o próximo instante t > now_ms com t % period_ms == seed % period_ms. Se o próximo estiver a
+// menos de meio período (o intervalo acabou de mudar), pula para o seguinte: entre duas execuções
+// nunca passa menos de period_ms / 2 nem mais de 1,5 * period_ms.
+uint32_t app_phase_delay_ms(uint32_t seed, int64_t now_ms, uint32_t period_ms);
+
+// Retrato do dispositivo no tópico retido <mac>/estado: quem assina recebe na hora a última leitura,
+// os alarmes ativos e a saúde do sensor, sem esperar o próximo ciclo nem reler o histórico
+typedef struct {
+  int16_t value[APP_METRICS];   // décimos, saída do filtro
+  int64_t acquired_ms;          // relógio de parede da leitura; 0 = nenhuma leitura ainda
+  uint8_t alarm[APP_METRICS];   // bits de alarm_kind_t ativos
+  const char *health;           // sensor_health_state_name()
+  uint32_t recent_permille;     // sucessos nas últimas leituras
+  uint32_t interval_ms;         // intervalo de amostragem atual
+  uint32_t uptime_s;
+} app_snapshot_t;
+
+#define APP_SNAPSHOT_MAX_LEN  192
+
+// {"t":23.4,"u":55.0,"ts":<ms>,"al":{"t":0,"u":0},"sensor":"ok","recente":1000,"ms":<ms>,"up":<s>};
+// sem leitura, t, u e ts saem null. Devolve o tamanho como snprintf.
+int app_snapshot_format(const app_snapshot_t *snapshot, char *buf, size_t len);
+
+#endif // APP_PUBLISH_H
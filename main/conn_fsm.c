@@ -0,0 +1,230 @@
+#include <string.h>
+#include "conn_fsm.h"
+
+static const char *const state_names[CONN_STATE_MAX] = {
+  [CONN_IDLE]            = "idle",
+  [CONN_STA_CONNECTING]  = "sta_conectando",
+  [CONN_STA_BACKOFF]     = "sta_backoff",
+  [CONN_MQTT_CONNECTING] = "mqtt_conectando",
+  [CONN_MQTT_BACKOFF]    = "mqtt_backoff",
+  [CONN_ONLINE]          = "online",
+  [CONN_AP_FALLBACK]     = "ap_fallback",
+};
+
+const char *conn_state_name(conn_state_t state)
+{
+  return state < CONN_STATE_MAX ? state_names[state] : "?";
+}
+
+uint32_t conn_backoff_ms(uint32_t attempt, uint32_t random)
+{
+  uint32_t delay = CONN_BACKOFF_MAX_MS;
+  if (attempt < 16) {
+    delay = CONN_BACKOFF_BASE_MS << attempt;
+    if (delay > CONN_BACKOFF_MAX_MS) delay = CONN_BACKOFF_MAX_MS;
+  }
+  return delay / 2 + random % (delay / 2 + 1);
+}
+
+// Parte sorteada que desencontra a frota; fica fora do backoff, que continua valendo por tentativa
+static uint32_t spread_delay_ms(conn_fsm_t *fsm)
+{
+  return fsm->spread_ms ? fsm->ops->random() % (fsm->spread_ms + 1) : 0;
+}
+
+static void enter(conn_fsm_t *fsm, conn_state_t to)
+{
+  conn_state_t from = fsm->state;
+
+  fsm->state = to;
+  fsm->transitions++;
+  fsm->entered[to]++;
+  if (fsm->ops->on_transition) {
+    fsm->ops->on_transition(fsm, from, to);
+  }
+}
+
+// Cada timer armado ou parado ganha uma geração nova: um disparo já na fila do event loop quando o
+// timer foi parado ou reprogramado chega com a geração anterior e é descartado
+static void timer_start(conn_fsm_t *fsm, uint32_t ms)
+{
+  fsm->timer_gen++;
+  fsm->ops->timer_start(ms);
+}
+
+static void timer_stop(conn_fsm_t *fsm)
+{
+  fsm->timer_gen++;
+  fsm->ops->timer_stop();
+}
+
+static void start_sta_attempt(conn_fsm_t *fsm)
+{
+  enter(fsm, CONN_STA_CONNECTING);
+  fsm->ops->wifi_connect();
+  timer_start(fsm, CONN_STA_CONNECT_TIMEOUT_MS);
+}
+
+static void start_mqtt_attempt(conn_fsm_t *fsm)
+{
+  enter(fsm, CONN_MQTT_CONNECTING);
+  fsm->ops->mqtt_connect();
+  timer_start(fsm, CONN_MQTT_CONNECT_TIMEOUT_MS);
+}
+
+static void sta_failed(conn_fsm_t *fsm)
+{
+  fsm->sta_attempts++;
+
+  if (fsm->sta_attempts >= CONN_STA_RETRY_BUDGET && !fsm->ap_active) {
+    // Orçamento esgotado: sobe o portal e continua tentando o STA, bem devagar
+    fsm->ops->wifi_disconnect();
+    fsm->ops->ap_start();
+    fsm->ap_active = 1;
+    enter(fsm, CONN_AP_FALLBACK);
+    timer_start(fsm, CONN_AP_RETRY_MS);
+    return;
+  }
+
+  if (fsm->ap_active) {
+    enter(fsm, CONN_AP_FALLBACK);
+    timer_start(fsm, CONN_AP_RETRY_MS);
+    return;
+  }
+
+  fsm->backoff_ms = conn_backoff_ms(fsm->sta_attempts - 1, fsm->ops->random());
+  enter(fsm, CONN_STA_BACKOFF);
+  timer_start(fsm, fsm->backoff_ms);
+}
+
+static void mqtt_failed(conn_fsm_t *fsm, uint32_t extra_ms)
+{
+  fsm->mqtt_attempts++;
+
+  if (fsm->mqtt_attempts >= CONN_MQTT_RETRY_BUDGET) {
+    // Pode ser o link Wi-Fi "meio vivo": derruba e recomeça do STA
+    fsm->mqtt_attempts = 0;
+    fsm->ops->wifi_disconnect();
+    fsm->backoff_ms = conn_backoff_ms(0, fsm->ops->random());
+    enter(fsm, CONN_STA_BACKOFF);
+    timer_start(fsm, fsm->backoff_ms);
+    return;
+  }
+
+  fsm->backoff_ms = conn_backoff_ms(fsm->mqtt_attempts - 1, fsm->ops->random()) + extra_ms;
+  enter(fsm, CONN_MQTT_BACKOFF);
+  timer_start(fsm, fsm->backoff_ms);
+}
+
+void conn_fsm_init(conn_fsm_t *fsm, const conn_ops_t *ops)
+{
+  memset(fsm, 0, sizeof(*fsm));
+  fsm->ops = ops;
+  fsm->state = CONN_IDLE;
+}
+
+void conn_fsm_timer_fired(conn_fsm_t *fsm, uint32_t gen)
+{
+  if (gen != fsm->timer_gen) {
+    fsm->stale_timers++;
+    return;
+  }
+  conn_fsm_handle(fsm, CONN_EV_TIMER);
+}
+
+void conn_fsm_handle(conn_fsm_t *fsm, conn_event_t event)
+{
+  switch (event) {
+  case CONN_EV_START:
+    if (fsm->state == CONN_IDLE) {
+      fsm->backoff_ms = spread_delay_ms(fsm);
+      if (fsm->backoff_ms == 0) {
+        start_sta_attempt(fsm);
+      } else {
+        enter(fsm, CONN_STA_BACKOFF);
+        timer_start(fsm, fsm->backoff_ms);
+      }
+    }
+    break;
+
+  case CONN_EV_STA_DISCONNECTED:
+    switch (fsm->state) {
+    case CONN_STA_CONNECTING:
+      timer_stop(fsm);
+      sta_failed(fsm);
+      break;
+    case CONN_MQTT_CONNECTING:
+    case CONN_MQTT_BACKOFF:
+    case CONN_ONLINE:
+      // Perdeu o AP com a sessão aberta: recomeça o ciclo do STA sem gastar orçamento
+      timer_stop(fsm);
+      fsm->sta_attempts = 0;
+      fsm->backoff_ms = conn_backoff_ms(0, fsm->ops->random()) +
+                        (fsm->state == CONN_ONLINE ? spread_delay_ms(fsm) : 0);
+      enter(fsm, CONN_STA_BACKOFF);
+      timer_start(fsm, fsm->backoff_ms);
+      break;
+    default:
+      break;
+    }
+    break;
+
+  case CONN_EV_GOT_IP:
+    // IDLE: a conexão foi feita pelo provisionamento antes da máquina assumir
+    if (fsm->state == CONN_IDLE || fsm->state == CONN_STA_CONNECTING || fsm->state == CONN_STA_BACKOFF ||
+        fsm->state == CONN_AP_FALLBACK) {
+      timer_stop(fsm);
+      fsm->sta_attempts = 0;
+      start_mqtt_attempt(fsm);
+    }
+    break;
+
+  case CONN_EV_MQTT_CONNECTED:
+    if (fsm->state == CONN_MQTT_CONNECTING || fsm->state == CONN_MQTT_BACKOFF) {
+      timer_stop(fsm);
+      fsm->mqtt_attempts = 0;
+      if (fsm->ap_active) {
+        fsm->ops->ap_stop();
+        fsm->ap_active = 0;
+      }
+      enter(fsm, CONN_ONLINE);
+    }
+    break;
+
+  case CONN_EV_MQTT_DISCONNECTED:
+    if (fsm->state == CONN_MQTT_CONNECTING || fsm->state == CONN_ONLINE) {
+      timer_stop(fsm);
+      // Caiu do ONLINE: provavelmente o broker caiu para todos, que voltariam juntos
+      mqtt_failed(fsm, fsm->state == CONN_ONLINE ? spread_delay_ms(fsm) : 0);
+    }
+    break;
+
+  case CONN_EV_TIMER:
+    switch (fsm->state) {
+    case CONN_STA_CONNECTING:
+      fsm->ops->wifi_disconnect();
+      sta_failed(fsm);
+      break;
+    case CONN_STA_BACKOFF:
+    case CONN_AP_FALLBACK:
+      start_sta_attempt(fsm);
+      break;
+    case CONN_MQTT_CONNECTING:
+      mqtt_failed(fsm, 0);
+      break;
+    case CONN_MQTT_BACKOFF:
+      start_mqtt_attempt(fsm);
+      break;
+    default:
+      break;
+    }
+    break;
+
+  case CONN_EV_RETRY:
+    if (fsm->state == CONN_STA_BACKOFF || fsm->state == CONN_AP_FALLBACK) {
+      timer_stop(fsm);
+      start_sta_attempt(fsm);
+    }
+    break;
+  }
+}
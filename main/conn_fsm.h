@@ -0,0 +1,86 @@
+#ifndef CONN_FSM_H
+#define CONN_FSM_H
+
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------------------------------------
+// MÁQUINA DE ESTADOS DE CONECTIVIDADE
+//
+// Um único lugar decide quando conectar o STA, quando cair para o AP de configuração e quando
+// reabrir a sessão MQTT. Cada falha espera um backoff exponencial com jitter, e cada fase tem um
+// orçamento de tentativas. Com spread_ms, a primeira tentativa depois do boot e a reconexão depois de
+// perder o ONLINE esperam ainda um atraso sorteado em [0, spread_ms]: quando a energia ou o broker voltam
+// para a frota inteira de uma vez, as conexões chegam espalhadas em vez de todas no mesmo instante.
+// O módulo não conhece o driver: tudo passa pelas callbacks de conn_ops_t,
+// chamadas sempre a partir de conn_fsm_handle().
+// -----------------------------------------------------------------------------------------------------------
+
+#define CONN_STA_CONNECT_TIMEOUT_MS  10000
+#define CONN_MQTT_CONNECT_TIMEOUT_MS 15000
+#define CONN_BACKOFF_BASE_MS         1000
+#define CONN_BACKOFF_MAX_MS          60000
+#define CONN_STA_RETRY_BUDGET        6      // falhas seguidas antes do fallback para AP
+#define CONN_MQTT_RETRY_BUDGET       8      // falhas seguidas antes de refazer o Wi-Fi
+#define CONN_AP_RETRY_MS             300000 // no fallback, tenta o STA de novo a cada 5 min
+#define CONN_SPREAD_MS               8000   // janela do atraso sorteado no boot e depois de cair do ONLINE
+
+typedef enum {
+  CONN_IDLE = 0,
+  CONN_STA_CONNECTING,
+  CONN_STA_BACKOFF,
+  CONN_MQTT_CONNECTING,
+  CONN_MQTT_BACKOFF,
+  CONN_ONLINE,
+  CONN_AP_FALLBACK,
+  CONN_STATE_MAX,
+} conn_state_t;
+
+typedef enum {
+  CONN_EV_START = 0,
+  CONN_EV_STA_DISCONNECTED,
+  CONN_EV_GOT_IP,
+  CONN_EV_MQTT_CONNECTED,
+  CONN_EV_MQTT_DISCONNECTED,
+  CONN_EV_TIMER,
+  CONN_EV_RETRY,        // credenciais novas: tenta o STA agora, sem esperar o backoff
+} conn_event_t;
+
+typedef struct conn_fsm conn_fsm_t;
+
+typedef struct {
+  void (*wifi_connect)(void);
+  void (*wifi_disconnect)(void);
+  void (*ap_start)(void);
+  void (*ap_stop)(void);
+  void (*mqtt_connect)(void);
+  void (*timer_start)(uint32_t ms);
+  void (*timer_stop)(void);
+  uint32_t (*random)(void);
+  void (*on_transition)(const conn_fsm_t *fsm, conn_state_t from, conn_state_t to);
+} conn_ops_t;
+
+struct conn_fsm {
+  const conn_ops_t *ops;
+  conn_state_t state;
+  uint32_t sta_attempts;
+  uint32_t mqtt_attempts;
+  uint32_t backoff_ms;          // último atraso sorteado
+  uint32_t spread_ms;           // 0 = conecta no boot sem esperar (conn_fsm_init zera)
+  uint32_t transitions;
+  uint32_t entered[CONN_STATE_MAX];
+  uint32_t timer_gen;           // muda a cada timer_start/timer_stop
+  uint32_t stale_timers;        // disparos descartados por geração velha
+  uint8_t ap_active;
+};
+
+void conn_fsm_init(conn_fsm_t *fsm, const conn_ops_t *ops);
+void conn_fsm_handle(conn_fsm_t *fsm, conn_event_t event);
+// Disparo do timer pedido por timer_start(); gen é o timer_gen lido no disparo. Vira CONN_EV_TIMER só se
+// o timer não foi parado nem reprogramado desde então
+void conn_fsm_timer_fired(conn_fsm_t *fsm, uint32_t gen);
+const char *conn_state_name(conn_state_t state);
+
+// Atraso exponencial com "equal jitter": metade fixa, metade sorteada
+uint32_t conn_backoff_ms(uint32_t attempt, uint32_t random);
+
+#endif // CONN_FSM_H
@@ -0,0 +1,339 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_console.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "diag_console.h"
+#include "publisher.h"
+#include "sched.h"
+#include "sensor.h"
+
+static const char *TAG_CONSOLE = "Console";
+
+#define CONFIG_BUF_LEN 512
+
+static const diag_console_ops_t *s_ops = NULL;
+
+// -----------------------------------------------------------------------------------------------------------
+// BENCH DO SENSOR (roda no agendador)
+// -----------------------------------------------------------------------------------------------------------
+
+typedef struct {
+  uint32_t target;
+  uint32_t done;
+  uint32_t ok;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t sum_us;
+  uint32_t faults[SENSOR_FAULTS];
+} bench_sensor_t;
+
+static bench_sensor_t s_bench;
+static sched_job_t *s_bench_job = NULL;
+static SemaphoreHandle_t s_bench_done = NULL;
+
+// Uma leitura por execução, intercalada com a aquisição no mesmo loop
+static void bench_sensor_job(void *arg)
+{
+  uint32_t wait_ms = sensor_ready_in_ms();
+  if (wait_ms > 0) {
+    sched_job_start_once(s_bench_job, wait_ms);
+    return;
+  }
+
+  int16_t temperatura, umidade;
+  int64_t start_us = esp_timer_get_time();
+  esp_err_t err = sensor_read(&temperatura, &umidade);
+  uint32_t read_us = esp_timer_get_time() - start_us;
+
+  bench_sensor_t *b = &s_bench;
+  b->done++;
+  b->sum_us += read_us;
+  if (read_us < b->min_us) b->min_us = read_us;
+  if (read_us > b->max_us) b->max_us = read_us;
+  if (err == ESP_OK) {
+    b->ok++;
+  } else {
+    b->faults[sensor_last_fault()]++;
+  }
+
+  if (b->done >= b->target) {
+    xSemaphoreGive(s_bench_done);
+    return;
+  }
+  sched_job_start_once(s_bench_job, sensor_min_interval_ms());
+}
+
+static int bench_sensor(uint32_t n)
+{
+  memset(&s_bench, 0, sizeof(s_bench));
+  s_bench.target = n;
+  s_bench.min_us = UINT32_MAX;
+  xSemaphoreTake(s_bench_done, 0);
+
+  int64_t start_us = esp_timer_get_time();
+  sched_job_start_once(s_bench_job, 0);
+  // Cada leitura pode esperar uma da aquisição e o intervalo mínimo
+  uint32_t timeout_ms = n * (2 * sensor_min_interval_ms() + 100) + 5000;
+  if (xSemaphoreTake(s_bench_done, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+    sched_job_stop(s_bench_job);
+    printf("{\"error\":\"bench sensor: %" PRIu32 " de %" PRIu32 " leituras em %" PRIu32 " ms\"}\n",
+           s_bench.done, n, timeout_ms);
+    return 1;
+  }
+
+  const bench_sensor_t *b = &s_bench;
+  printf("{\"bench\":\"sensor\",\"n\":%" PRIu32 ",\"ok\":%" PRIu32 ",\"read_us\":[%" PRIu32 ",%" PRIu32 ",%" PRIu32
+         "],\"total_ms\":%" PRIu32 ",\"faults\":{",
+         b->done, b->ok, b->min_us, (uint32_t)(b->sum_us / b->done), b->max_us,
+         (uint32_t)((esp_timer_get_time() - start_us) / 1000));
+  for (int f = 0; f < SENSOR_FAULTS; f++) {
+    printf("%s\"%s\":%" PRIu32, f ? "," : "", sensor_fault_name(f), b->faults[f]);
+  }
+  printf("}}\n");
+  return 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// BENCH DE PUBLICAÇÃO (roda na task da console)
+// -----------------------------------------------------------------------------------------------------------
+
+// Os PUBACKs contados incluem os da aquisição que chegarem no meio; em rajadas grandes a diferença some
+static int bench_publish(uint32_t n, int qos)
+{
+  publisher_stats_t before, after;
+  uint32_t failed = 0;
+  char msg[24];
+
+  publisher_get_stats(&before);
+  int64_t start_us = esp_timer_get_time();
+  for (uint32_t i = 0; i < n; i++) {
+    int len = snprintf(msg, sizeof(msg), "bench;%" PRIu32, i);
+    if (publisher_publish(s_ops->bench_topic, msg, len, qos, 0) < 0) failed++;
+  }
+  uint32_t enqueue_us = esp_timer_get_time() - start_us;
+
+  if (failed == n) {
+    printf("{\"error\":\"bench publish: nenhuma publicação aceita (MQTT desconectado?)\"}\n");
+    return 1;
+  }
+
+  uint32_t acked = 0, ack_us = 0;
+  if (qos > 0) {
+    int64_t deadline_us = start_us + DIAG_BENCH_ACK_TIMEOUT_MS * 1000LL;
+    do {
+      vTaskDelay(pdMS_TO_TICKS(10));
+      publisher_get_stats(&after);
+      acked = after.acked - before.acked;
+    } while (acked < n - failed && esp_timer_get_time() < deadline_us);
+    ack_us = esp_timer_get_time() - start_us;
+  }
+
+  printf("{\"bench\":\"publish\",\"n\":%" PRIu32 ",\"qos\":%d,\"failed\":%" PRIu32 ",\"enqueue_us\":%" PRIu32
+         ",\"enqueue_per_s\":%.1f,\"acked\":%" PRIu32 ",\"ack_ms\":%" PRIu32 ",\"ack_per_s\":%.1f}\n",
+         n, qos, failed, enqueue_us, enqueue_us ? (n - failed) * 1e6 / enqueue_us : 0.0, acked, ack_us / 1000,
+         ack_us ? acked * 1e6 / ack_us : 0.0);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// COMANDOS
+// -----------------------------------------------------------------------------------------------------------
+
+static bool parse_count(const char *arg, uint32_t max, uint32_t *n)
+{
+  char *end;
+  unsigned long value = strtoul(arg, &end, 10);
+  if (*end != '\0' || end == arg || value == 0 || value > max) return false;
+  *n = value;
+  return true;
+}
+
+static int cmd_bench(int argc, char **argv)
+{
+  uint32_t n;
+
+  if (argc >= 3 && strcmp(argv[1], "sensor") == 0) {
+    if (!parse_count(argv[2], DIAG_BENCH_SENSOR_MAX, &n)) {
+      printf("{\"error\":\"N deve ser 1..%d\"}\n", DIAG_BENCH_SENSOR_MAX);
+      return 1;
+    }
+    return bench_sensor(n);
+  }
+
+  if (argc >= 3 && strcmp(argv[1], "publish") == 0) {
+    int qos = argc >= 4 ? atoi(argv[3]) : 1;
+    if (!parse_count(argv[2], DIAG_BENCH_PUBLISH_MAX, &n) || qos < 0 || qos > 1) {
+      printf("{\"error\":\"N deve ser 1..%d e qos 0 ou 1\"}\n", DIAG_BENCH_PUBLISH_MAX);
+      return 1;
+    }
+    return bench_publish(n, qos);
+  }
+
+  printf("{\"error\":\"uso: bench sensor N | bench publish N [qos]\"}\n");
+  return 1;
+}
+
+static int cmd_config(int argc, char **argv)
+{
+  char *buf = malloc(CONFIG_BUF_LEN);
+  if (buf == NULL) {
+    printf("{\"error\":\"sem memória\"}\n");
+    return 1;
+  }
+
+  int rc = 0;
+  if (argc >= 3 && strcmp(argv[1], "set") == 0) {
+    // "config set a=1 b=2" vira o mesmo corpo do POST: a=1&b=2
+    size_t used = 0;
+    for (int i = 2; i < argc && used < CONFIG_BUF_LEN; i++) {
+      used += snprintf(buf + used, CONFIG_BUF_LEN - used, "%s%s", i > 2 ? "&" : "", argv[i]);
+    }
+    const char *error = NULL;
+    if (used >= CONFIG_BUF_LEN) {
+      error = "argumentos longos demais";
+    } else if (s_ops->config_set(buf, &error) != ESP_OK && error == NULL) {
+      error = "configuração inválida";
+    }
+    if (error) {
+      printf("{\"error\":\"%s\"}\n", error);
+      rc = 1;
+    }
+  } else if (argc != 2 || strcmp(argv[1], "get") != 0) {
+    printf("{\"error\":\"uso: config get | config set chave=valor ...\"}\n");
+    rc = 1;
+  }
+
+  if (rc == 0) {
+    s_ops->config_json(buf, CONFIG_BUF_LEN);
+    printf("%s\n", buf);
+  }
+  free(buf);
+  return rc;
+}
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+// Estado de todas as tasks; NULL sem memória. Libera com free().
+static TaskStatus_t *tasks_snapshot(UBaseType_t *count, uint32_t *total_runtime)
+{
+  UBaseType_t max = uxTaskGetNumberOfTasks() + 4;
+  TaskStatus_t *tasks = malloc(max * sizeof(TaskStatus_t));
+  if (tasks != NULL) {
+    *count = uxTaskGetSystemState(tasks, max, total_runtime);
+  }
+  return tasks;
+}
+#endif
+
+static int cmd_tasks(int argc, char **argv)
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+  UBaseType_t count;
+  uint32_t total_runtime;
+  TaskStatus_t *tasks = tasks_snapshot(&count, &total_runtime);
+  if (tasks == NULL) {
+    printf("{\"error\":\"sem memória\"}\n");
+    return 1;
+  }
+
+  // Contadores somam os dois cores
+  uint64_t percent = (uint64_t)total_runtime * portNUM_PROCESSORS / 100;
+  printf("[");
+  for (UBaseType_t i = 0; i < count; i++) {
+    int core = (tasks[i].xCoreID == tskNO_AFFINITY) ? -1 : (int)tasks[i].xCoreID;
+    printf("%s{\"name\":\"%s\",\"prio\":%u,\"core\":%d,\"stack_free\":%" PRIu32 ",\"cpu\":%" PRIu32 "}",
+           i ? "," : "", tasks[i].pcTaskName, (unsigned)tasks[i].uxCurrentPriority, core,
+           (uint32_t)tasks[i].usStackHighWaterMark, percent ? (uint32_t)(tasks[i].ulRunTimeCounter / percent) : 0);
+  }
+  printf("]\n");
+  free(tasks);
+  return 0;
+#else
+  printf("{\"error\":\"estatísticas de runtime desativadas\"}\n");
+  return 1;
+#endif
+}
+
+// /api/stats + pilha livre por task + pressão no agendador (disparos fundidos e atraso máximo)
+static int cmd_stats(int argc, char **argv)
+{
+  char *buf = malloc(DIAG_STATS_JSON_MAX_LEN);
+  if (buf == NULL) {
+    printf("{\"error\":\"sem memória\"}\n");
+    return 1;
+  }
+  s_ops->stats_json(buf, DIAG_STATS_JSON_MAX_LEN);
+  printf("{\"stats\":%s,\"stacks\":{", buf);
+  free(buf);
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+  UBaseType_t count;
+  uint32_t total_runtime;
+  TaskStatus_t *tasks = tasks_snapshot(&count, &total_runtime);
+  if (tasks != NULL) {
+    for (UBaseType_t i = 0; i < count; i++) {
+      printf("%s\"%s\":%" PRIu32, i ? "," : "", tasks[i].pcTaskName, (uint32_t)tasks[i].usStackHighWaterMark);
+    }
+    free(tasks);
+  }
+#endif
+
+  sched_job_stats_t jobs[SCHED_MAX_JOBS];
+  size_t njobs = sched_get_stats(jobs, SCHED_MAX_JOBS);
+  printf("},\"jobs\":{");
+  for (size_t i = 0; i < njobs; i++) {
+    printf("%s\"%s\":{\"runs\":%" PRIu32 ",\"coalesced\":%" PRIu32 ",\"latency_max_us\":%" PRIu32 "}",
+           i ? "," : "", jobs[i].name, jobs[i].runs, jobs[i].coalesced, jobs[i].latency_max_us);
+  }
+  printf("}}\n");
+  return 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// API
+// -----------------------------------------------------------------------------------------------------------
+
+esp_err_t diag_console_start(const diag_console_ops_t *ops, BaseType_t core)
+{
+  s_ops = ops;
+  s_bench_done = xSemaphoreCreateBinary();
+  s_bench_job = sched_job_create("bench_sensor", bench_sensor_job, NULL);
+  if (s_bench_done == NULL || s_bench_job == NULL) {
+    ESP_LOGE(TAG_CONSOLE, "Sem memória para a console");
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_console_repl_t *repl = NULL;
+  esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+  repl_config.prompt = "diag>";
+  repl_config.task_priority = DIAG_CONSOLE_PRIORITY;
+  repl_config.task_stack_size = DIAG_CONSOLE_STACK;
+  repl_config.task_core_id = core;
+  esp_console_dev_uart_config_t uart_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+  esp_err_t err = esp_console_new_repl_uart(&uart_config, &repl_config, &repl);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG_CONSOLE, "Falha ao abrir a REPL na UART: %s", esp_err_to_name(err));
+    return err;
+  }
+
+  static const esp_console_cmd_t commands[] = {
+    { .command = "stats", .help = "Contadores, pilha livre por task e trabalhos do agendador", .func = cmd_stats },
+    { .command = "tasks", .help = "Prioridade, core, pilha livre e CPU de cada task", .func = cmd_tasks },
+    { .command = "config", .help = "Lê ou altera a configuração (chaves de POST /api/config)",
+      .hint = "get | set chave=valor ...", .func = cmd_config },
+    { .command = "bench", .help = "Leituras cronometradas do sensor ou rajada de publicações",
+      .hint = "sensor N | publish N [qos]", .func = cmd_bench },
+  };
+  esp_console_register_help_command();
+  for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+    esp_console_cmd_register(&commands[i]);
+  }
+
+  ESP_LOGI(TAG_CONSOLE, "Console de diagnóstico na UART (help lista os comandos)");
+  return esp_console_start_repl(repl);
+}
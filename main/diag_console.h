@@ -0,0 +1,42 @@
+#ifndef DIAG_CONSOLE_H
+#define DIAG_CONSOLE_H
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// CONSOLE DE DIAGNÓSTICO
+//
+// REPL do esp_console na UART para diagnóstico em campo sem regravar o firmware:
+//   stats                      contadores de /api/stats, pilha livre por task e trabalhos do agendador
+//   tasks                      prioridade, core, pilha livre e CPU de cada task (como /api/tasks)
+//   config get                 configuração atual
+//   config set k=v [k=v ...]   mesmas chaves de POST /api/config
+//   bench sensor N             N leituras cronometradas: min/média/max e falhas por causa
+//   bench publish N [qos]      rajada de N publicações em <mac>/bench: vazão de envio e de PUBACK
+// Toda resposta é uma linha JSON ({"error":..} em caso de erro), para ser lida por script do host
+// (tools/diag_console.py) no meio do log. A REPL roda numa task própria de prioridade baixa; as
+// leituras do bench sensor passam pelo agendador, uma por execução, sem furar o intervalo mínimo do
+// sensor nem disputar o barramento com a aquisição.
+// -----------------------------------------------------------------------------------------------------------
+
+#define DIAG_CONSOLE_PRIORITY      2
+#define DIAG_CONSOLE_STACK         6144
+#define DIAG_BENCH_SENSOR_MAX      1000
+#define DIAG_BENCH_PUBLISH_MAX     1000
+#define DIAG_BENCH_ACK_TIMEOUT_MS  30000
+#define DIAG_STATS_JSON_MAX_LEN    2048   // buffer de stats_json, também usado por GET /api/stats
+
+// O que a console precisa do main.c
+typedef struct {
+  int (*stats_json)(char *buf, size_t len);
+  int (*config_json)(char *buf, size_t len);
+  esp_err_t (*config_set)(const char *body, const char **error);
+  const char *bench_topic;
+} diag_console_ops_t;
+
+// Depois de sched_init(): registra o trabalho do bench sensor e sobe a REPL
+esp_err_t diag_console_start(const diag_console_ops_t *ops, BaseType_t core);
+
+#endif // DIAG_CONSOLE_H
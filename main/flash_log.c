@@ -0,0 +1,420 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "flash_log.h"
+
+#define SEGMENT_MAGIC        0x32474C48  // "HLG2": registros de 8 bytes (o formato de 16 bytes era "HLOG")
+#define EMPTY_WORD           0xFFFFFFFF
+
+#define HEADER_SIZE          32
+#define INDEX_OFFSET         HEADER_SIZE
+#define INDEX_ENTRY_SIZE     8
+#define RECORDS_OFFSET       (INDEX_OFFSET + FLASH_LOG_INDEX_ENTRIES * INDEX_ENTRY_SIZE)
+#define RECORD_SIZE          sizeof(stored_record_t)
+#define RECORDS_PER_SEGMENT  ((FLASH_LOG_SEGMENT_SIZE - RECORDS_OFFSET) / RECORD_SIZE)
+#define QUERY_CHUNK_RECORDS  32
+
+// Registro na flash. packed: temperatura em [31:20] (com sinal), umidade em [19:9], bit 8 sempre 1 e
+// CRC-8 do timestamp e dos bits 31..8 em [7:0]. O timestamp vem primeiro: slot vazio = 0xFFFFFFFF.
+typedef struct {
+  uint32_t timestamp;
+  uint32_t packed;
+} stored_record_t;
+
+#define PACKED_TEMPERATURA_SHIFT  20
+#define PACKED_UMIDADE_SHIFT      9
+#define PACKED_UMIDADE_MASK       0x7FF
+#define PACKED_MARK               (1u << 8)
+
+_Static_assert(sizeof(stored_record_t) == 8, "registro do histórico deve ter 8 bytes");
+_Static_assert(RECORDS_PER_SEGMENT <= FLASH_LOG_INDEX_ENTRIES * FLASH_LOG_INDEX_STRIDE,
+               "índice esparso não cobre o segmento inteiro");
+
+typedef struct {
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t erase_count;
+  uint32_t reserved[4];
+  uint32_t crc;
+} segment_header_t;
+
+_Static_assert(sizeof(segment_header_t) == HEADER_SIZE, "cabeçalho do segmento deve ter 32 bytes");
+
+typedef struct {
+  uint32_t timestamp;
+  uint32_t record;
+} index_entry_t;
+
+typedef struct {
+  bool valid;
+  uint32_t seq;
+  uint32_t erase_count;
+  uint32_t first_ts;
+  uint32_t last_ts;
+  uint32_t count;
+} segment_info_t;
+
+static const char *TAG_LOG = "Historico";
+
+static const esp_partition_t *s_part = NULL;
+static segment_info_t *s_segments = NULL;
+static size_t s_num_segments = 0;
+static size_t s_head = 0;
+static uint32_t s_crc_errors = 0;
+static SemaphoreHandle_t s_lock = NULL;
+
+// -----------------------------------------------------------------------------------------------------------
+// AUXILIARES
+// -----------------------------------------------------------------------------------------------------------
+
+static inline size_t segment_offset(size_t idx)
+{
+  return idx * FLASH_LOG_SEGMENT_SIZE;
+}
+
+static inline size_t record_offset(size_t idx, uint32_t record)
+{
+  return segment_offset(idx) + RECORDS_OFFSET + record * RECORD_SIZE;
+}
+
+static uint32_t header_crc(const segment_header_t *hdr)
+{
+  return esp_rom_crc32_le(0, (const uint8_t *)hdr, offsetof(segment_header_t, crc));
+}
+
+static uint8_t record_crc(const stored_record_t *rec)
+{
+  uint8_t bytes[7];
+  memcpy(bytes, &rec->timestamp, 4);
+  bytes[4] = rec->packed >> 8;
+  bytes[5] = rec->packed >> 16;
+  bytes[6] = rec->packed >> 24;
+  return esp_rom_crc8_le(0, bytes, sizeof(bytes));
+}
+
+static void record_pack(stored_record_t *rec, uint32_t timestamp, int16_t temperatura, int16_t umidade)
+{
+  if (temperatura < FLASH_LOG_TEMPERATURA_MIN) temperatura = FLASH_LOG_TEMPERATURA_MIN;
+  if (temperatura > FLASH_LOG_TEMPERATURA_MAX) temperatura = FLASH_LOG_TEMPERATURA_MAX;
+  if (umidade < 0) umidade = 0;
+  if (umidade > FLASH_LOG_UMIDADE_MAX) umidade = FLASH_LOG_UMIDADE_MAX;
+
+  rec->timestamp = timestamp;
+  rec->packed = ((uint32_t)temperatura << PACKED_TEMPERATURA_SHIFT) | ((uint32_t)umidade << PACKED_UMIDADE_SHIFT) |
+                PACKED_MARK;
+  rec->packed |= record_crc(rec);
+}
+
+// false se o CRC não confere (gravação interrompida)
+static bool record_unpack(const stored_record_t *rec, flash_log_record_t *out)
+{
+  if (!(rec->packed & PACKED_MARK) || (rec->packed & 0xFF) != record_crc(rec)) return false;
+
+  out->timestamp = rec->timestamp;
+  out->temperatura = (int16_t)((int32_t)rec->packed >> PACKED_TEMPERATURA_SHIFT);
+  out->umidade = (rec->packed >> PACKED_UMIDADE_SHIFT) & PACKED_UMIDADE_MASK;
+  return true;
+}
+
+static uint32_t read_record_ts(size_t idx, uint32_t record)
+{
+  uint32_t ts = EMPTY_WORD;
+  esp_partition_read(s_part, record_offset(idx, record), &ts, sizeof(ts));
+  return ts;
+}
+
+// Registros são gravados em sequência, então o primeiro slot apagado pode ser achado por busca binária
+static uint32_t segment_count_records(size_t idx)
+{
+  uint32_t lo = 0, hi = RECORDS_PER_SEGMENT;
+
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (read_record_ts(idx, mid) != EMPTY_WORD) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static void segment_mount(size_t idx)
+{
+  segment_info_t *seg = &s_segments[idx];
+  segment_header_t hdr;
+
+  memset(seg, 0, sizeof(*seg));
+  if (esp_partition_read(s_part, segment_offset(idx), &hdr, sizeof(hdr)) != ESP_OK) {
+    return;
+  }
+
+  if (hdr.magic != SEGMENT_MAGIC || hdr.crc != header_crc(&hdr)) {
+    return;
+  }
+
+  seg->valid = true;
+  seg->seq = hdr.seq;
+  seg->erase_count = hdr.erase_count;
+  seg->count = segment_count_records(idx);
+  if (seg->count > 0) {
+    seg->first_ts = read_record_ts(idx, 0);
+    seg->last_ts = read_record_ts(idx, seg->count - 1);
+  }
+}
+
+// Apaga o próximo segmento do anel e grava um cabeçalho novo. Como a escrita sempre avança em anel,
+// todos os segmentos recebem o mesmo número de apagamentos; o contador fica no cabeçalho para diagnóstico.
+static esp_err_t segment_advance(void)
+{
+  segment_info_t *head = &s_segments[s_head];
+  uint32_t next_seq = head->valid ? head->seq + 1 : 1;
+  size_t next = (s_head + 1) % s_num_segments;
+  segment_info_t *seg = &s_segments[next];
+
+  segment_header_t hdr = {
+    .magic = SEGMENT_MAGIC,
+    .seq = next_seq,
+    .erase_count = seg->erase_count + 1,
+  };
+  memset(hdr.reserved, 0xFF, sizeof(hdr.reserved));
+  hdr.crc = header_crc(&hdr);
+
+  seg->valid = false;
+  esp_err_t err = esp_partition_erase_range(s_part, segment_offset(next), FLASH_LOG_SEGMENT_SIZE);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG_LOG, "Falha ao apagar segmento %u: %s", (unsigned)next, esp_err_to_name(err));
+    return err;
+  }
+
+  err = esp_partition_write(s_part, segment_offset(next), &hdr, sizeof(hdr));
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG_LOG, "Falha ao gravar cabeçalho do segmento %u: %s", (unsigned)next, esp_err_to_name(err));
+    return err;
+  }
+
+  memset(seg, 0, sizeof(*seg));
+  seg->valid = true;
+  seg->seq = hdr.seq;
+  seg->erase_count = hdr.erase_count;
+  s_head = next;
+
+  ESP_LOGD(TAG_LOG, "Segmento %u aberto (seq=%" PRIu32 ", apagamentos=%" PRIu32 ")",
+           (unsigned)next, seg->seq, seg->erase_count);
+  return ESP_OK;
+}
+
+// Última entrada de índice com timestamp anterior a 'from'; a varredura começa a partir dela
+static uint32_t segment_find_start(size_t idx, uint32_t count, uint32_t from)
+{
+  uint32_t entries = (count + FLASH_LOG_INDEX_STRIDE - 1) / FLASH_LOG_INDEX_STRIDE;
+  uint32_t lo = 0, hi = entries;
+  uint32_t start = 0;
+
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    index_entry_t entry;
+    esp_partition_read(s_part, segment_offset(idx) + INDEX_OFFSET + mid * INDEX_ENTRY_SIZE,
+                       &entry, sizeof(entry));
+
+    // Entrada ausente (queda de energia entre registro e índice): recua para a anterior
+    if (entry.timestamp == EMPTY_WORD || entry.timestamp >= from) {
+      hi = mid;
+    } else {
+      start = entry.record;
+      lo = mid + 1;
+    }
+  }
+  return start;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// API
+// -----------------------------------------------------------------------------------------------------------
+
+esp_err_t flash_log_init(void)
+{
+  s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FLASH_LOG_PARTITION);
+  if (s_part == NULL) {
+    ESP_LOGW(TAG_LOG, "Partição '%s' não encontrada. Histórico desativado", FLASH_LOG_PARTITION);
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  s_num_segments = s_part->size / FLASH_LOG_SEGMENT_SIZE;
+  if (s_num_segments < 2) {
+    s_part = NULL;
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  s_segments = calloc(s_num_segments, sizeof(segment_info_t));
+  s_lock = xSemaphoreCreateMutex();
+  if (s_segments == NULL || s_lock == NULL) {
+    s_part = NULL;
+    return ESP_ERR_NO_MEM;
+  }
+
+  // Sem segmentos válidos a primeira escrita abre o segmento 0
+  bool found = false;
+  s_head = s_num_segments - 1;
+  for (size_t i = 0; i < s_num_segments; i++) {
+    segment_mount(i);
+    if (s_segments[i].valid && (!found || s_segments[i].seq > s_segments[s_head].seq)) {
+      s_head = i;
+      found = true;
+    }
+  }
+
+  ESP_LOGI(TAG_LOG, "Histórico montado: %u segmentos de %u registros, cabeça=%u",
+           (unsigned)s_num_segments, (unsigned)RECORDS_PER_SEGMENT, (unsigned)s_head);
+  return ESP_OK;
+}
+
+uint32_t flash_log_capacity(void)
+{
+  return s_part != NULL ? s_num_segments * RECORDS_PER_SEGMENT : 0;
+}
+
+esp_err_t flash_log_append(uint32_t timestamp, int16_t temperatura, int16_t umidade)
+{
+  if (s_part == NULL) return ESP_ERR_INVALID_STATE;
+
+  stored_record_t rec;
+  record_pack(&rec, timestamp, temperatura, umidade);
+
+  esp_err_t err = ESP_OK;
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+
+  segment_info_t *head = &s_segments[s_head];
+  if (!head->valid || head->count >= RECORDS_PER_SEGMENT) {
+    err = segment_advance();
+    head = &s_segments[s_head];
+  }
+
+  if (err == ESP_OK) {
+    err = esp_partition_write(s_part, record_offset(s_head, head->count), &rec, sizeof(rec));
+  }
+
+  if (err == ESP_OK && head->count % FLASH_LOG_INDEX_STRIDE == 0) {
+    index_entry_t entry = { .timestamp = timestamp, .record = head->count };
+    err = esp_partition_write(s_part,
+                              segment_offset(s_head) + INDEX_OFFSET + (head->count / FLASH_LOG_INDEX_STRIDE) * INDEX_ENTRY_SIZE,
+                              &entry, sizeof(entry));
+  }
+
+  if (err == ESP_OK) {
+    if (head->count == 0) head->first_ts = timestamp;
+    head->last_ts = timestamp;
+    head->count++;
+  }
+
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+esp_err_t flash_log_query(uint32_t from, uint32_t to, flash_log_query_cb_t cb, void *ctx)
+{
+  if (s_part == NULL) return ESP_ERR_INVALID_STATE;
+
+  stored_record_t chunk[QUERY_CHUNK_RECORDS];
+  flash_log_record_t valid[QUERY_CHUNK_RECORDS];
+
+  // Percorre o anel do segmento mais antigo (logo após a cabeça) até a cabeça
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  size_t first = (s_head + 1) % s_num_segments;
+  xSemaphoreGive(s_lock);
+
+  for (size_t n = 0; n < s_num_segments; n++) {
+    size_t idx = (first + n) % s_num_segments;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    segment_info_t seg = s_segments[idx];
+    uint32_t record = 0;
+    if (seg.valid && seg.count > 0 && seg.last_ts >= from && seg.first_ts <= to) {
+      record = segment_find_start(idx, seg.count, from);
+    }
+    xSemaphoreGive(s_lock);
+
+    if (!seg.valid || seg.count == 0 || seg.last_ts < from || seg.first_ts > to) {
+      continue;
+    }
+
+    bool done = false;
+    while (!done) {
+      // O lock fica preso só durante a leitura; o callback (rede) roda sem ele
+      xSemaphoreTake(s_lock, portMAX_DELAY);
+      segment_info_t *live = &s_segments[idx];
+      if (!live->valid || live->seq != seg.seq || record >= live->count) {
+        xSemaphoreGive(s_lock);
+        break;
+      }
+      size_t count = live->count - record;
+      if (count > QUERY_CHUNK_RECORDS) count = QUERY_CHUNK_RECORDS;
+      esp_err_t err = esp_partition_read(s_part, record_offset(idx, record), chunk, count * RECORD_SIZE);
+      xSemaphoreGive(s_lock);
+
+      if (err != ESP_OK) return err;
+      record += count;
+
+      size_t n_valid = 0;
+      uint32_t crc_errors = 0;
+      for (size_t i = 0; i < count; i++) {
+        if (!record_unpack(&chunk[i], &valid[n_valid])) {
+          crc_errors++;
+          continue;
+        }
+        if (valid[n_valid].timestamp > to) {
+          done = true;
+          break;
+        }
+        if (valid[n_valid].timestamp >= from) {
+          n_valid++;
+        }
+      }
+      if (crc_errors > 0) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_crc_errors += crc_errors;
+        xSemaphoreGive(s_lock);
+      }
+
+      if (n_valid > 0 && (err = cb(valid, n_valid, ctx)) != ESP_OK) {
+        return err;
+      }
+    }
+
+    if (done) break;
+  }
+
+  return ESP_OK;
+}
+
+void flash_log_get_stats(flash_log_stats_t *stats)
+{
+  memset(stats, 0, sizeof(*stats));
+  if (s_part == NULL) return;
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  stats->segments = s_num_segments;
+  stats->min_erase_count = UINT32_MAX;
+  stats->crc_errors = s_crc_errors;
+
+  for (size_t n = 1; n <= s_num_segments; n++) {
+    const segment_info_t *seg = &s_segments[(s_head + n) % s_num_segments];
+
+    if (seg->erase_count < stats->min_erase_count) stats->min_erase_count = seg->erase_count;
+    if (seg->erase_count > stats->max_erase_count) stats->max_erase_count = seg->erase_count;
+    if (!seg->valid || seg->count == 0) continue;
+
+    if (stats->segments_used == 0) stats->oldest_ts = seg->first_ts;
+    stats->newest_ts = seg->last_ts;
+    stats->segments_used++;
+    stats->records += seg->count;
+  }
+  xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,60 @@
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// HISTÓRICO EM FLASH
+//
+// Log append-only dividido em segmentos de tamanho fixo dentro da partição "history".
+// Cada segmento tem um cabeçalho, uma área de índice esparso (timestamp -> posição do registro)
+// e os registros em si. Quando a partição enche, o segmento mais antigo é apagado e reutilizado,
+// o que faz os apagamentos girarem por todos os setores de forma uniforme.
+//
+// Na flash cada registro ocupa 8 bytes (timestamp, os dois valores em 12 e 11 bits e um CRC-8): a
+// partição de 2 MB guarda ~250 mil registros, quatro semanas a um registro a cada 10 s (ver
+// HISTORY_PERIOD_S no main.c). host/history_bench.c mede gravação e consulta sobre uma partição em RAM.
+// -----------------------------------------------------------------------------------------------------------
+
+#define FLASH_LOG_PARTITION      "history"
+#define FLASH_LOG_SEGMENT_SIZE   (16 * 1024)
+#define FLASH_LOG_INDEX_ENTRIES  64
+#define FLASH_LOG_INDEX_STRIDE   32   // uma entrada de índice a cada N registros
+
+// Faixa gravada; valores fora dela são saturados
+#define FLASH_LOG_TEMPERATURA_MIN  (-2048)
+#define FLASH_LOG_TEMPERATURA_MAX  2047
+#define FLASH_LOG_UMIDADE_MAX      2047
+
+// Registro como entregue às consultas (e no formato bin de /api/history)
+typedef struct {
+  uint32_t timestamp;     // epoch em segundos
+  int16_t temperatura;    // décimos de °C
+  int16_t umidade;        // décimos de %
+} flash_log_record_t;
+
+typedef struct {
+  uint32_t segments;
+  uint32_t segments_used;
+  uint32_t records;
+  uint32_t oldest_ts;
+  uint32_t newest_ts;
+  uint32_t min_erase_count;
+  uint32_t max_erase_count;
+  uint32_t crc_errors;
+} flash_log_stats_t;
+
+// Chamado com blocos de registros válidos, em ordem cronológica. Retornar algo diferente de ESP_OK
+// interrompe a consulta.
+typedef esp_err_t (*flash_log_query_cb_t)(const flash_log_record_t *records, size_t count, void *ctx);
+
+esp_err_t flash_log_init(void);
+// Total de registros que cabem na partição montada (0 sem histórico)
+uint32_t flash_log_capacity(void);
+esp_err_t flash_log_append(uint32_t timestamp, int16_t temperatura, int16_t umidade);
+esp_err_t flash_log_query(uint32_t from, uint32_t to, flash_log_query_cb_t cb, void *ctx);
+void flash_log_get_stats(flash_log_stats_t *stats);
+
+#endif // FLASH_LOG_H
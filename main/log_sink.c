@@ -0,0 +1,158 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "log_sink.h"
+
+#define DRAIN_TASK_PRIORITY  1
+
+static RingbufHandle_t s_ring = NULL;
+static volatile uint8_t s_sinks = LOG_SINK_UART;
+static volatile uint32_t s_dropped = 0;
+
+static esp_mqtt_client_handle_t s_mqtt_client = NULL;
+static char s_mqtt_topic[64];
+
+static SemaphoreHandle_t s_tail_lock = NULL;
+static char s_tail[LOG_SINK_TAIL_SIZE];
+static size_t s_tail_head = 0;   // próxima posição de escrita
+static bool s_tail_full = false;
+
+// -----------------------------------------------------------------------------------------------------------
+// PRODUTOR
+// -----------------------------------------------------------------------------------------------------------
+
+static int log_sink_vprintf(const char *fmt, va_list args)
+{
+  char line[LOG_SINK_LINE_MAX];
+  int len = vsnprintf(line, sizeof(line), fmt, args);
+
+  if (len < 0) return len;
+  if (len >= (int)sizeof(line)) {
+    len = sizeof(line) - 1;
+    line[len - 1] = '\n';
+  }
+
+  // Nunca bloqueia: sem espaço no ring a linha vira apenas um contador
+  if (xRingbufferSend(s_ring, line, len, 0) != pdTRUE) {
+    s_dropped++;
+  }
+  return len;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// DESTINOS
+// -----------------------------------------------------------------------------------------------------------
+
+static void tail_append(const char *data, size_t len)
+{
+  xSemaphoreTake(s_tail_lock, portMAX_DELAY);
+  for (size_t i = 0; i < len; i++) {
+    s_tail[s_tail_head] = data[i];
+    s_tail_head = (s_tail_head + 1) % sizeof(s_tail);
+    if (s_tail_head == 0) s_tail_full = true;
+  }
+  xSemaphoreGive(s_tail_lock);
+}
+
+static void dispatch(const char *data, size_t len)
+{
+  uint8_t sinks = s_sinks;
+
+  if (sinks & LOG_SINK_UART) {
+    fwrite(data, 1, len, stdout);
+  }
+  if (sinks & LOG_SINK_HTTP) {
+    tail_append(data, len);
+  }
+  if ((sinks & LOG_SINK_MQTT) && s_mqtt_client != NULL) {
+    esp_mqtt_client_publish(s_mqtt_client, s_mqtt_topic, data, len, 0, 0);
+  }
+}
+
+static void log_drain_task(void *arg)
+{
+  uint32_t reported_dropped = 0;
+
+  while (1) {
+    size_t len;
+    char *item = xRingbufferReceive(s_ring, &len, portMAX_DELAY);
+    if (item == NULL) continue;
+
+    dispatch(item, len);
+    vRingbufferReturnItem(s_ring, item);
+
+    uint32_t dropped = s_dropped;
+    if (dropped != reported_dropped && xRingbufferGetCurFreeSize(s_ring) > LOG_SINK_RING_SIZE / 2) {
+      char msg[64];
+      int n = snprintf(msg, sizeof(msg), "W (%lu) log: %lu linhas descartadas\n",
+                       (unsigned long)esp_log_timestamp(), (unsigned long)(dropped - reported_dropped));
+      dispatch(msg, n);
+      reported_dropped = dropped;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// API
+// -----------------------------------------------------------------------------------------------------------
+
+esp_err_t log_sink_init(uint8_t sinks)
+{
+  s_ring = xRingbufferCreate(LOG_SINK_RING_SIZE, RINGBUF_TYPE_NOSPLIT);
+  s_tail_lock = xSemaphoreCreateMutex();
+  if (s_ring == NULL || s_tail_lock == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  s_sinks = sinks;
+  if (xTaskCreatePinnedToCore(log_drain_task, "log_drain_task", 3072, NULL, DRAIN_TASK_PRIORITY, NULL,
+                              LOG_SINK_TASK_CORE) != pdPASS) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  esp_log_set_vprintf(log_sink_vprintf);
+  return ESP_OK;
+}
+
+void log_sink_set_sinks(uint8_t sinks)
+{
+  s_sinks = sinks;
+}
+
+uint8_t log_sink_get_sinks(void)
+{
+  return s_sinks;
+}
+
+void log_sink_set_mqtt(esp_mqtt_client_handle_t client, const char *topic)
+{
+  strncpy(s_mqtt_topic, topic, sizeof(s_mqtt_topic) - 1);
+  s_mqtt_client = client;
+}
+
+uint32_t log_sink_get_dropped(void)
+{
+  return s_dropped;
+}
+
+size_t log_sink_read_tail(char *buf, size_t len)
+{
+  size_t n = 0;
+
+  if (len == 0 || s_tail_lock == NULL) return 0;
+
+  xSemaphoreTake(s_tail_lock, portMAX_DELAY);
+  size_t start = s_tail_full ? s_tail_head : 0;
+  size_t avail = s_tail_full ? sizeof(s_tail) : s_tail_head;
+  for (; n < avail && n < len - 1; n++) {
+    buf[n] = s_tail[(start + n) % sizeof(s_tail)];
+  }
+  xSemaphoreGive(s_tail_lock);
+
+  buf[n] = '\0';
+  return n;
+}
@@ -0,0 +1,36 @@
+#ifndef LOG_SINK_H
+#define LOG_SINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "mqtt_client.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// LOG ASSÍNCRONO
+//
+// Substitui o vprintf do esp_log: a task que loga só formata a linha e a coloca num ring buffer,
+// sem esperar a UART. Uma task de baixa prioridade esvazia o ring para os destinos habilitados.
+// Se o ring estiver cheio a linha é descartada e contada, nunca bloqueia quem chamou.
+// -----------------------------------------------------------------------------------------------------------
+
+#define LOG_SINK_RING_SIZE   4096
+#define LOG_SINK_LINE_MAX    160
+#define LOG_SINK_TAIL_SIZE   2048   // últimas linhas mantidas para GET /api/logs
+#define LOG_SINK_TASK_CORE   0      // PRO_CPU, junto da pilha de rede que alimenta
+
+#define LOG_SINK_UART  (1 << 0)
+#define LOG_SINK_HTTP  (1 << 1)
+#define LOG_SINK_MQTT  (1 << 2)
+
+esp_err_t log_sink_init(uint8_t sinks);
+void log_sink_set_sinks(uint8_t sinks);
+uint8_t log_sink_get_sinks(void);
+void log_sink_set_mqtt(esp_mqtt_client_handle_t client, const char *topic);
+uint32_t log_sink_get_dropped(void);
+
+// Copia o conteúdo atual do tail (texto, terminado em '\0'); devolve o número de bytes copiados
+size_t log_sink_read_tail(char *buf, size_t len);
+
+#endif // LOG_SINK_H
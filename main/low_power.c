@@ -0,0 +1,211 @@
+#include <inttypes.h>
+#include <string.h>
+#include <sys/time.h>
+#include "driver/rtc_io.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "low_power.h"
+
+static const char *TAG_LP = "Baixo consumo";
+
+// Tudo que precisa atravessar o deep sleep. RTC_DATA_ATTR volta a zero em power-on.
+typedef struct {
+  low_power_sample_t samples[LOW_POWER_BUFFER_SIZE];
+  uint16_t head;
+  uint16_t count;
+  bool flush_requested;
+
+  bool ap_cached;
+  uint8_t bssid[6];
+  uint8_t channel;
+
+  int64_t sleep_start_us;   // relógio de parede no momento de dormir
+  uint32_t wakes;
+  uint32_t samples_total;
+  uint32_t flushes;
+  uint32_t failed_flushes;
+  uint64_t sleep_ms;
+  uint64_t awake_ms;
+  uint64_t radio_ms;
+} low_power_rtc_t;
+
+static RTC_DATA_ATTR low_power_rtc_t s_rtc;
+
+static int64_t s_radio_on_us = 0;
+
+static int64_t wall_clock_us(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// CICLO
+// -----------------------------------------------------------------------------------------------------------
+
+void low_power_boot(void)
+{
+  if (s_rtc.sleep_start_us != 0) {
+    // O relógio do sistema continua contando no RTC durante o deep sleep
+    int64_t slept_us = wall_clock_us() - s_rtc.sleep_start_us;
+    if (slept_us > 0) {
+      s_rtc.sleep_ms += slept_us / 1000;
+    }
+    s_rtc.sleep_start_us = 0;
+  }
+  s_rtc.wakes++;
+}
+
+bool low_power_timer_wakeup(void)
+{
+  return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+}
+
+void low_power_sleep(uint32_t seconds, int wake_gpio)
+{
+  low_power_radio_off();
+  s_rtc.awake_ms += esp_timer_get_time() / 1000;
+  s_rtc.sleep_start_us = wall_clock_us();
+
+  esp_sleep_enable_timer_wakeup((uint64_t)seconds * 1000000);
+  if (wake_gpio >= 0 && rtc_gpio_is_valid_gpio(wake_gpio)) {
+    rtc_gpio_pullup_en(wake_gpio);
+    esp_sleep_enable_ext0_wakeup(wake_gpio, 0);
+  }
+
+  ESP_LOGI(TAG_LP, "Dormindo %" PRIu32 " s (%u amostras no buffer)", seconds, s_rtc.count);
+  esp_deep_sleep_start();
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// BUFFER
+// -----------------------------------------------------------------------------------------------------------
+
+bool low_power_push(uint32_t timestamp, int16_t temperatura, int16_t umidade)
+{
+  uint16_t tail = (s_rtc.head + s_rtc.count) % LOW_POWER_BUFFER_SIZE;
+  s_rtc.samples[tail] = (low_power_sample_t){
+    .timestamp = timestamp,
+    .temperatura = temperatura,
+    .umidade = umidade,
+  };
+  if (s_rtc.count < LOW_POWER_BUFFER_SIZE) {
+    s_rtc.count++;
+  } else {
+    // Envios falhando há um buffer inteiro: a mais antiga é perdida
+    s_rtc.head = (s_rtc.head + 1) % LOW_POWER_BUFFER_SIZE;
+  }
+  s_rtc.samples_total++;
+  return low_power_flush_due();
+}
+
+void low_power_request_flush(void)
+{
+  s_rtc.flush_requested = true;
+}
+
+bool low_power_flush_due(void)
+{
+  return s_rtc.flush_requested || s_rtc.count >= LOW_POWER_BUFFER_SIZE;
+}
+
+size_t low_power_count(void)
+{
+  return s_rtc.count;
+}
+
+const low_power_sample_t *low_power_sample(size_t index)
+{
+  if (index >= s_rtc.count) return NULL;
+  return &s_rtc.samples[(s_rtc.head + index) % LOW_POWER_BUFFER_SIZE];
+}
+
+void low_power_clear(void)
+{
+  s_rtc.head = 0;
+  s_rtc.count = 0;
+  s_rtc.flush_requested = false;
+}
+
+void low_power_flush_result(bool ok)
+{
+  if (ok) {
+    s_rtc.flushes++;
+  } else {
+    s_rtc.failed_flushes++;
+  }
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// RECONEXÃO RÁPIDA
+// -----------------------------------------------------------------------------------------------------------
+
+void low_power_save_ap(const uint8_t bssid[6], uint8_t channel)
+{
+  memcpy(s_rtc.bssid, bssid, sizeof(s_rtc.bssid));
+  s_rtc.channel = channel;
+  s_rtc.ap_cached = true;
+}
+
+bool low_power_get_ap(uint8_t bssid[6], uint8_t *channel)
+{
+  if (!s_rtc.ap_cached) return false;
+  memcpy(bssid, s_rtc.bssid, sizeof(s_rtc.bssid));
+  *channel = s_rtc.channel;
+  return true;
+}
+
+void low_power_forget_ap(void)
+{
+  s_rtc.ap_cached = false;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// ENERGIA
+// -----------------------------------------------------------------------------------------------------------
+
+void low_power_radio_on(void)
+{
+  if (s_radio_on_us == 0) {
+    s_radio_on_us = esp_timer_get_time();
+  }
+}
+
+void low_power_radio_off(void)
+{
+  if (s_radio_on_us != 0) {
+    s_rtc.radio_ms += (esp_timer_get_time() - s_radio_on_us) / 1000;
+    s_radio_on_us = 0;
+  }
+}
+
+void low_power_get_energy(low_power_energy_t *energy)
+{
+  // Ciclo atual ainda não foi somado
+  uint64_t awake_ms = s_rtc.awake_ms + esp_timer_get_time() / 1000;
+  uint64_t radio_ms = s_rtc.radio_ms;
+  if (s_radio_on_us != 0) {
+    radio_ms += (esp_timer_get_time() - s_radio_on_us) / 1000;
+  }
+
+  energy->wakes = s_rtc.wakes;
+  energy->samples = s_rtc.samples_total;
+  energy->flushes = s_rtc.flushes;
+  energy->failed_flushes = s_rtc.failed_flushes;
+  energy->sleep_ms = s_rtc.sleep_ms;
+  energy->awake_ms = awake_ms;
+  energy->radio_ms = radio_ms;
+  energy->radio_ms_per_sample = s_rtc.samples_total ? (uint32_t)(radio_ms / s_rtc.samples_total) : 0;
+
+  // Carga em µA·ms dividida pelo tempo total
+  uint64_t total_ms = s_rtc.sleep_ms + awake_ms;
+  uint64_t cpu_ms = awake_ms > radio_ms ? awake_ms - radio_ms : 0;
+  uint64_t charge = s_rtc.sleep_ms * LOW_POWER_I_SLEEP_UA + cpu_ms * LOW_POWER_I_AWAKE_MA * 1000ULL +
+                    radio_ms * LOW_POWER_I_RADIO_MA * 1000ULL;
+  energy->avg_current_ua = total_ms ? (uint32_t)(charge / total_ms) : 0;
+  energy->battery_days = energy->avg_current_ua ?
+                         (uint32_t)((uint64_t)LOW_POWER_BATTERY_MAH * 1000 / energy->avg_current_ua / 24) : 0;
+}
@@ -0,0 +1,74 @@
+#ifndef LOW_POWER_H
+#define LOW_POWER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------------------------------------
+// MODO DE BAIXO CONSUMO
+//
+// Entre amostras o ESP32 fica em deep sleep. Cada despertar lê o sensor e guarda a leitura num buffer
+// na RTC slow memory, que sobrevive ao deep sleep; o Wi-Fi só sobe quando o buffer enche (ou quando
+// alguém pede um envio antecipado). O BSSID e o canal do último AP também ficam na RTC para a
+// reconexão pular a varredura. Os tempos de CPU e rádio de cada ciclo alimentam um modelo de energia
+// simples com as correntes abaixo.
+// -----------------------------------------------------------------------------------------------------------
+
+#define LOW_POWER_BUFFER_SIZE        64     // amostras na RTC slow memory (8 B cada)
+#define LOW_POWER_SLEEP_DEFAULT_S    60
+#define LOW_POWER_CONNECT_TIMEOUT_MS 15000  // desiste do envio e volta a dormir com o buffer intacto
+#define LOW_POWER_ACK_TIMEOUT_MS     5000
+
+// Modelo de energia (placa + AM2301 alimentado direto)
+#define LOW_POWER_I_SLEEP_UA         150
+#define LOW_POWER_I_AWAKE_MA         40     // CPU ativa, rádio desligado
+#define LOW_POWER_I_RADIO_MA         130    // média com Wi-Fi ligado (TX em rajadas)
+#define LOW_POWER_BATTERY_MAH        2600
+
+typedef struct {
+  uint32_t timestamp;
+  int16_t temperatura;
+  int16_t umidade;
+} low_power_sample_t;
+
+typedef struct {
+  uint32_t wakes;
+  uint32_t samples;
+  uint32_t flushes;
+  uint32_t failed_flushes;
+  uint64_t sleep_ms;
+  uint64_t awake_ms;            // inclui o tempo de rádio
+  uint64_t radio_ms;
+  uint32_t radio_ms_per_sample;
+  uint32_t avg_current_ua;
+  uint32_t battery_days;
+} low_power_energy_t;
+
+// Chamado logo no boot: valida a RTC (perdida em power-on) e contabiliza o sono que terminou
+void low_power_boot(void);
+bool low_power_timer_wakeup(void);
+
+// Guarda uma leitura; devolve true quando o buffer pede envio
+bool low_power_push(uint32_t timestamp, int16_t temperatura, int16_t umidade);
+void low_power_request_flush(void);
+bool low_power_flush_due(void);
+size_t low_power_count(void);
+const low_power_sample_t *low_power_sample(size_t index);   // 0 = mais antiga
+void low_power_clear(void);
+void low_power_flush_result(bool ok);
+
+// Reconexão rápida
+void low_power_save_ap(const uint8_t bssid[6], uint8_t channel);
+bool low_power_get_ap(uint8_t bssid[6], uint8_t *channel);
+void low_power_forget_ap(void);
+
+void low_power_radio_on(void);
+void low_power_radio_off(void);
+
+void low_power_get_energy(low_power_energy_t *energy);
+
+// Não retorna. Acorda pelo timer ou pelo botão (que força um boot em modo normal)
+void low_power_sleep(uint32_t seconds, int wake_gpio);
+
+#endif // LOW_POWER_H
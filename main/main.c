@@ -1,21 +1,47 @@
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include "dht.h"
+#include <sys/time.h>
+#include "adaptive_sampler.h"
+#include "aggregate.h"
+#include "alarm.h"
+#include "app_config.h"
+#include "app_publish.h"
+#include "conn_fsm.h"
+#include "diag_console.h"
 #include "driver/gpio.h"
-#include "esp_crt_bundle.h"
+#include "esp_attr.h"
 #include "esp_event.h"
+#include "esp_heap_caps.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_netif.h"
+#include "esp_netif_sntp.h"
+#include "esp_random.h"
+#include "esp_sleep.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
+#include "flash_log.h"
+#include "log_sink.h"
+#include "low_power.h"
+#include "msg_pool.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "freertos/task.h"
 #include "mqtt_client.h"
 #include "nvs_flash.h"
+#include "publisher.h"
+#include "sample_filter.h"
+#include "sample_seq.h"
+#include "sched.h"
+#include "sensor.h"
+#include "sensor_health.h"
+#include "tls_profile.h"
+#include "worker.h"
 
 #define WIFI_STA_SSID   ""
 #define WIFI_STA_PASS   ""
@@ -28,31 +54,125 @@
 
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
+#define MQTT_CONNECTED_BIT BIT2
 
 #define CONFIG_BROKER_URL     "mqtts://38046a81f3ca4a18aa3b57d26f8a9887.s1.eu.hivemq.cloud:8883"
 #define CONFIG_MQTT_USERNAME  "ESP32"
 #define CONFIG_MQTT_PASSWORD  "Senha1234"
 
-#define SENSOR_TYPE           DHT_TYPE_AM2301
-#define SENSOR_GPIO           33
 #define LED_CONFIG_GPIO       14
 #define LED_TEMPERATURA_GPIO  27
 #define LED_UMIDADE_GPIO      26
 #define LED_ERRO_GPIO         25
 #define BOTAO_RESET_GPIO      32
 
+// Topologia de tasks: o agendador (aquisição do DHT, com seção crítica longa, e os trabalhos curtos de
+// botão e LEDs) fica sozinho no APP_CPU, enquanto Wi-Fi, lwIP, MQTT/TLS e o webserver ficam no PRO_CPU
+// (ver sdkconfig.defaults)
+#if CONFIG_FREERTOS_UNICORE
+#define CORE_AQUISICAO        0
+#else
+#define CORE_AQUISICAO        APP_CPU_NUM
+#endif
+#define CORE_REDE             PRO_CPU_NUM
+
+#define PRIO_DHT              10
+#define PRIO_SAIDA            5       // histórico em flash e publicações da aquisição (worker.h)
+#define SAMPLE_VERBOSE_MIN_INTERVAL_MS 1000   // blink e log por leitura só com intervalos a partir deste
+#define PRIO_BOTAO            4
+#define BOTAO_POLL_MS         100
+#define BOTAO_HOLD_MS         3000    // segurar o reset por isso apaga o NVS
+#define LED_BLINK_MS          300
+
+#define PROV_TIMEOUT_MS       20000   // teste de credenciais do portal sem IP -> falha
+#define PROV_AP_GRACE_MS      15000   // AP continua no ar depois de ONLINE para o portal ler o resultado
+#define PROV_REASON_TIMEOUT   (-1)
+
+#define SNTP_SERVER           "pool.ntp.org"
+#define HISTORY_MIN_EPOCH     1704067200  // 01/01/2024: antes disso o relógio ainda não foi sincronizado
+#define HISTORY_PERIOD_S      10          // um registro (média) por período: ~4 semanas em 2 MB
+
+#define ALARM_LATENCY_BUDGET_MS 2000  // leitura -> PUBACK do alarme
+#define ALARM_LATENCY_SLOTS   4
+
+#define SNAPSHOT_MIN_MS       30000   // leituras novas republicam o retrato retido no máximo nesse ritmo
+#define PRESENCE_OFFLINE      "{\"online\":false}"   // Last Will em <mac>/presenca
+
 static char device_mac_str[18];
 static char topic_umidade[64];
 static char topic_temperatura[64];
-static int s_retry_num = 0;
+static char topic_umidade_agg[64];
+static char topic_temperatura_agg[64];
+static char topic_log[64];
+static char topic_amostragem[64];
+static char topic_nack[64];
+static const char *const sample_topics[] = { topic_umidade, topic_temperatura };
+static app_config_t s_cfg;   // preenchida em app_main (padrões + NVS)
+// config_apply troca s_cfg inteira a partir do httpd ou da console; quem lê de outra task copia com config_get
+static portMUX_TYPE s_cfg_lock = portMUX_INITIALIZER_UNLOCKED;
+// Na RTC para o estado dos alarmes (e a taxa de variação) sobreviver ao deep sleep
+static RTC_DATA_ATTR alarm_t s_alarms[APP_METRICS];
+static RTC_DATA_ATTR uint8_t s_alarm_unsent[APP_METRICS];   // bit por alarm_kind_t: mudou sem cliente MQTT
+// Os dois acima são avaliados pelo agendador, reconfigurados pelo HTTP/console e esvaziados pela task do
+// MQTT no CONNECTED. A seção crítica só cobre o estado; log e publicação ficam do lado de fora
+static portMUX_TYPE s_alarm_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_alarm_sent = 0;
+static uint32_t s_alarm_acked = 0;
+static uint32_t s_alarm_over_budget = 0;
+static uint32_t s_alarm_latency_min_ms = UINT32_MAX;
+static uint32_t s_alarm_latency_max_ms = 0;
+static uint64_t s_alarm_latency_sum_ms = 0;
+// Métricas de desempenho lidas pela suíte de regressão (tools/perf_suite.py)
+static int64_t s_online_lost_us = 0;
+static uint32_t s_reconnects = 0;
+static uint32_t s_reconnect_last_ms = 0;
+static uint32_t s_reconnect_max_ms = 0;
+static uint32_t s_samples = 0;
+static uint64_t s_sample_sum_us = 0;
+static uint32_t s_sample_max_us = 0;
+// Filtro de leituras por métrica; contadores de rejeição vão para /api/stats
+static sample_filter_t s_filters[APP_METRICS];
+// Repetição e backoff das leituras com falha; telemetria em <mac>/sensor
+static sensor_health_t s_sensor_health;
+static int64_t s_sensor_health_sent_us = 0;
+// Retrato retido em <mac>/estado; só o agendador mexe nele
+static app_snapshot_t s_snapshot;
+static bool s_snapshot_changed = false;
+static int64_t s_snapshot_sent_us = 0;
+// Sincronização SNTP: base dos carimbos de tempo dos registros (stamps=1)
+static uint32_t s_sntp_syncs = 0;
+static int64_t s_sntp_sync_us = 0;
+static int64_t s_sntp_offset_us = 0;   // relógio de parede - esp_timer no último acerto
+static int32_t s_sntp_step_ms = 0;     // salto aplicado no último acerto: deriva acumulada desde o anterior
 static esp_mqtt_client_handle_t global_mqtt_client = NULL;
 static EventGroupHandle_t s_wifi_event_group;
-TaskHandle_t ap_blink_handle = NULL;
+static httpd_handle_t s_httpd = NULL;
+static conn_fsm_t s_conn;
+static esp_timer_handle_t s_conn_timer = NULL;
+static esp_timer_handle_t s_ap_stop_timer = NULL;
+static char topic_conectividade[64];
+static char topic_lote[64];
+static char topic_alarme[64];
+static char topic_energia[64];
+static char topic_sensor[64];
+static char topic_bench[64];
+static char topic_estado[64];
+static char topic_presenca[64];
+
+ESP_EVENT_DEFINE_BASE(CONN_EVENT);
+static sched_job_t *s_reset_button_job = NULL;
+static sched_job_t *s_ap_blink_job = NULL;
+static sched_job_t *s_acquisition_job = NULL;
+static sched_job_t *s_snapshot_job = NULL;
+static sched_job_t *s_led_off_jobs[3] = { NULL };
+static const int s_blink_leds[3] = { LED_UMIDADE_GPIO, LED_TEMPERATURA_GPIO, LED_ERRO_GPIO };
+static const char *const s_blink_job_names[3] = { "led_umidade", "led_temperatura", "led_erro" };
 
 static const char *TAG_AP   = "WiFi SoftAP";
 static const char *TAG_STA  = "WiFi Sta";
 static const char *TAG_HTTP = "Webserver";
 static const char *TAG_MQTT = "MQTT";
+static const char *TAG_HIST = "Historico";
 static char wifi_config_html[9000];
 static char wifi_config_html_template[] =
 "<!DOCTYPE html>"
@@ -364,11 +484,24 @@ static char wifi_config_html_template[] =
 "        'Content-Type': 'application/x-www-form-urlencoded',"
 "      },"
 "      body: formData.toString()"
-"    }).then(function(response) { return response.text(); })"
-"      .then(function(data) { console.log(data); salvarConfigButton.classList.remove('btn-loading'); alert(data); })"
+"    }).then(function(response) {"
+"        if (!response.ok) { return response.text().then(function(text) { throw new Error(text); }); }"
+"        setTimeout(acompanharConexao, 1000);"
+"      })"
 "      .catch(function(error) { console.error('Error creating post:', error); salvarConfigButton.classList.remove('btn-loading'); alert('Erro ao conectar: ' + error.message); });"
 "  } else { salvarConfigButton.classList.remove('btn-loading'); }"
 "});"
+""
+"function acompanharConexao() {"
+"  fetch('/wifi/status').then(function(response) { return response.json(); })"
+"    .then(function(status) {"
+"      if (status.estado === 'testando') { setTimeout(acompanharConexao, 1000); return; }"
+"      salvarConfigButton.classList.remove('btn-loading');"
+"      if (status.estado === 'conectado') { alert('Conectado a ' + status.ssid + ' (IP ' + status.ip + ') em ' + status.ms + ' ms. WiFi salvo.'); configModal.close(); }"
+"      else { alert('Falha ao conectar a ' + status.ssid + ' (reason ' + status.reason + '). Verifique os dados e tente de novo.'); }"
+"    })"
+"    .catch(function(error) { setTimeout(acompanharConexao, 1000); });"
+"}"
 "  </script>"
 "</body>"
 "</html>";
@@ -402,11 +535,29 @@ void config_sensor(void)
   gpio_set_direction(SENSOR_GPIO, GPIO_MODE_INPUT);
 }
 
+void alarm_led_update(void);
+
+// O LED de erro também mostra alarme ativo: ao fim do pisca volta ao estado do alarme
+static void led_off_job(void *arg)
+{
+  int led = (int)(intptr_t)arg;
+  if (led == LED_ERRO_GPIO) {
+    alarm_led_update();
+  } else {
+    gpio_set_level(led, 0);
+  }
+}
+
+// Acende e agenda o apagar, sem prender o agendador pelos 300 ms do pisca
 void blink_led(int LED_GPIO)
 {
-    gpio_set_level(LED_GPIO, 1);
-    vTaskDelay(pdMS_TO_TICKS(300));
-    gpio_set_level(LED_GPIO, 0);
+  for (size_t i = 0; i < sizeof(s_blink_leds) / sizeof(s_blink_leds[0]); i++) {
+    if (s_blink_leds[i] == LED_GPIO && s_led_off_jobs[i] != NULL) {
+      gpio_set_level(LED_GPIO, 1);
+      sched_job_start_once(s_led_off_jobs[i], LED_BLINK_MS);
+      return;
+    }
+  }
 }
 
 esp_err_t get_esp_mac_address(char *mac_addr_str)
@@ -428,7 +579,11 @@ esp_err_t get_esp_mac_address(char *mac_addr_str)
 
 esp_netif_t *wifi_init_softap(void)
 {
-  esp_netif_t *esp_netif_ap = esp_netif_create_default_wifi_ap();
+  // O fallback pode subir o AP mais de uma vez; a netif só pode ser criada uma
+  static esp_netif_t *esp_netif_ap = NULL;
+  if (esp_netif_ap == NULL) {
+    esp_netif_ap = esp_netif_create_default_wifi_ap();
+  }
   wifi_config_t wifi_ap_config = {
     .ap = {
       .ssid = WIFI_AP_SSID,
@@ -449,9 +604,15 @@ esp_netif_t *wifi_init_softap(void)
   return esp_netif_ap;
 }
 
-esp_netif_t *wifi_init_sta(const char *ssid, const char *password)
+// Só troca a configuração: o chamador garante que o STA não está no meio de uma conexão, senão o driver
+// recusa com ESP_ERR_WIFI_STATE
+esp_err_t wifi_init_sta(const char *ssid, const char *password)
 {
-  esp_netif_t *esp_netif_sta = esp_netif_create_default_wifi_sta();
+  // O provisionamento pode trocar as credenciais sem reiniciar; a netif só pode ser criada uma vez
+  static esp_netif_t *esp_netif_sta = NULL;
+  if (esp_netif_sta == NULL) {
+    esp_netif_sta = esp_netif_create_default_wifi_sta();
+  }
 
   wifi_config_t wifi_sta_config = {
     .sta = {
@@ -465,9 +626,13 @@ esp_netif_t *wifi_init_sta(const char *ssid, const char *password)
   strncpy((char *)wifi_sta_config.sta.ssid, ssid, sizeof(wifi_sta_config.sta.ssid) - 1);
   strncpy((char *)wifi_sta_config.sta.password, password, sizeof(wifi_sta_config.sta.password) - 1);
 
-  ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_sta_config));
+  esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &wifi_sta_config);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG_STA, "Falha ao configurar o STA: %s", esp_err_to_name(err));
+    return err;
+  }
   ESP_LOGI(TAG_STA, "Inicialização do modo STA concluída.");
-  return esp_netif_sta;
+  return ESP_OK;
 }
 
 // -----------------------------------------------------------------------------------------------------------
@@ -486,6 +651,30 @@ esp_err_t wifi_get_handler(httpd_req_t *req)
   return ESP_OK;
 }
 
+esp_err_t prov_begin(const char *ssid, const char *password);
+void prov_status_json(char *buf, size_t len);
+
+// Corpo inteiro de um POST pequeno em buf (terminado em '\0'): o httpd entrega o que chegou no socket,
+// então um corpo pode vir em várias leituras. Corpo grande demais já responde 400 e devolve
+// ESP_ERR_INVALID_SIZE; erro de socket devolve ESP_FAIL (o httpd fecha a conexão).
+static esp_err_t recv_body(httpd_req_t *req, char *buf, size_t len)
+{
+  if (req->content_len >= len) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad request");
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  size_t received = 0;
+  while (received < req->content_len) {
+    int ret = httpd_req_recv(req, buf + received, req->content_len - received);
+    if (ret == HTTPD_SOCK_ERR_TIMEOUT) continue;
+    if (ret <= 0) return ESP_FAIL;
+    received += ret;
+  }
+  buf[received] = '\0';
+  return ESP_OK;
+}
+
 esp_err_t wifi_post_handler(httpd_req_t *req)
 {
   char buf[256];
@@ -518,19 +707,419 @@ esp_err_t wifi_post_handler(httpd_req_t *req)
 
   ESP_LOGI(TAG_HTTP, "Recebido via POST -> SSID: %s | PASS: %s", ssid, pass);
 
-  // Salva no NVS
-  nvs_handle handle;
-  if (nvs_open("storage", NVS_READWRITE, &handle) == ESP_OK) {
-    nvs_set_str(handle, "ssid", ssid);
-    nvs_set_str(handle, "password", pass);
-    nvs_commit(handle);
-    nvs_close(handle);
+  // Só testa a conexão; o NVS é gravado quando o STA obtiver IP (ver PROVISIONAMENTO)
+  esp_err_t err = prov_begin(ssid, pass);
+  if (err == ESP_ERR_INVALID_STATE) {
+    httpd_resp_set_status(req, "409 Conflict");
+    httpd_resp_send(req, "Conexao em andamento, aguarde", HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+  }
+  if (err != ESP_OK) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Falha ao configurar o WiFi");
+    return ESP_OK;
+  }
+
+  httpd_resp_set_status(req, "202 Accepted");
+  httpd_resp_sendstr(req, "Testando conexao...");
+  return ESP_OK;
+}
+
+esp_err_t wifi_status_get_handler(httpd_req_t *req)
+{
+  char buf[192];
+  prov_status_json(buf, sizeof(buf));
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  httpd_resp_sendstr(req, buf);
+  return ESP_OK;
+}
+
+typedef struct {
+  httpd_req_t *req;
+  bool binary;
+  size_t len;
+  uint32_t records;
+  char buf[1024];
+} history_stream_t;
+
+static esp_err_t history_flush(history_stream_t *stream)
+{
+  esp_err_t err = ESP_OK;
+  if (stream->len > 0) {
+    err = httpd_resp_send_chunk(stream->req, stream->buf, stream->len);
+    stream->len = 0;
+  }
+  return err;
+}
+
+// Recebe blocos direto da flash e devolve em chunks HTTP, sem montar o segmento inteiro em RAM
+static esp_err_t history_stream_cb(const flash_log_record_t *records, size_t count, void *ctx)
+{
+  history_stream_t *stream = ctx;
+
+  for (size_t i = 0; i < count; i++) {
+    if (stream->binary) {
+      if (stream->len + sizeof(records[i]) > sizeof(stream->buf) && history_flush(stream) != ESP_OK) {
+        return ESP_FAIL;
+      }
+      memcpy(stream->buf + stream->len, &records[i], sizeof(records[i]));
+      stream->len += sizeof(records[i]);
+    } else {
+      if (stream->len + 48 > sizeof(stream->buf) && history_flush(stream) != ESP_OK) {
+        return ESP_FAIL;
+      }
+      stream->len += snprintf(stream->buf + stream->len, sizeof(stream->buf) - stream->len,
+                              "%" PRIu32 ",%.1f,%.1f\n", records[i].timestamp,
+                              records[i].temperatura / 10.0f, records[i].umidade / 10.0f);
+    }
+    stream->records++;
+  }
+  return ESP_OK;
+}
+
+// GET /api/history?from=<epoch>&to=<epoch>&format=csv|bin
+esp_err_t history_get_handler(httpd_req_t *req)
+{
+  char query[96] = {0};
+  char value[16];
+  uint32_t from = 0;
+  uint32_t to = UINT32_MAX;
+
+  history_stream_t *stream = calloc(1, sizeof(history_stream_t));
+  if (stream == NULL) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sem memória");
+    return ESP_FAIL;
+  }
+  stream->req = req;
+
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+    if (httpd_query_key_value(query, "from", value, sizeof(value)) == ESP_OK) {
+      from = strtoul(value, NULL, 10);
+    }
+    if (httpd_query_key_value(query, "to", value, sizeof(value)) == ESP_OK) {
+      to = strtoul(value, NULL, 10);
+    }
+    if (httpd_query_key_value(query, "format", value, sizeof(value)) == ESP_OK) {
+      stream->binary = (strcmp(value, "bin") == 0);
+    }
+  }
+
+  if (stream->binary) {
+    httpd_resp_set_type(req, "application/octet-stream");
+  } else {
+    httpd_resp_set_type(req, "text/csv");
+    stream->len = snprintf(stream->buf, sizeof(stream->buf), "timestamp,temperatura,umidade\n");
+  }
+
+  int64_t start_us = esp_timer_get_time();
+  esp_err_t err = flash_log_query(from, to, history_stream_cb, stream);
+  if (err == ESP_OK) {
+    err = history_flush(stream);
+  }
+  httpd_resp_send_chunk(req, NULL, 0);
+
+  ESP_LOGI(TAG_HIST, "Consulta [%" PRIu32 ", %" PRIu32 "]: %" PRIu32 " registros em %lld us",
+           from, to, stream->records, esp_timer_get_time() - start_us);
+  free(stream);
+  return err;
+}
+
+esp_err_t publish_config_save(void);
+
+static void config_get(app_config_t *cfg)
+{
+  portENTER_CRITICAL(&s_cfg_lock);
+  *cfg = s_cfg;
+  portEXIT_CRITICAL(&s_cfg_lock);
+}
+
+// GET /api/config
+esp_err_t config_get_handler(httpd_req_t *req)
+{
+  char buf[384];
+  app_config_t cfg;
+  config_get(&cfg);
+  app_config_format_json(&cfg, buf, sizeof(buf));
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_sendstr(req, buf);
+  return ESP_OK;
+}
+
+static int config_format_json(char *buf, size_t len)
+{
+  app_config_t cfg;
+  config_get(&cfg);
+  return app_config_format_json(&cfg, buf, len);
+}
+
+// <mac>/nack só interessa no modo seq; em qos1 o broker não deve mandar pedidos de reenvio
+static void nack_subscription_update(esp_mqtt_client_handle_t client)
+{
+  if (s_cfg.delivery == DELIVERY_SEQ) {
+    esp_mqtt_client_subscribe(client, topic_nack, 0);
+  } else {
+    esp_mqtt_client_unsubscribe(client, topic_nack);
+  }
+}
+
+// Corpo de POST /api/config (também usado pela console)
+static esp_err_t config_apply(const char *body, const char **error)
+{
+  // Monta a configuração nova numa cópia: o agendador nunca vê uma s_cfg pela metade
+  app_config_t cfg;
+  config_get(&cfg);
+  uint8_t delivery = cfg.delivery;
+  esp_err_t err = app_config_parse_form(&cfg, body, sensor_min_interval_ms(), error);
+  if (err != ESP_OK) return err;
+  portENTER_CRITICAL(&s_cfg_lock);
+  s_cfg = cfg;
+  portEXIT_CRITICAL(&s_cfg_lock);
+  if (cfg.delivery != delivery && (xEventGroupGetBits(s_wifi_event_group) & MQTT_CONNECTED_BIT)) {
+    nack_subscription_update(global_mqtt_client);
+  }
+  portENTER_CRITICAL(&s_alarm_lock);
+  for (uint8_t metric = 0; metric < APP_METRICS; metric++) {
+    alarm_configure(&s_alarms[metric], &cfg.alarm[metric]);
+  }
+  portEXIT_CRITICAL(&s_alarm_lock);
+  // Já vale em RAM; sem NVS só não sobrevive ao reboot
+  if (publish_config_save() != ESP_OK) {
+    ESP_LOGW(TAG_HTTP, "Configuração aplicada mas não gravada no NVS");
+  }
+  return ESP_OK;
+}
+
+// POST /api/config (form-urlencoded): mode=raw|agg&window=<segundos>&interval_min=<ms>&interval_max=<ms>&mqtt=3|5
+//                                    &delivery=qos1|seq&low_power=0|1&sleep=<segundos>&pool_slots=<n>&stamps=0|1
+//                                    &filter_n=1..9&filter_median=0|1&filter_k=0..10&filter_ema=0..6
+//                                    &t_max|t_min|u_max|u_min=<décimos>|off&t_rate|u_rate=<décimos/min>|off
+// A versão do MQTT, o modo de baixo consumo e o tamanho do pool só valem a partir do próximo boot
+esp_err_t config_post_handler(httpd_req_t *req)
+{
+  char buf[512];
+  const char *error;
+
+  esp_err_t err = recv_body(req, buf, sizeof(buf));
+  if (err != ESP_OK) {
+    return err == ESP_ERR_INVALID_SIZE ? ESP_OK : ESP_FAIL;
+  }
+
+  if (config_apply(buf, &error) != ESP_OK) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, error);
+    return ESP_OK;
+  }
+  return config_get_handler(req);
+}
+
+// JSON de GET /api/stats (também usado pela console)
+static int stats_format_json(char *buf, size_t len)
+{
+  publisher_stats_t pub;
+  flash_log_stats_t hist;
+  tls_stats_t tls;
+  msg_pool_stats_t pool;
+  sensor_stats_t sensor;
+
+  publisher_get_stats(&pub);
+  flash_log_get_stats(&hist);
+  tls_profile_get_stats(&tls);
+
+  // Alarmes: escritos pela task de saída, pela do MQTT (PUBACK) e pelo agendador
+  portENTER_CRITICAL(&s_alarm_lock);
+  uint8_t alarm_active[APP_METRICS] = { [METRIC_UMIDADE] = s_alarms[METRIC_UMIDADE].active,
+                                        [METRIC_TEMPERATURA] = s_alarms[METRIC_TEMPERATURA].active };
+  uint32_t alarm_sent = s_alarm_sent, alarm_acked = s_alarm_acked, alarm_over_budget = s_alarm_over_budget;
+  uint32_t alarm_min_ms = s_alarm_acked ? s_alarm_latency_min_ms : 0;
+  uint32_t alarm_avg_ms = s_alarm_acked ? (uint32_t)(s_alarm_latency_sum_ms / s_alarm_acked) : 0;
+  uint32_t alarm_max_ms = s_alarm_latency_max_ms;
+  portEXIT_CRITICAL(&s_alarm_lock);
+  msg_pool_get_stats(&pool);
+  sensor_get_stats(&sensor);
+  char health[SENSOR_HEALTH_JSON_MAX_LEN];
+  sensor_health_format(&s_sensor_health, health, sizeof(health));
+
+  return snprintf(buf, len,
+           "{\"mqtt\":{\"protocol\":%d,\"aliases\":%s,\"msgs\":%" PRIu32 ",\"aliased\":%" PRIu32 ",\"bytes\":%" PRIu32
+           ",\"bytes_per_msg\":%" PRIu32 ",\"failed\":%" PRIu32 ",\"deferred\":%" PRIu32 ",\"inflight\":%" PRIu32
+           ",\"acked\":%" PRIu32 ",\"latency_us\":[%" PRIu32 ",%" PRIu32 ",%" PRIu32 "]},"
+           "\"history\":{\"records\":%" PRIu32 ",\"segments_used\":%" PRIu32 ",\"oldest\":%" PRIu32
+           ",\"newest\":%" PRIu32 ",\"max_erase\":%" PRIu32 ",\"crc_errors\":%" PRIu32 "},"
+           "\"conn\":{\"state\":\"%s\",\"transitions\":%" PRIu32 ",\"sta_attempts\":%" PRIu32
+           ",\"mqtt_attempts\":%" PRIu32 ",\"ap_fallbacks\":%" PRIu32 "},"
+           "\"tls\":{\"profile\":\"%s\",\"handshakes\":%" PRIu32 ",\"handshake_ms\":[%" PRIu32 ",%" PRIu32
+           ",%" PRIu32 "],\"heap_peak\":%" PRIu32 ",\"heap_session\":%" PRIu32 "},"
+           "\"alarm\":{\"active\":{\"temperatura\":%u,\"umidade\":%u},\"sent\":%" PRIu32 ",\"acked\":%" PRIu32
+           ",\"latency_ms\":[%" PRIu32 ",%" PRIu32 ",%" PRIu32 "],\"budget_ms\":%d,\"over_budget\":%" PRIu32 "},"
+           "\"pool\":{\"slots\":%" PRIu32 ",\"used\":%" PRIu32 ",\"high_water\":%" PRIu32 ",\"items\":%" PRIu32
+           ",\"bytes\":%" PRIu32 ",\"rejected\":%" PRIu32 "},"
+           "\"heap\":{\"free\":%u,\"min_free\":%u,\"largest_block\":%u},"
+           "\"sensor\":{\"backend\":\"%s\",\"reads\":%" PRIu32 ",\"failures\":%" PRIu32
+           ",\"rejected\":{\"temperatura\":%" PRIu32 ",\"umidade\":%" PRIu32 "},\"health\":%s},"
+           "\"perf\":{\"first_publish_ms\":%" PRIu32 ",\"reconnects\":%" PRIu32 ",\"reconnect_ms\":[%" PRIu32
+           ",%" PRIu32 "],\"sample_us\":[%" PRIu32 ",%" PRIu32 "]},"
+           "\"sntp\":{\"syncs\":%" PRIu32 ",\"age_s\":%" PRId32 ",\"step_ms\":%" PRId32 "},"
+           "\"log_dropped\":%" PRIu32 "}",
+           pub.protocol == MQTT_PROTOCOL_V_5 ? 5 : 3, pub.aliases ? "true" : "false", pub.msgs, pub.aliased,
+           pub.bytes, pub.msgs ? pub.bytes / pub.msgs : 0, pub.failed, pub.deferred, pub.inflight,
+           pub.acked, pub.latency_min_us, pub.latency_avg_us, pub.latency_max_us,
+           hist.records, hist.segments_used, hist.oldest_ts, hist.newest_ts, hist.max_erase_count, hist.crc_errors,
+           conn_state_name(s_conn.state), s_conn.transitions, s_conn.sta_attempts, s_conn.mqtt_attempts,
+           s_conn.entered[CONN_AP_FALLBACK],
+           tls.profile, tls.handshakes, tls.handshake_min_ms, tls.handshake_last_ms, tls.handshake_max_ms,
+           tls.heap_peak, tls.heap_session,
+           alarm_active[METRIC_TEMPERATURA], alarm_active[METRIC_UMIDADE], alarm_sent, alarm_acked,
+           alarm_min_ms, alarm_avg_ms, alarm_max_ms, ALARM_LATENCY_BUDGET_MS, alarm_over_budget,
+           pool.slots, pool.used, pool.high_water, pool.items, pool.bytes, pool.rejected,
+           heap_caps_get_free_size(MALLOC_CAP_8BIT), heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+           heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+           sensor.backend, sensor.reads, sensor.failures,
+           s_filters[METRIC_TEMPERATURA].rejected, s_filters[METRIC_UMIDADE].rejected, health,
+           pub.first_publish_ms, s_reconnects, s_reconnect_last_ms, s_reconnect_max_ms,
+           s_samples ? (uint32_t)(s_sample_sum_us / s_samples) : 0, s_sample_max_us,
+           s_sntp_syncs, s_sntp_syncs ? (int32_t)((esp_timer_get_time() - s_sntp_sync_us) / 1000000) : -1,
+           s_sntp_step_ms,
+           log_sink_get_dropped());
+}
+
+// GET /api/stats: contadores de publicação, histórico e log
+esp_err_t stats_get_handler(httpd_req_t *req)
+{
+  // Grande demais para a pilha de 4 KB do httpd; mesmo tamanho do comando stats da console
+  char *buf = malloc(DIAG_STATS_JSON_MAX_LEN);
+  if (buf == NULL) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sem memória");
+    return ESP_FAIL;
+  }
+
+  stats_format_json(buf, DIAG_STATS_JSON_MAX_LEN);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_sendstr(req, buf);
+  free(buf);
+  return ESP_OK;
+}
+
+// GET /api/tasks: prioridade, core, pilha livre e fatia de CPU de cada task desde o boot
+esp_err_t tasks_get_handler(httpd_req_t *req)
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+  UBaseType_t count = uxTaskGetNumberOfTasks() + 4;
+  TaskStatus_t *tasks = malloc(count * sizeof(TaskStatus_t));
+  if (tasks == NULL) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sem memória");
+    return ESP_FAIL;
+  }
+
+  uint32_t total_runtime;
+  count = uxTaskGetSystemState(tasks, count, &total_runtime);
+  // Contadores somam os dois cores
+  uint64_t percent = (uint64_t)total_runtime * portNUM_PROCESSORS / 100;
+
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_sendstr_chunk(req, "[");
+  for (UBaseType_t i = 0; i < count; i++) {
+    char line[160];
+    int core = (tasks[i].xCoreID == tskNO_AFFINITY) ? -1 : (int)tasks[i].xCoreID;
+    snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"prio\":%u,\"core\":%d,\"stack_free\":%" PRIu32 ",\"cpu\":%" PRIu32 "}",
+             i ? "," : "", tasks[i].pcTaskName, (unsigned)tasks[i].uxCurrentPriority, core,
+             (uint32_t)tasks[i].usStackHighWaterMark,
+             percent ? (uint32_t)(tasks[i].ulRunTimeCounter / percent) : 0);
+    httpd_resp_sendstr_chunk(req, line);
+  }
+  httpd_resp_sendstr_chunk(req, "]");
+  httpd_resp_sendstr_chunk(req, NULL);
+  free(tasks);
+  return ESP_OK;
+#else
+  httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Estatísticas de runtime desativadas");
+  return ESP_OK;
+#endif
+}
+
+// GET /api/jobs: execuções, atraso de disparo e duração de cada trabalho do agendador
+esp_err_t jobs_get_handler(httpd_req_t *req)
+{
+  sched_job_stats_t jobs[SCHED_MAX_JOBS];
+  size_t count = sched_get_stats(jobs, SCHED_MAX_JOBS);
+  uint32_t uptime_s = esp_timer_get_time() / 1000000;
+
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_sendstr_chunk(req, "[");
+  for (size_t i = 0; i < count; i++) {
+    char line[224];
+    snprintf(line, sizeof(line),
+             "%s{\"name\":\"%s\",\"period_ms\":%" PRIu32 ",\"runs\":%" PRIu32 ",\"per_s\":%.2f,\"coalesced\":%" PRIu32
+             ",\"latency_us\":[%" PRIu32 ",%" PRIu32 "],\"run_us\":[%" PRIu32 ",%" PRIu32 "]}",
+             i ? "," : "", jobs[i].name, jobs[i].period_ms, jobs[i].runs,
+             uptime_s ? (float)jobs[i].runs / uptime_s : 0.0f, jobs[i].coalesced,
+             jobs[i].latency_avg_us, jobs[i].latency_max_us, jobs[i].run_avg_us, jobs[i].run_max_us);
+    httpd_resp_sendstr_chunk(req, line);
+  }
+  // A task de saída entra na lista com os campos que fazem sentido para uma fila
+  worker_stats_t out;
+  worker_get_stats(&out);
+  char line[224];
+  snprintf(line, sizeof(line),
+           "%s{\"name\":\"saida\",\"runs\":%" PRIu32 ",\"per_s\":%.2f,\"dropped\":%" PRIu32 ",\"queue_max\":%" PRIu32
+           ",\"latency_us\":[%" PRIu32 ",%" PRIu32 "],\"run_us\":[%" PRIu32 ",%" PRIu32 "]}",
+           count ? "," : "", out.runs, uptime_s ? (float)out.runs / uptime_s : 0.0f, out.dropped, out.queue_max,
+           out.latency_avg_us, out.latency_max_us, out.run_avg_us, out.run_max_us);
+  httpd_resp_sendstr_chunk(req, line);
+  httpd_resp_sendstr_chunk(req, "]");
+  httpd_resp_sendstr_chunk(req, NULL);
+  return ESP_OK;
+}
+
+// GET /api/logs: últimas linhas guardadas pelo destino HTTP do log
+esp_err_t logs_get_handler(httpd_req_t *req)
+{
+  char *buf = malloc(LOG_SINK_TAIL_SIZE + 1);
+  if (buf == NULL) {
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sem memória");
+    return ESP_FAIL;
+  }
+
+  size_t len = log_sink_read_tail(buf, LOG_SINK_TAIL_SIZE + 1);
+  char dropped[16];
+  snprintf(dropped, sizeof(dropped), "%" PRIu32, log_sink_get_dropped());
+
+  httpd_resp_set_type(req, "text/plain");
+  httpd_resp_set_hdr(req, "X-Log-Dropped", dropped);
+  httpd_resp_send(req, buf, len);
+  free(buf);
+  return ESP_OK;
+}
+
+// POST /api/log (form-urlencoded): tag=<tag|*>&level=N|E|W|I|D|V e/ou sinks=<máscara uart=1,http=2,mqtt=4>
+esp_err_t log_post_handler(httpd_req_t *req)
+{
+  static const char levels[] = "NEWIDV";
+  char buf[128];
+  char tag[32];
+  char value[8];
+
+  esp_err_t err = recv_body(req, buf, sizeof(buf));
+  if (err != ESP_OK) {
+    return err == ESP_ERR_INVALID_SIZE ? ESP_OK : ESP_FAIL;
+  }
+
+  if (httpd_query_key_value(buf, "level", value, sizeof(value)) == ESP_OK) {
+    const char *level = strchr(levels, value[0]);
+    if (value[0] == '\0' || level == NULL) {
+      httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "level inválido");
+      return ESP_OK;
+    }
+    if (httpd_query_key_value(buf, "tag", tag, sizeof(tag)) != ESP_OK) {
+      strcpy(tag, "*");
+    }
+    esp_log_level_set(tag, (esp_log_level_t)(level - levels));
+    ESP_LOGI(TAG_HTTP, "Nível de log de '%s' alterado para %c", tag, value[0]);
   }
 
-  httpd_resp_sendstr(req, "OK, WiFi salvo. Reiniciando...");
+  if (httpd_query_key_value(buf, "sinks", value, sizeof(value)) == ESP_OK) {
+    log_sink_set_sinks(strtoul(value, NULL, 10) & (LOG_SINK_UART | LOG_SINK_HTTP | LOG_SINK_MQTT));
+  }
 
-  vTaskDelay(pdMS_TO_TICKS(1000));
-  esp_restart();
+  httpd_resp_sendstr(req, "OK");
   return ESP_OK;
 }
 
@@ -538,14 +1127,27 @@ esp_err_t wifi_post_handler(httpd_req_t *req)
 // INICIA SERVIDOR WEB
 // -----------------------------------------------------------------------------------------------------------
 
-httpd_handle_t start_webserver(void)
+static httpd_handle_t httpd_get_server(void)
 {
+  if (s_httpd != NULL) return s_httpd;
+
   httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-  httpd_handle_t server = NULL;
+  config.max_uri_handlers = 16;
+  config.core_id = CORE_REDE;
 
   ESP_LOGI(TAG_HTTP, "Iniciando Webserver");
 
-  if (httpd_start(&server, &config) == ESP_OK) {
+  if (httpd_start(&s_httpd, &config) != ESP_OK) {
+    s_httpd = NULL;
+  }
+  return s_httpd;
+}
+
+httpd_handle_t start_webserver(void)
+{
+  httpd_handle_t server = httpd_get_server();
+
+  if (server != NULL) {
 
     httpd_uri_t wifi_get = {
       .uri = "/",
@@ -561,12 +1163,85 @@ httpd_handle_t start_webserver(void)
     };
     httpd_register_uri_handler(server, &wifi_post);
 
+    httpd_uri_t wifi_status = {
+      .uri = "/wifi/status",
+      .method = HTTP_GET,
+      .handler = wifi_status_get_handler
+    };
+    httpd_register_uri_handler(server, &wifi_status);
+
     return server;
   }
 
   return NULL;
 }
 
+// API disponível na rede local quando em modo STA
+httpd_handle_t start_api_server(void)
+{
+  httpd_handle_t server = httpd_get_server();
+
+  if (server != NULL) {
+    httpd_uri_t history_get = {
+      .uri = "/api/history",
+      .method = HTTP_GET,
+      .handler = history_get_handler
+    };
+    httpd_register_uri_handler(server, &history_get);
+
+    httpd_uri_t config_get = {
+      .uri = "/api/config",
+      .method = HTTP_GET,
+      .handler = config_get_handler
+    };
+    httpd_register_uri_handler(server, &config_get);
+
+    httpd_uri_t config_post = {
+      .uri = "/api/config",
+      .method = HTTP_POST,
+      .handler = config_post_handler
+    };
+    httpd_register_uri_handler(server, &config_post);
+
+    httpd_uri_t stats_get = {
+      .uri = "/api/stats",
+      .method = HTTP_GET,
+      .handler = stats_get_handler
+    };
+    httpd_register_uri_handler(server, &stats_get);
+
+    httpd_uri_t tasks_get = {
+      .uri = "/api/tasks",
+      .method = HTTP_GET,
+      .handler = tasks_get_handler
+    };
+    httpd_register_uri_handler(server, &tasks_get);
+
+    httpd_uri_t jobs_get = {
+      .uri = "/api/jobs",
+      .method = HTTP_GET,
+      .handler = jobs_get_handler
+    };
+    httpd_register_uri_handler(server, &jobs_get);
+
+    httpd_uri_t logs_get = {
+      .uri = "/api/logs",
+      .method = HTTP_GET,
+      .handler = logs_get_handler
+    };
+    httpd_register_uri_handler(server, &logs_get);
+
+    httpd_uri_t log_post = {
+      .uri = "/api/log",
+      .method = HTTP_POST,
+      .handler = log_post_handler
+    };
+    httpd_register_uri_handler(server, &log_post);
+  }
+
+  return server;
+}
+
 
 // -----------------------------------------------------------------------------------------------------------
 // CONFIGURAÇÕES NO NVS
@@ -598,147 +1273,928 @@ esp_err_t wifi_read_sta_config(char *ssid, char *password)
   return ESP_OK;
 }
 
-// -----------------------------------------------------------------------------------------------------------
-// TASKS
-// -----------------------------------------------------------------------------------------------------------
-
-void wifi_reset_task(void *arg)
+// Modo de publicação é escolhido por dispositivo e sobrevive a reinícios
+esp_err_t publish_config_load(void)
 {
-  time_t hold_time_ms = 3;
-  time_t hold_start_button = 0;
+  nvs_handle my_handle;
+  esp_err_t err = nvs_open(APP_CONFIG_NVS_NAMESPACE, NVS_READONLY, &my_handle);
+  if (err != ESP_OK) return err;
 
-  while(1) {
-    while(!gpio_get_level(BOTAO_RESET_GPIO)) {
-      if(hold_start_button == 0)
-        hold_start_button = time(NULL);
-      if(difftime(time(NULL), hold_start_button) >= hold_time_ms) {
-        nvs_flash_erase();
-        nvs_flash_init();
-        esp_restart();
-      }
-    }
-    
-    vTaskDelay(pdMS_TO_TICKS(10));
-  }
+  app_config_load(&s_cfg, my_handle, sensor_min_interval_ms());
+  nvs_close(my_handle);
+  return ESP_OK;
 }
 
-void ap_blink_task(void *arg)
+esp_err_t publish_config_save(void)
 {
-  while (1) {
-    blink_led(LED_CONFIG_GPIO);
-    vTaskDelay(pdMS_TO_TICKS(300));
-  }
+  nvs_handle my_handle;
+  esp_err_t err = nvs_open(APP_CONFIG_NVS_NAMESPACE, NVS_READWRITE, &my_handle);
+  if (err != ESP_OK) return err;
+
+  err = app_config_save(&s_cfg, my_handle);
+  nvs_close(my_handle);
+  return err;
 }
 
-void dht_task(void *pvParameters)
+// Contador de boots: identifica a época das sequências publicadas em QoS 0
+uint32_t boot_epoch_next(void)
 {
-  float temperatura;
-  float umidade;
-
-  float last_temperatura = -1;
-  float last_umidade = -1;
+  nvs_handle my_handle;
+  uint32_t epoch = 0;
 
-  while(1) {
-    if (dht_read_float_data(SENSOR_TYPE, SENSOR_GPIO, &umidade, &temperatura) == ESP_OK) {
-      if(umidade != last_umidade && global_mqtt_client != NULL) {
-        last_umidade = umidade;
-        char msg[16];
-        sprintf(msg, "%.1f", umidade);
-        esp_mqtt_client_publish(global_mqtt_client, topic_umidade, msg, 0, 1, 0);
-        blink_led(LED_UMIDADE_GPIO);
-      }
-      if(temperatura != last_temperatura && global_mqtt_client != NULL) {
-        last_temperatura = temperatura;
-        char msg[16];
-        sprintf(msg, "%.1f", temperatura);
-        esp_mqtt_client_publish(global_mqtt_client, topic_temperatura, msg, 0, 1, 0);
-        blink_led(LED_TEMPERATURA_GPIO);
-      }
-      ESP_LOGI(TAG_MQTT, "Umidade: %.1f%%, Temperatura: %.1fºC", umidade, temperatura);
-    } else {
-      ESP_LOGE(TAG_MQTT, "Falha ao ler os dados do DHT22");
-      blink_led(LED_ERRO_GPIO);
-    }
+  if (nvs_open("storage", NVS_READWRITE, &my_handle) != ESP_OK) return 0;
 
-    vTaskDelay(pdMS_TO_TICKS(3000));
-  }
+  nvs_get_u32(my_handle, "boot_epoch", &epoch);
+  epoch++;
+  nvs_set_u32(my_handle, "boot_epoch", epoch);
+  nvs_commit(my_handle);
+  nvs_close(my_handle);
+  return epoch;
 }
 
-void sta_monitor_task(void *arg)
+// -----------------------------------------------------------------------------------------------------------
+// TRABALHOS DO AGENDADOR
+// -----------------------------------------------------------------------------------------------------------
+
+// Botão de reset: segurar por BOTAO_HOLD_MS apaga as credenciais; soltar antes recomeça a contagem
+static void reset_button_job(void *arg)
 {
-  EventBits_t bits = xEventGroupWaitBits(
-    s_wifi_event_group,
-    WIFI_CONNECTED_BIT,
-    pdFALSE,
-    pdFALSE,
-    pdMS_TO_TICKS(10000)  // timeout 10 segundos
-  );
+  static int64_t pressed_since_us = 0;
 
-  if (!(bits & WIFI_CONNECTED_BIT)) {
-    ESP_LOGW(TAG_STA, "Timeout de conexão WiFi. Ativando fallback para AP...");
-    
-    // Desliga STA
-    esp_wifi_stop();
-    esp_wifi_set_mode(WIFI_MODE_NULL);
+  if (gpio_get_level(BOTAO_RESET_GPIO)) {
+    pressed_since_us = 0;
+    return;
+  }
 
-    // Inicia AP
-    esp_wifi_set_mode(WIFI_MODE_AP);
-    wifi_init_softap();
-    esp_wifi_start();
-    prepare_wifi_page(device_mac_str);
-    start_webserver();
-    xTaskCreate(ap_blink_task, "ap_blink_task", 2048, NULL, 5, NULL);
+  int64_t now_us = esp_timer_get_time();
+  if (pressed_since_us == 0) {
+    pressed_since_us = now_us;
+  } else if (now_us - pressed_since_us >= BOTAO_HOLD_MS * 1000LL) {
+    nvs_flash_erase();
+    nvs_flash_init();
+    esp_restart();
   }
+}
+
+static void ap_blink_job(void *arg)
+{
+  static uint32_t level = 0;
 
-  vTaskDelete(NULL);
+  level = !level;
+  gpio_set_level(LED_CONFIG_GPIO, level);
 }
 
 // -----------------------------------------------------------------------------------------------------------
-// MQTT EVENTS HANDLER
+// SAÍDA
+//
+// O agendador não grava na flash nem publica: posta uma cópia para a task de saída (worker.h) e segue
+// para a próxima leitura. Os caminhos fora do agendador (MQTT, baixo consumo) continuam publicando direto.
 // -----------------------------------------------------------------------------------------------------------
 
-static void log_error_if_nonzero(const char *message, int error_code)
+typedef struct {
+  const char *topic;
+  uint16_t len;
+  uint8_t qos;
+  uint8_t retain;
+  char msg[SENSOR_HEALTH_JSON_MAX_LEN];   // a maior mensagem que passa por aqui
+} out_message_t;
+
+_Static_assert(sizeof(out_message_t) <= WORKER_DATA_MAX, "out_message_t não cabe num item da task de saída");
+
+static void message_send(const void *data)
 {
-    if (error_code != 0) {
-        ESP_LOGE(TAG_MQTT, "Last error %s: 0x%x", message, error_code);
-    }
+  const out_message_t *out = data;
+  publisher_publish(out->topic, out->msg, out->len, out->qos, out->retain);
 }
 
-static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+static void out_message_fill(out_message_t *out, const char *topic, const char *msg, int len, int qos, int retain)
 {
-  ESP_LOGD(TAG_MQTT, "Event dispatched from event loop base=%s, event_id=%" PRIi32 "", base, event_id);
-  esp_mqtt_event_handle_t event = event_data;
-  esp_mqtt_client_handle_t client = event->client;
-  int msg_id;
-  switch ((esp_mqtt_event_id_t)event_id) {
-  case MQTT_EVENT_CONNECTED:
-    ESP_LOGI(TAG_MQTT, "MQTT_EVENT_CONNECTED");
-    break;
-  case MQTT_EVENT_DISCONNECTED:
-    ESP_LOGI(TAG_MQTT, "MQTT_EVENT_DISCONNECTED");
-    break;
+  if (len == 0) len = strlen(msg);
+  if (len > (int)sizeof(out->msg)) len = sizeof(out->msg);
+  out->topic = topic;
+  out->len = len;
+  out->qos = qos;
+  out->retain = retain;
+  memcpy(out->msg, msg, len);
+}
 
-  case MQTT_EVENT_SUBSCRIBED:
-    break;
-  case MQTT_EVENT_UNSUBSCRIBED:
-    break;
-  case MQTT_EVENT_PUBLISHED:
-    break;
-  case MQTT_EVENT_DATA:
-    break;
+// Como publisher_publish(), sem o msg_id: a publicação acontece depois, na task de saída
+static void out_publish(const char *topic, const char *msg, int len, int qos, int retain)
+{
+  out_message_t out;
+  out_message_fill(&out, topic, msg, len, qos, retain);
+  worker_post(message_send, &out, offsetof(out_message_t, msg) + out.len);
+}
 
-  case MQTT_EVENT_ERROR:
-    ESP_LOGI(TAG_MQTT, "MQTT_EVENT_ERROR");
-    if (event->error_handle->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT) {
-      log_error_if_nonzero("reported from esp-tls", event->error_handle->esp_tls_last_esp_err);
-      log_error_if_nonzero("reported from tls stack", event->error_handle->esp_tls_stack_err);
-      log_error_if_nonzero("captured as transport's socket errno",  event->error_handle->esp_transport_sock_errno);
-      ESP_LOGI(TAG_MQTT, "Last errno string (%s)", strerror(event->error_handle->esp_transport_sock_errno));
-    }
-    break;
-  default:
-    ESP_LOGI(TAG_MQTT, "Other event id:%d", event->event_id);
-    break;
+static void history_write(const void *data)
+{
+  const flash_log_record_t *record = data;
+  esp_err_t err = flash_log_append(record->timestamp, record->temperatura, record->umidade);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+    ESP_LOGE(TAG_HIST, "Falha ao gravar histórico: %s", esp_err_to_name(err));
+  }
+}
+
+// Média das leituras de cada período de HISTORY_PERIOD_S, gravada quando o período seguinte começa
+// (com o timestamp da última leitura do período). Leituras a cada 2-3 s encheriam a partição em dias.
+// Só a média é calculada aqui; a gravação, que pode apagar um segmento, vai para a task de saída.
+void history_append(int16_t temperatura, int16_t umidade)
+{
+  static bool warned = false;
+  static time_t period = 0;
+  static time_t last = 0;
+  static int32_t sum_temperatura = 0;
+  static int32_t sum_umidade = 0;
+  static uint32_t count = 0;
+  time_t now = time(NULL);
+
+  // Sem hora válida o índice por timestamp não faz sentido; espera o SNTP
+  if (now < HISTORY_MIN_EPOCH) {
+    if (!warned) {
+      ESP_LOGW(TAG_HIST, "Relógio não sincronizado. Histórico aguardando SNTP");
+      warned = true;
+    }
+    return;
+  }
+
+  time_t now_period = now - now % HISTORY_PERIOD_S;
+  if (now_period != period && count > 0) {
+    flash_log_record_t record = {
+      .timestamp = (uint32_t)last,
+      .temperatura = sum_temperatura / (int32_t)count,
+      .umidade = sum_umidade / (int32_t)count,
+    };
+    worker_post(history_write, &record, sizeof(record));
+    count = 0;
+    sum_temperatura = 0;
+    sum_umidade = 0;
+  }
+  period = now_period;
+  last = now;
+  sum_temperatura += temperatura;
+  sum_umidade += umidade;
+  count++;
+}
+
+// Base de tempo da taxa de variação: o relógio de parede continua contando no deep sleep
+static int64_t wall_clock_ms(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+// Com stamps=1, preenche os carimbos do registro que está para ser entregue ao publisher
+static const app_stamps_t *stamps_fill(app_stamps_t *stamps, int64_t acquired_ms)
+{
+  if (!s_cfg.stamps) return NULL;
+
+  stamps->acquired_ms = acquired_ms;
+  stamps->enqueued_ms = wall_clock_ms();
+  stamps->sync_age_s = s_sntp_syncs ? (int32_t)((esp_timer_get_time() - s_sntp_sync_us) / 1000000) : -1;
+  return stamps;
+}
+
+void publish_sample(uint8_t metric, int16_t value, int64_t acquired_ms)
+{
+  app_stamps_t stamps;
+
+  if (s_cfg.delivery == DELIVERY_SEQ) {
+    sample_seq_publish(metric, value, stamps_fill(&stamps, acquired_ms));
+  } else {
+    char msg[APP_TENTHS_MAX_LEN + APP_STAMPS_MAX_LEN];
+    int len = app_format_tenths(value, msg);
+    if (stamps_fill(&stamps, acquired_ms)) len = app_append_stamps(msg, sizeof(msg), len, &stamps);
+    publisher_publish(sample_topics[metric], msg, len, 1, 0);
+  }
+}
+
+typedef struct {
+  int64_t acquired_ms;
+  int16_t value;
+  uint8_t metric;
+} out_sample_t;
+
+static void sample_send(const void *data)
+{
+  const out_sample_t *sample = data;
+  publish_sample(sample->metric, sample->value, sample->acquired_ms);
+}
+
+static void out_sample(uint8_t metric, int16_t value, int64_t acquired_ms)
+{
+  out_sample_t sample = { .acquired_ms = acquired_ms, .value = value, .metric = metric };
+  worker_post(sample_send, &sample, sizeof(sample));
+}
+
+// Um registro por métrica por janela, com contagem de amostras e de falhas de leitura.
+// acquired_ms é a última leitura da janela.
+void publish_aggregates(const welford_t *temperatura, const welford_t *umidade, uint32_t failures, int64_t acquired_ms)
+{
+  char msg[96 + APP_STAMPS_MAX_LEN];
+  app_stamps_t stamps;
+  int len;
+
+  if (global_mqtt_client == NULL) return;
+
+  len = aggregate_format(umidade, failures, msg, sizeof(msg));
+  if (stamps_fill(&stamps, acquired_ms)) len = app_append_stamps(msg, sizeof(msg), len, &stamps);
+  publisher_publish(topic_umidade_agg, msg, len, 1, 0);
+  len = aggregate_format(temperatura, failures, msg, sizeof(msg));
+  if (stamps_fill(&stamps, acquired_ms)) len = app_append_stamps(msg, sizeof(msg), len, &stamps);
+  publisher_publish(topic_temperatura_agg, msg, len, 1, 0);
+  ESP_LOGI(TAG_MQTT, "Agregado publicado: %" PRIu32 " amostras, %" PRIu32 " falhas", temperatura->count, failures);
+}
+
+typedef struct {
+  welford_t temperatura;
+  welford_t umidade;
+  uint32_t failures;
+  int64_t acquired_ms;
+} out_aggregates_t;
+
+static void aggregates_send(const void *data)
+{
+  const out_aggregates_t *agg = data;
+  publish_aggregates(&agg->temperatura, &agg->umidade, agg->failures, agg->acquired_ms);
+}
+
+// Cada mudança de intervalo vai para o log e para o tópico <mac>/amostragem
+void sampling_transition(const adaptive_sampler_t *sampler, adaptive_reason_t reason)
+{
+  const char *motivo = (reason == ADAPTIVE_FAST) ? "rapido" : "estavel";
+
+  ESP_LOGI(TAG_MQTT, "Intervalo de amostragem: %" PRIu32 " ms (%s, taxa=%.1f/min, dp=%.1f)",
+           adaptive_interval_ms(sampler), motivo, sampler->slope / 10.0f, sampler->stddev / 10.0f);
+
+  if (global_mqtt_client != NULL) {
+    char msg[96];
+    snprintf(msg, sizeof(msg), "{\"ms\":%" PRIu32 ",\"motivo\":\"%s\",\"n\":%" PRIu32 "}",
+             adaptive_interval_ms(sampler), motivo, sampler->transitions);
+    out_publish(topic_amostragem, msg, 0, 1, 0);
+  }
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// ALARMES
+// -----------------------------------------------------------------------------------------------------------
+
+typedef struct {
+  int msg_id;
+  int64_t sample_us;
+} alarm_latency_slot_t;
+
+static const char *const metric_names[] = { [METRIC_UMIDADE] = "umidade", [METRIC_TEMPERATURA] = "temperatura" };
+
+// Latência leitura -> PUBACK. Tudo abaixo é protegido por s_alarm_lock: a task de saída (ou a do MQTT,
+// em alarm_publish_unsent) publica e registra o msg_id, a task do MQTT recebe o PUBACK. Como o msg_id só
+// existe depois que esp_mqtt_client_publish retorna, um PUBACK rápido na outra core pode chegar antes do
+// registro; enquanto há publicação de alarme em andamento, os PUBACKs sem dono ficam em s_alarm_early
+static alarm_latency_slot_t s_alarm_latency[ALARM_LATENCY_SLOTS];
+static alarm_latency_slot_t s_alarm_early[ALARM_LATENCY_SLOTS];   // sample_us guarda o instante do PUBACK
+static uint8_t s_alarm_early_next = 0;
+static uint8_t s_alarm_publishing = 0;
+
+void alarm_led_update(void)
+{
+  portENTER_CRITICAL(&s_alarm_lock);
+  uint8_t active = s_alarms[METRIC_UMIDADE].active | s_alarms[METRIC_TEMPERATURA].active;
+  portEXIT_CRITICAL(&s_alarm_lock);
+  gpio_set_level(LED_ERRO_GPIO, active ? 1 : 0);
+}
+
+// Contabiliza uma latência; chamar com s_alarm_lock. Devolve os ms, para o log fora da seção crítica
+static uint32_t alarm_latency_account(int64_t sample_us, int64_t acked_us)
+{
+  uint32_t ms = (uint32_t)((acked_us - sample_us) / 1000);
+  s_alarm_acked++;
+  s_alarm_latency_sum_ms += ms;
+  if (ms < s_alarm_latency_min_ms) s_alarm_latency_min_ms = ms;
+  if (ms > s_alarm_latency_max_ms) s_alarm_latency_max_ms = ms;
+  if (ms > ALARM_LATENCY_BUDGET_MS) s_alarm_over_budget++;
+  return ms;
+}
+
+static void alarm_latency_log(uint32_t ms)
+{
+  if (ms > ALARM_LATENCY_BUDGET_MS) {
+    ESP_LOGW(TAG_MQTT, "Alarme levou %" PRIu32 " ms da leitura ao PUBACK (orçamento %d ms)", ms, ALARM_LATENCY_BUDGET_MS);
+  }
+}
+
+// Direto para o socket em QoS 1: sem agregação, sem deadband e sem a fila do controle de fluxo
+static void alarm_publish(uint8_t metric, const alarm_event_t *event, int64_t sample_us)
+{
+  char msg[192];
+  snprintf(msg, sizeof(msg),
+           "{\"metrica\":\"%s\",\"tipo\":\"%s\",\"ativo\":%s,\"valor\":%.1f,\"medido\":%.1f,\"limite\":%.1f,"
+           "\"ts\":%lld}",
+           metric_names[metric], alarm_kind_name(event->kind), event->active ? "true" : "false",
+           event->value / 10.0f, event->measured / 10.0f, event->limit / 10.0f, (long long)time(NULL));
+
+  portENTER_CRITICAL(&s_alarm_lock);
+  s_alarm_publishing++;
+  portEXIT_CRITICAL(&s_alarm_lock);
+
+  int msg_id = publisher_publish_urgent(topic_alarme, msg, 0);
+
+  uint32_t ms = 0;
+  portENTER_CRITICAL(&s_alarm_lock);
+  if (msg_id > 0 && sample_us > 0) {
+    bool acked = false;
+    for (int i = 0; i < ALARM_LATENCY_SLOTS && !acked; i++) {
+      if (s_alarm_early[i].msg_id != msg_id) continue;
+      ms = alarm_latency_account(sample_us, s_alarm_early[i].sample_us);
+      s_alarm_early[i].msg_id = 0;
+      acked = true;
+    }
+    if (!acked) {
+      s_alarm_latency[s_alarm_sent % ALARM_LATENCY_SLOTS] = (alarm_latency_slot_t){
+        .msg_id = msg_id,
+        .sample_us = sample_us,
+      };
+    }
+  }
+  if (msg_id >= 0) {
+    s_alarm_sent++;
+  }
+  if (--s_alarm_publishing == 0) {
+    memset(s_alarm_early, 0, sizeof(s_alarm_early));
+  }
+  portEXIT_CRITICAL(&s_alarm_lock);
+  alarm_latency_log(ms);
+}
+
+typedef struct {
+  alarm_event_t event;
+  int64_t sample_us;
+  uint8_t metric;
+} out_alarm_t;
+
+static void alarm_send(const void *data)
+{
+  const out_alarm_t *out = data;
+  alarm_publish(out->metric, &out->event, out->sample_us);
+}
+
+// Avaliado a cada leitura; devolve true se algum alarme mudou de estado. Chamado pelo agendador (ou no
+// despertar de baixo consumo, sempre sem cliente): a publicação vai na frente da fila da task de saída.
+bool alarm_check(int16_t temperatura, int16_t umidade, int64_t sample_us)
+{
+  const int16_t values[2] = { [METRIC_UMIDADE] = umidade, [METRIC_TEMPERATURA] = temperatura };
+  int64_t now_ms = wall_clock_ms();
+  bool online = global_mqtt_client != NULL;
+  alarm_event_t events[2][ALARM_KINDS];
+  int n[2];
+
+  portENTER_CRITICAL(&s_alarm_lock);
+  for (uint8_t metric = 0; metric < 2; metric++) {
+    n[metric] = alarm_eval(&s_alarms[metric], now_ms, values[metric], events[metric]);
+    if (!online) {
+      for (int i = 0; i < n[metric]; i++) {
+        s_alarm_unsent[metric] |= 1u << events[metric][i].kind;
+      }
+    }
+  }
+  portEXIT_CRITICAL(&s_alarm_lock);
+
+  bool changed = false;
+  for (uint8_t metric = 0; metric < 2; metric++) {
+    for (int i = 0; i < n[metric]; i++) {
+      const alarm_event_t *event = &events[metric][i];
+      ESP_LOGW(TAG_MQTT, "Alarme %s/%s %s (%.1f, limite %.1f)", metric_names[metric], alarm_kind_name(event->kind),
+               event->active ? "ATIVO" : "normalizado", event->measured / 10.0f, event->limit / 10.0f);
+      if (online) {
+        out_alarm_t out = { .event = *event, .sample_us = sample_us, .metric = metric };
+        worker_post_urgent(alarm_send, &out, sizeof(out));
+      }
+    }
+    changed |= n[metric] > 0;
+  }
+
+  if (changed) {
+    alarm_led_update();
+  }
+  return changed;
+}
+
+// Mudanças que aconteceram sem cliente (deep sleep ou antes do primeiro CONNECT) saem com o estado atual
+void alarm_publish_unsent(void)
+{
+  alarm_event_t events[2][ALARM_KINDS];
+  int n[2] = { 0, 0 };
+
+  portENTER_CRITICAL(&s_alarm_lock);
+  for (uint8_t metric = 0; metric < 2; metric++) {
+    const alarm_t *alarm = &s_alarms[metric];
+    for (int kind = 0; kind < ALARM_KINDS; kind++) {
+      if ((s_alarm_unsent[metric] & (1u << kind)) == 0) continue;
+
+      int32_t limit = kind == ALARM_HIGH ? alarm->cfg.high : kind == ALARM_LOW ? alarm->cfg.low : alarm->cfg.rate_per_min;
+      events[metric][n[metric]++] = (alarm_event_t) {
+        .kind = kind,
+        .active = (alarm->active & (1u << kind)) != 0,
+        .value = alarm->last_value,
+        .measured = alarm->last_value,
+        .limit = limit,
+      };
+    }
+    s_alarm_unsent[metric] = 0;
+  }
+  portEXIT_CRITICAL(&s_alarm_lock);
+
+  for (uint8_t metric = 0; metric < 2; metric++) {
+    for (int i = 0; i < n[metric]; i++) {
+      alarm_publish(metric, &events[metric][i], 0);
+    }
+  }
+}
+
+void alarm_on_published(int msg_id)
+{
+  int64_t now_us = esp_timer_get_time();
+  uint32_t ms = 0;
+  bool found = false;
+
+  portENTER_CRITICAL(&s_alarm_lock);
+  for (int i = 0; i < ALARM_LATENCY_SLOTS && !found; i++) {
+    alarm_latency_slot_t *slot = &s_alarm_latency[i];
+    if (slot->msg_id != msg_id) continue;
+    ms = alarm_latency_account(slot->sample_us, now_us);
+    slot->msg_id = 0;
+    found = true;
+  }
+  if (!found && s_alarm_publishing > 0) {
+    // Pode ser o alarme que ainda não registrou o msg_id; alarm_publish confere ao sair
+    s_alarm_early[s_alarm_early_next++ % ALARM_LATENCY_SLOTS] = (alarm_latency_slot_t){
+      .msg_id = msg_id,
+      .sample_us = now_us,
+    };
+  }
+  portEXIT_CRITICAL(&s_alarm_lock);
+  alarm_latency_log(ms);
+}
+
+// Entrada e saída do degradado publicam na hora; fora isso, um retrato a cada SENSOR_HEALTH_REPORT_MS
+static void sensor_health_publish(sensor_health_state_t before)
+{
+  const sensor_health_t *health = &s_sensor_health;
+  bool changed = (before == SENSOR_HEALTH_DEGRADED) != (health->state == SENSOR_HEALTH_DEGRADED);
+  int64_t now_us = esp_timer_get_time();
+
+  if (changed) {
+    ESP_LOGW(TAG_MQTT, "Sensor %s (%" PRIu32 " falhas seguidas, última: %s)", sensor_health_state_name(health->state),
+             health->consecutive, sensor_fault_name(health->last_fault));
+  }
+  if (!changed && now_us - s_sensor_health_sent_us < SENSOR_HEALTH_REPORT_MS * 1000LL) return;
+  if (global_mqtt_client == NULL) return;
+
+  char msg[SENSOR_HEALTH_JSON_MAX_LEN];
+  sensor_health_format(health, msg, sizeof(msg));
+  out_publish(topic_sensor, msg, 0, 1, 0);
+  s_sensor_health_sent_us = now_us;
+}
+
+// Estado da aquisição entre execuções do trabalho
+typedef struct {
+  app_change_filter_t changed;
+  welford_t agg_temperatura;
+  welford_t agg_umidade;
+  uint32_t agg_failures;
+  int64_t agg_start_us;
+  int64_t agg_last_ms;
+  uint8_t mode;
+  adaptive_sampler_t sampler;
+  adaptive_config_t sampler_cfg;
+  uint32_t phase_seed;
+} acquisition_t;
+
+static acquisition_t s_acq;
+
+static void acquisition_reset(void)
+{
+  memset(&s_acq, 0, sizeof(s_acq));
+  app_change_filter_reset(&s_acq.changed);
+  s_acq.mode = UINT8_MAX;
+  s_acq.sampler_cfg = (adaptive_config_t) ADAPTIVE_CONFIG_DEFAULT();
+  s_acq.sampler_cfg.min_interval_ms = 0;
+  s_acq.phase_seed = app_phase_seed(device_mac_str);
+  for (int m = 0; m < APP_METRICS; m++) {
+    sample_filter_reset(&s_filters[m]);
+  }
+}
+
+// Publicação recusada: a próxima passada do agendador tenta de novo
+static void snapshot_send(const void *data)
+{
+  const out_message_t *out = data;
+  if (publisher_publish(out->topic, out->msg, out->len, out->qos, out->retain) < 0) {
+    s_snapshot_changed = true;
+  }
+}
+
+// Retrato em <mac>/estado (retido, QoS 0: o próximo substitui). Mudança de alarme ou da saúde do sensor
+// publica na hora; leituras novas no máximo a cada SNAPSHOT_MIN_MS, para o retido não dobrar o tráfego
+// das amostras. force republica mesmo sem mudança (conexão nova).
+static void snapshot_publish(bool force)
+{
+  app_snapshot_t *snap = &s_snapshot;
+  const char *health = sensor_health_state_name(s_sensor_health.state);
+  int64_t now_us = esp_timer_get_time();
+  bool urgent = force || snap->health != health;
+
+  snap->health = health;
+  for (int m = 0; m < APP_METRICS; m++) {
+    if (snap->alarm[m] != s_alarms[m].active) {
+      snap->alarm[m] = s_alarms[m].active;
+      urgent = true;
+    }
+  }
+  if (urgent) s_snapshot_changed = true;
+  if (!s_snapshot_changed || (!urgent && now_us - s_snapshot_sent_us < SNAPSHOT_MIN_MS * 1000LL)) return;
+  // Sem leitura ainda: melhor deixar o retrato anterior do que publicar um vazio
+  if (global_mqtt_client == NULL || snap->acquired_ms == 0) return;
+
+  snap->recent_permille = sensor_health_recent_permille(&s_sensor_health);
+  snap->interval_ms = adaptive_interval_ms(&s_acq.sampler);
+  snap->uptime_s = now_us / 1000000;
+  char msg[APP_SNAPSHOT_MAX_LEN];
+  int len = app_snapshot_format(snap, msg, sizeof(msg));
+  out_message_t out;
+  out_message_fill(&out, topic_estado, msg, len, 0, 1);
+  if (!worker_post(snapshot_send, &out, offsetof(out_message_t, msg) + out.len)) return;
+  s_snapshot_changed = false;
+  s_snapshot_sent_us = now_us;
+}
+
+static void snapshot_job(void *arg)
+{
+  snapshot_publish(true);
+}
+
+// Um ciclo de aquisição por execução; o próprio trabalho se reagenda com o intervalo do amostrador
+static void acquisition_job(void *arg)
+{
+  acquisition_t *acq = &s_acq;
+  // Valores em décimos, como devolvidos pelo driver
+  int16_t temperatura;
+  int16_t umidade;
+
+  // O bench da console acabou de ler: espera o intervalo mínimo do sensor em vez de ler cedo demais
+  uint32_t wait_ms = sensor_ready_in_ms();
+  if (wait_ms > 0) {
+    sched_job_start_once(s_acquisition_job, wait_ms);
+    return;
+  }
+
+  // Cópia da configuração: config_apply pode trocá-la no meio do ciclo
+  app_config_t cfg;
+  config_get(&cfg);
+
+  // Limites alterados via /api/config reiniciam o amostrador
+  if (acq->sampler_cfg.min_interval_ms != cfg.interval_min_ms || acq->sampler_cfg.max_interval_ms != cfg.interval_max_ms) {
+    acq->sampler_cfg.min_interval_ms = cfg.interval_min_ms;
+    acq->sampler_cfg.max_interval_ms = cfg.interval_max_ms;
+    adaptive_init(&acq->sampler, &acq->sampler_cfg);
+  }
+
+  // Troca de modo em tempo de execução começa uma janela nova
+  if (acq->mode != cfg.publish_mode) {
+    acq->mode = cfg.publish_mode;
+    welford_reset(&acq->agg_temperatura);
+    welford_reset(&acq->agg_umidade);
+    acq->agg_failures = 0;
+    acq->agg_start_us = esp_timer_get_time();
+  }
+
+  // Em taxas altas (backends sintéticos) o log e os piscas por leitura só gastariam CPU
+  bool slow = adaptive_interval_ms(&acq->sampler) >= SAMPLE_VERBOSE_MIN_INTERVAL_MS;
+
+  int64_t cycle_start_us = esp_timer_get_time();
+  bool read_ok = sensor_read(&temperatura, &umidade) == ESP_OK;
+  if (read_ok) {
+    int64_t acquired_ms = wall_clock_ms();
+    // Picos com checksum válido param aqui: no lugar deles segue a última saída aceita, que não
+    // republica, não dispara alarme e não entra no agregado, no histórico, no retrato nem no amostrador
+    bool umidade_ok = sample_filter_apply(&s_filters[METRIC_UMIDADE], &cfg.filter, &umidade);
+    bool temperatura_ok = sample_filter_apply(&s_filters[METRIC_TEMPERATURA], &cfg.filter, &temperatura);
+    if (!umidade_ok || !temperatura_ok) {
+      ESP_LOGW(TAG_MQTT, "Leitura descartada pelo filtro (%s%s)", umidade_ok ? "" : "umidade ",
+               temperatura_ok ? "" : "temperatura");
+    }
+    alarm_check(temperatura, umidade, esp_timer_get_time());
+    // O registro do histórico e a janela do amostrador levam as duas métricas juntas: só leituras inteiras.
+    // Um valor repetido pelo filtro puxaria o amostrador para "parado"
+    if (umidade_ok && temperatura_ok) {
+      history_append(temperatura, umidade);
+      adaptive_reason_t reason = adaptive_update(&acq->sampler, esp_timer_get_time() / 1000, temperatura, umidade);
+      if (reason != ADAPTIVE_HOLD) {
+        sampling_transition(&acq->sampler, reason);
+      }
+    }
+    if (temperatura_ok || umidade_ok) {
+      if ((temperatura_ok && s_snapshot.value[METRIC_TEMPERATURA] != temperatura) ||
+          (umidade_ok && s_snapshot.value[METRIC_UMIDADE] != umidade) || s_snapshot.acquired_ms == 0) {
+        s_snapshot_changed = true;
+      }
+      if (temperatura_ok) s_snapshot.value[METRIC_TEMPERATURA] = temperatura;
+      if (umidade_ok) s_snapshot.value[METRIC_UMIDADE] = umidade;
+      s_snapshot.acquired_ms = acquired_ms;
+    }
+
+    if (acq->mode == PUBLISH_MODE_AGG) {
+      if (temperatura_ok) welford_add(&acq->agg_temperatura, temperatura);
+      if (umidade_ok) welford_add(&acq->agg_umidade, umidade);
+      acq->agg_last_ms = acquired_ms;
+    }
+    bool raw = acq->mode == PUBLISH_MODE_RAW && global_mqtt_client != NULL;
+    if (raw && app_change_filter_update(&acq->changed, METRIC_UMIDADE, umidade)) {
+      out_sample(METRIC_UMIDADE, umidade, acquired_ms);
+      if (slow) blink_led(LED_UMIDADE_GPIO);
+    }
+    if (raw && app_change_filter_update(&acq->changed, METRIC_TEMPERATURA, temperatura)) {
+      out_sample(METRIC_TEMPERATURA, temperatura, acquired_ms);
+      if (slow) blink_led(LED_TEMPERATURA_GPIO);
+    }
+    if (slow) {
+      ESP_LOGI(TAG_MQTT, "Umidade: %.1f%%, Temperatura: %.1fºC", umidade / 10.0f, temperatura / 10.0f);
+    }
+  } else {
+    ESP_LOGE(TAG_MQTT, "Falha ao ler os dados do DHT22 (%s)", sensor_fault_name(sensor_last_fault()));
+    acq->agg_failures++;
+    alarm_led_update();
+    if (slow) blink_led(LED_ERRO_GPIO);
+  }
+
+  if (acq->mode == PUBLISH_MODE_AGG && esp_timer_get_time() - acq->agg_start_us >= cfg.agg_window_s * 1000000LL) {
+    out_aggregates_t agg = {
+      .temperatura = acq->agg_temperatura,
+      .umidade = acq->agg_umidade,
+      .failures = acq->agg_failures,
+      .acquired_ms = acq->agg_last_ms,
+    };
+    worker_post(aggregates_send, &agg, sizeof(agg));
+    welford_reset(&acq->agg_temperatura);
+    welford_reset(&acq->agg_umidade);
+    acq->agg_failures = 0;
+    acq->agg_start_us = esp_timer_get_time();
+  }
+
+  // Custo de um ciclo de aquisição (leitura + alarmes + publicação), sem a espera
+  uint32_t cycle_us = esp_timer_get_time() - cycle_start_us;
+  s_sample_sum_us += cycle_us;
+  if (cycle_us > s_sample_max_us) s_sample_max_us = cycle_us;
+  s_samples++;
+
+  // Próxima leitura na fase deste dispositivo dentro do intervalo, no relógio de parede: unidades que
+  // religaram juntas não leem nem publicam no mesmo instante. Depois de uma falha quem decide é a saúde
+  // do sensor: repete logo que o sensor aceitar, ou espaça com backoff se ele estiver degradado.
+  uint32_t interval_ms = adaptive_interval_ms(&acq->sampler);
+  sensor_health_state_t before = s_sensor_health.state;
+  uint32_t delay_ms = sensor_health_record(&s_sensor_health, read_ok, sensor_last_fault(), interval_ms,
+                                           sensor_min_interval_ms());
+  sensor_health_publish(before);
+  snapshot_publish(false);
+  if (read_ok) {
+    delay_ms = app_phase_delay_ms(acq->phase_seed, wall_clock_ms(), interval_ms);
+  }
+  sched_job_start_once(s_acquisition_job, delay_ms > 0 ? delay_ms : 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// BAIXO CONSUMO
+// -----------------------------------------------------------------------------------------------------------
+
+// Despertar pelo timer: só o sensor, sem Wi-Fi nem histórico. Dorme de novo se o buffer não pedir envio.
+void low_power_sample_cycle(void)
+{
+  int16_t temperatura, umidade;
+
+  if (sensor_read(&temperatura, &umidade) == ESP_OK) {
+    low_power_push((uint32_t)time(NULL), temperatura, umidade);
+    // Alarme não espera o buffer encher: o próximo boot já é de envio
+    if (alarm_check(temperatura, umidade, 0)) {
+      low_power_request_flush();
+    }
+  } else {
+    ESP_LOGE(TAG_MQTT, "Falha ao ler os dados do DHT22");
+  }
+
+  if (low_power_timer_wakeup() && !low_power_flush_due()) {
+    low_power_sleep(s_cfg.sleep_s, BOTAO_RESET_GPIO);
+  }
+}
+
+// BSSID e canal do último AP: conecta direto, sem varrer todos os canais
+static void low_power_fast_reconnect(void)
+{
+  uint8_t bssid[6];
+  uint8_t channel;
+  wifi_config_t wifi_sta_config;
+
+  if (!low_power_get_ap(bssid, &channel) || esp_wifi_get_config(WIFI_IF_STA, &wifi_sta_config) != ESP_OK) {
+    return;
+  }
+  memcpy(wifi_sta_config.sta.bssid, bssid, sizeof(wifi_sta_config.sta.bssid));
+  wifi_sta_config.sta.bssid_set = true;
+  wifi_sta_config.sta.channel = channel;
+  wifi_sta_config.sta.scan_method = WIFI_FAST_SCAN;
+  esp_wifi_set_config(WIFI_IF_STA, &wifi_sta_config);
+  ESP_LOGI(TAG_STA, "Reconexão rápida: canal %u", channel);
+}
+
+// Espera o PUBACK de tudo que está em voo, até LOW_POWER_ACK_TIMEOUT_MS
+static bool low_power_wait_acks(void)
+{
+  publisher_stats_t stats;
+  for (int waited = 0; waited < LOW_POWER_ACK_TIMEOUT_MS; waited += 50) {
+    publisher_get_stats(&stats);
+    if (stats.inflight == 0) return true;
+    vTaskDelay(pdMS_TO_TICKS(50));
+  }
+  return false;
+}
+
+// Lote em CSV "timestamp,temperatura,umidade" (décimos), uma amostra por linha
+static bool low_power_flush(void)
+{
+  static char payload[LOW_POWER_BUFFER_SIZE * 24];
+  size_t len = 0;
+
+  for (size_t i = 0; i < low_power_count(); i++) {
+    const low_power_sample_t *sample = low_power_sample(i);
+    len += snprintf(payload + len, sizeof(payload) - len, "%" PRIu32 ",%d,%d\n",
+                    sample->timestamp, sample->temperatura, sample->umidade);
+    if (sample->timestamp >= HISTORY_MIN_EPOCH) {
+      flash_log_append(sample->timestamp, sample->temperatura, sample->umidade);
+    }
+  }
+
+  low_power_energy_t energy;
+  low_power_get_energy(&energy);
+  char msg[256];
+  snprintf(msg, sizeof(msg),
+           "{\"despertares\":%" PRIu32 ",\"amostras\":%" PRIu32 ",\"envios\":%" PRIu32 ",\"falhas\":%" PRIu32
+           ",\"sono_ms\":%" PRIu64 ",\"acordado_ms\":%" PRIu64 ",\"radio_ms\":%" PRIu64
+           ",\"radio_ms_por_amostra\":%" PRIu32 ",\"corrente_media_ua\":%" PRIu32 ",\"autonomia_dias\":%" PRIu32 "}",
+           energy.wakes, energy.samples, energy.flushes, energy.failed_flushes, energy.sleep_ms, energy.awake_ms,
+           energy.radio_ms, energy.radio_ms_per_sample, energy.avg_current_ua, energy.battery_days);
+  ESP_LOGI(TAG_MQTT, "Energia: %s", msg);
+
+  if (len > 0 && publisher_publish(topic_lote, payload, len, 1, 0) < 0) {
+    return false;
+  }
+  publisher_publish(topic_energia, msg, 0, 1, 0);
+
+  // Retrato retido com a última amostra do lote (o agendador não amostra neste boot)
+  size_t count = low_power_count();
+  const low_power_sample_t *last = count > 0 ? low_power_sample(count - 1) : NULL;
+  if (last != NULL && last->timestamp >= HISTORY_MIN_EPOCH) {
+    app_snapshot_t snap = {
+      .value = { [METRIC_UMIDADE] = last->umidade, [METRIC_TEMPERATURA] = last->temperatura },
+      .acquired_ms = (int64_t)last->timestamp * 1000,
+      .alarm = { [METRIC_UMIDADE] = s_alarms[METRIC_UMIDADE].active,
+                 [METRIC_TEMPERATURA] = s_alarms[METRIC_TEMPERATURA].active },
+      .health = sensor_health_state_name(s_sensor_health.state),
+      .recent_permille = sensor_health_recent_permille(&s_sensor_health),
+      .interval_ms = s_cfg.sleep_s * 1000,
+      .uptime_s = 0,
+    };
+    char state[APP_SNAPSHOT_MAX_LEN];
+    publisher_publish(topic_estado, state, app_snapshot_format(&snap, state, sizeof(state)), 0, 1);
+  }
+
+  // Só apaga o buffer depois do PUBACK
+  return low_power_wait_acks();
+}
+
+// Presença retida de quem vai dormir. O DISCONNECT limpo descarta o Last Will, então sem isto o
+// nascimento deste despertar ficaria retido como "online" até o próximo. Só retorna true com o PUBACK
+static bool low_power_publish_sleeping(void)
+{
+  char msg[96];
+  snprintf(msg, sizeof(msg), "{\"online\":false,\"dormindo\":true,\"acorda_em_s\":%" PRIu32 "}",
+           (uint32_t)s_cfg.sleep_s);
+  if (publisher_publish(topic_presenca, msg, 0, 1, 1) < 0) {
+    return false;
+  }
+  return low_power_wait_acks();
+}
+
+// Boot de envio: espera o MQTT, manda o lote e volta a dormir, com ou sem sucesso
+void low_power_task(void *arg)
+{
+  EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, MQTT_CONNECTED_BIT, pdFALSE, pdTRUE,
+                                         pdMS_TO_TICKS(LOW_POWER_CONNECT_TIMEOUT_MS));
+  bool ok = false;
+  bool asleep_acked = false;
+
+  if (bits & MQTT_CONNECTED_BIT) {
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+      low_power_save_ap(ap.bssid, ap.primary);
+    }
+    ok = low_power_flush();
+    asleep_acked = low_power_publish_sleeping();
+  } else {
+    ESP_LOGW(TAG_STA, "Sem MQTT em %d ms. Mantendo %u amostras para o próximo envio",
+             LOW_POWER_CONNECT_TIMEOUT_MS, (unsigned)low_power_count());
+    // O AP pode ter mudado de canal: a próxima tentativa faz a varredura completa
+    low_power_forget_ap();
+  }
+
+  low_power_flush_result(ok);
+  if (ok) {
+    low_power_clear();
+  }
+
+  // Sem o PUBACK da presença de sono, sai sem DISCONNECT: o broker perde a sessão pelo keepalive e
+  // publica o Last Will, em vez de manter o nascimento retido
+  if (global_mqtt_client != NULL && asleep_acked) {
+    esp_mqtt_client_disconnect(global_mqtt_client);
+  } else if (bits & MQTT_CONNECTED_BIT) {
+    ESP_LOGW(TAG_MQTT, "Presença de sono sem PUBACK; saindo sem DISCONNECT para o broker publicar o Last Will");
+  }
+  esp_wifi_stop();
+  low_power_sleep(s_cfg.sleep_s, BOTAO_RESET_GPIO);
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// MQTT EVENTS HANDLER
+// -----------------------------------------------------------------------------------------------------------
+
+static void log_error_if_nonzero(const char *message, int error_code)
+{
+    if (error_code != 0) {
+        ESP_LOGE(TAG_MQTT, "Last error %s: 0x%x", message, error_code);
+    }
+}
+
+// Nascimento em <mac>/presenca (retido): substitui o PRESENCE_OFFLINE que o broker publica como Last Will
+// quando a sessão cai sem DISCONNECT
+static void presence_publish_online(void)
+{
+  char msg[96];
+  snprintf(msg, sizeof(msg), "{\"online\":true,\"up\":%" PRIu32 ",\"reconexoes\":%" PRIu32 "}",
+           (uint32_t)(esp_timer_get_time() / 1000000), s_reconnects);
+  publisher_publish(topic_presenca, msg, 0, 1, 1);
+}
+
+static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+  ESP_LOGD(TAG_MQTT, "Event dispatched from event loop base=%s, event_id=%" PRIi32 "", base, event_id);
+  esp_mqtt_event_handle_t event = event_data;
+  esp_mqtt_client_handle_t client = event->client;
+  int msg_id;
+  switch ((esp_mqtt_event_id_t)event_id) {
+  case MQTT_EVENT_BEFORE_CONNECT:
+    tls_profile_on_before_connect();
+    break;
+  case MQTT_EVENT_CONNECTED:
+    ESP_LOGI(TAG_MQTT, "MQTT_EVENT_CONNECTED");
+    tls_profile_on_connected();
+    xEventGroupSetBits(s_wifi_event_group, MQTT_CONNECTED_BIT);
+    publisher_on_connected();
+    presence_publish_online();
+    alarm_publish_unsent();
+    // O retrato é montado pelo agendador; aqui só pede a republicação
+    if (s_snapshot_job != NULL) sched_job_start_once(s_snapshot_job, 0);
+    if (s_cfg.delivery == DELIVERY_SEQ) esp_mqtt_client_subscribe(client, topic_nack, 0);
+    esp_event_post(CONN_EVENT, CONN_EV_MQTT_CONNECTED, NULL, 0, 0);
+    break;
+  case MQTT_EVENT_DISCONNECTED:
+    ESP_LOGI(TAG_MQTT, "MQTT_EVENT_DISCONNECTED");
+    xEventGroupClearBits(s_wifi_event_group, MQTT_CONNECTED_BIT);
+    publisher_on_disconnected();
+    esp_event_post(CONN_EVENT, CONN_EV_MQTT_DISCONNECTED, NULL, 0, 0);
+    break;
+
+  case MQTT_EVENT_SUBSCRIBED:
+    break;
+  case MQTT_EVENT_UNSUBSCRIBED:
+    break;
+  case MQTT_EVENT_PUBLISHED:
+    publisher_on_published(event->msg_id);
+    alarm_on_published(event->msg_id);
+    break;
+  case MQTT_EVENT_DATA:
+    if (event->topic_len == strlen(topic_nack) && strncmp(event->topic, topic_nack, event->topic_len) == 0) {
+      sample_seq_handle_nack(event->data, event->data_len);
+    }
+    break;
+
+  case MQTT_EVENT_ERROR:
+    ESP_LOGI(TAG_MQTT, "MQTT_EVENT_ERROR");
+    if (event->error_handle->error_type == MQTT_ERROR_TYPE_TCP_TRANSPORT) {
+      log_error_if_nonzero("reported from esp-tls", event->error_handle->esp_tls_last_esp_err);
+      log_error_if_nonzero("reported from tls stack", event->error_handle->esp_tls_stack_err);
+      log_error_if_nonzero("captured as transport's socket errno",  event->error_handle->esp_transport_sock_errno);
+      ESP_LOGI(TAG_MQTT, "Last errno string (%s)", strerror(event->error_handle->esp_transport_sock_errno));
+    }
+    break;
+  default:
+    ESP_LOGI(TAG_MQTT, "Other event id:%d", event->event_id);
+    break;
   }
 }
 
@@ -748,18 +2204,396 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 
 static void mqtt_app_start(void)
 {
+  esp_mqtt_protocol_ver_t protocol = (s_cfg.mqtt_version == 5) ? MQTT_PROTOCOL_V_5 : MQTT_PROTOCOL_V_3_1_1;
   esp_mqtt_client_config_t mqtt_cfg = {
     .broker.address.uri = CONFIG_BROKER_URL,
-    .broker.verification.crt_bundle_attach = esp_crt_bundle_attach,
     .credentials.username = CONFIG_MQTT_USERNAME,
     .credentials.authentication.password = CONFIG_MQTT_PASSWORD,
-    .session.protocol_ver = MQTT_PROTOCOL_V_3_1_1,
+    .session.protocol_ver = protocol,
+    .session.last_will = {
+      .topic = topic_presenca,
+      .msg = PRESENCE_OFFLINE,
+      .qos = 1,
+      .retain = 1,
+    },
+    .network.disable_auto_reconnect = true,   // reconexão comandada pela máquina de conectividade
   };
+  tls_profile_apply(&mqtt_cfg);
   global_mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
+  publisher_init(global_mqtt_client, protocol);
   esp_mqtt_client_register_event(global_mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+  log_sink_set_mqtt(global_mqtt_client, topic_log);
   esp_mqtt_client_start(global_mqtt_client);
 }
 
+// -----------------------------------------------------------------------------------------------------------
+// CONECTIVIDADE
+// -----------------------------------------------------------------------------------------------------------
+
+static void conn_wifi_connect(void)
+{
+  esp_wifi_connect();
+}
+
+static void conn_wifi_disconnect(void)
+{
+  esp_wifi_disconnect();
+}
+
+// Fallback: portal de configuração em APSTA, enquanto o STA continua tentando de tempos em tempos
+static void conn_ap_start(void)
+{
+  ESP_LOGW(TAG_STA, "Sem conexão WiFi. Ativando fallback para AP...");
+  xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+
+  esp_timer_stop(s_ap_stop_timer);
+  esp_wifi_set_mode(WIFI_MODE_APSTA);
+  wifi_init_softap();
+  prepare_wifi_page(device_mac_str);
+  start_webserver();
+  sched_job_start_periodic(s_ap_blink_job, LED_BLINK_MS);
+}
+
+static void ap_stop_timer_cb(void *arg)
+{
+  // O fallback pode ter religado o AP durante a carência
+  if (!s_conn.ap_active) {
+    ESP_LOGI(TAG_AP, "Desligando AP");
+    esp_wifi_set_mode(WIFI_MODE_STA);
+  }
+}
+
+// O AP continua no ar por PROV_AP_GRACE_MS para o portal conseguir ler o resultado em /wifi/status
+static void conn_ap_stop(void)
+{
+  ESP_LOGI(TAG_STA, "Conexão restabelecida. AP desliga em %d ms", PROV_AP_GRACE_MS);
+  xEventGroupClearBits(s_wifi_event_group, WIFI_FAIL_BIT);
+
+  sched_job_stop(s_ap_blink_job);
+  gpio_set_level(LED_CONFIG_GPIO, 0);
+  esp_timer_stop(s_ap_stop_timer);
+  esp_timer_start_once(s_ap_stop_timer, (uint64_t)PROV_AP_GRACE_MS * 1000);
+}
+
+static void mqtt_app_start(void);
+
+static void conn_mqtt_connect(void)
+{
+  if (global_mqtt_client == NULL) {
+    mqtt_app_start();
+  } else {
+    esp_mqtt_client_reconnect(global_mqtt_client);
+  }
+}
+
+// O timer só posta o evento; a máquina roda sempre na task do event loop padrão
+static void conn_timer_cb(void *arg)
+{
+  uint32_t gen = s_conn.timer_gen;
+  esp_event_post(CONN_EVENT, CONN_EV_TIMER, &gen, sizeof(gen), 0);
+}
+
+static void conn_timer_start(uint32_t ms)
+{
+  esp_timer_stop(s_conn_timer);
+  esp_timer_start_once(s_conn_timer, (uint64_t)ms * 1000);
+}
+
+static void conn_timer_stop(void)
+{
+  esp_timer_stop(s_conn_timer);
+}
+
+static uint32_t conn_random(void)
+{
+  return esp_random();
+}
+
+// Cada transição vai para o log e para o tópico <mac>/conectividade (QoS 1: fica no outbox até reconectar)
+static void conn_on_transition(const conn_fsm_t *fsm, conn_state_t from, conn_state_t to)
+{
+  ESP_LOGI(TAG_STA, "Conectividade: %s -> %s (sta=%" PRIu32 ", mqtt=%" PRIu32 ", backoff=%" PRIu32 " ms)",
+           conn_state_name(from), conn_state_name(to), fsm->sta_attempts, fsm->mqtt_attempts, fsm->backoff_ms);
+
+  // Tempo de reconexão: da queda do ONLINE até voltar a ele
+  if (from == CONN_ONLINE) {
+    s_online_lost_us = esp_timer_get_time();
+  } else if (to == CONN_ONLINE && s_online_lost_us != 0) {
+    s_reconnect_last_ms = (esp_timer_get_time() - s_online_lost_us) / 1000;
+    if (s_reconnect_last_ms > s_reconnect_max_ms) s_reconnect_max_ms = s_reconnect_last_ms;
+    s_reconnects++;
+    s_online_lost_us = 0;
+  }
+
+  if (global_mqtt_client != NULL) {
+    char msg[128];
+    snprintf(msg, sizeof(msg), "{\"de\":\"%s\",\"para\":\"%s\",\"n\":%" PRIu32 ",\"backoff_ms\":%" PRIu32 "}",
+             conn_state_name(from), conn_state_name(to), fsm->transitions, fsm->backoff_ms);
+    publisher_publish(topic_conectividade, msg, 0, 1, 0);
+  }
+}
+
+static const conn_ops_t conn_ops = {
+  .wifi_connect = conn_wifi_connect,
+  .wifi_disconnect = conn_wifi_disconnect,
+  .ap_start = conn_ap_start,
+  .ap_stop = conn_ap_stop,
+  .mqtt_connect = conn_mqtt_connect,
+  .timer_start = conn_timer_start,
+  .timer_stop = conn_timer_stop,
+  .random = conn_random,
+  .on_transition = conn_on_transition,
+};
+
+static void conn_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+  if (event_id == CONN_EV_TIMER) {
+    conn_fsm_timer_fired(&s_conn, *(uint32_t *)event_data);
+    return;
+  }
+  conn_fsm_handle(&s_conn, (conn_event_t)event_id);
+}
+
+static bool conn_running(void)
+{
+  return s_conn.ops != NULL;
+}
+
+void conn_start(void)
+{
+  const esp_timer_create_args_t timer_args = {
+    .callback = conn_timer_cb,
+    .name = "conn_timer",
+  };
+  ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_conn_timer));
+
+  const esp_timer_create_args_t ap_stop_args = {
+    .callback = ap_stop_timer_cb,
+    .name = "ap_stop",
+  };
+  ESP_ERROR_CHECK(esp_timer_create(&ap_stop_args, &s_ap_stop_timer));
+  ESP_ERROR_CHECK(esp_event_handler_instance_register(CONN_EVENT, ESP_EVENT_ANY_ID, &conn_event_handler, NULL, NULL));
+  conn_fsm_init(&s_conn, &conn_ops);
+  s_conn.spread_ms = CONN_SPREAD_MS;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// PROVISIONAMENTO
+//
+// As credenciais recebidas pelo portal são testadas em APSTA sem reiniciar: o AP continua no ar,
+// a página acompanha o teste por /wifi/status e o NVS só é gravado depois que o STA obtém IP.
+// No boot sem credenciais a máquina de conectividade ainda não existe; ela é criada no sucesso
+// e assume a conexão já feita. No fallback ela já roda e o teste só antecipa a próxima tentativa.
+// -----------------------------------------------------------------------------------------------------------
+
+typedef enum {
+  PROV_IDLE = 0,
+  PROV_TESTING,
+  PROV_OK,
+  PROV_FAILED,
+} prov_state_t;
+
+static const char *const prov_state_names[] = { "ocioso", "testando", "conectado", "falha" };
+
+static portMUX_TYPE s_prov_lock = portMUX_INITIALIZER_UNLOCKED;
+static prov_state_t s_prov_state = PROV_IDLE;
+static char s_prov_ssid[32];
+static char s_prov_pass[64];
+static char s_prov_ip[16];
+static int s_prov_reason = 0;
+static int64_t s_prov_started_us = 0;
+static uint32_t s_prov_elapsed_ms = 0;
+static esp_timer_handle_t s_prov_timer = NULL;
+
+// Trabalhos do modo estação: botão de reset e aquisição
+void start_sta_jobs(void)
+{
+  sched_job_start_periodic(s_reset_button_job, BOTAO_POLL_MS);
+  acquisition_reset();
+  sched_job_start_once(s_acquisition_job, 0);
+}
+
+// Uma task e uma pilha para todos os trabalhos periódicos curtos (ver sched.h)
+static void sched_jobs_init(void)
+{
+  ESP_ERROR_CHECK(sched_init(PRIO_DHT, CORE_AQUISICAO));
+  s_reset_button_job = sched_job_create("botao_reset", reset_button_job, NULL);
+  s_ap_blink_job = sched_job_create("pisca_ap", ap_blink_job, NULL);
+  s_acquisition_job = sched_job_create("aquisicao", acquisition_job, NULL);
+  s_snapshot_job = sched_job_create("estado", snapshot_job, NULL);
+  for (size_t i = 0; i < sizeof(s_blink_leds) / sizeof(s_blink_leds[0]); i++) {
+    s_led_off_jobs[i] = sched_job_create(s_blink_job_names[i], led_off_job, (void *)(intptr_t)s_blink_leds[i]);
+  }
+}
+
+// Encerra o teste em andamento; retorna false se outro caminho já o encerrou
+static bool prov_finish(prov_state_t result, int reason)
+{
+  bool finished = false;
+  portENTER_CRITICAL(&s_prov_lock);
+  if (s_prov_state == PROV_TESTING) {
+    s_prov_state = result;
+    s_prov_reason = reason;
+    s_prov_elapsed_ms = (uint32_t)((esp_timer_get_time() - s_prov_started_us) / 1000);
+    finished = true;
+  }
+  portEXIT_CRITICAL(&s_prov_lock);
+  return finished;
+}
+
+static void prov_timeout_cb(void *arg)
+{
+  if (prov_finish(PROV_FAILED, PROV_REASON_TIMEOUT)) {
+    ESP_LOGW(TAG_STA, "Provisionamento: sem IP em %d ms", PROV_TIMEOUT_MS);
+    if (!conn_running()) {
+      esp_wifi_disconnect();
+    }
+  }
+}
+
+esp_err_t prov_begin(const char *ssid, const char *password)
+{
+  if (s_prov_timer == NULL) {
+    const esp_timer_create_args_t timer_args = {
+      .callback = prov_timeout_cb,
+      .name = "prov_timeout",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_prov_timer));
+  }
+
+  // Com a máquina rodando, só faz sentido testar enquanto ela ainda procura um AP, e só entre tentativas:
+  // em CONN_STA_CONNECTING o driver recusa trocar a configuração do STA. O portal recebe 409 e repete;
+  // a tentativa em curso termina em no máximo CONN_STA_CONNECT_TIMEOUT_MS
+  if (conn_running() && s_conn.state != CONN_STA_BACKOFF && s_conn.state != CONN_AP_FALLBACK) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  portENTER_CRITICAL(&s_prov_lock);
+  if (s_prov_state == PROV_TESTING) {
+    portEXIT_CRITICAL(&s_prov_lock);
+    return ESP_ERR_INVALID_STATE;
+  }
+  s_prov_state = PROV_TESTING;
+  strlcpy(s_prov_ssid, ssid, sizeof(s_prov_ssid));
+  strlcpy(s_prov_pass, password, sizeof(s_prov_pass));
+  s_prov_ip[0] = '\0';
+  s_prov_reason = 0;
+  s_prov_elapsed_ms = 0;
+  s_prov_started_us = esp_timer_get_time();
+  portEXIT_CRITICAL(&s_prov_lock);
+
+  ESP_LOGI(TAG_STA, "Provisionamento: testando SSID %s", ssid);
+  esp_timer_stop(s_prov_timer);
+  esp_timer_start_once(s_prov_timer, (uint64_t)PROV_TIMEOUT_MS * 1000);
+
+  wifi_mode_t mode = WIFI_MODE_NULL;
+  esp_wifi_get_mode(&mode);
+  if (mode == WIFI_MODE_AP) {
+    // O STA sobe em WIFI_EVENT_STA_START; a conexão começa em prov_on_sta_start
+    esp_wifi_set_mode(WIFI_MODE_APSTA);
+  }
+  esp_err_t err = wifi_init_sta(ssid, password);
+  if (err != ESP_OK) {
+    // A máquina pode ter começado uma tentativa depois da verificação acima; o teste nem começou
+    esp_timer_stop(s_prov_timer);
+    portENTER_CRITICAL(&s_prov_lock);
+    s_prov_state = PROV_IDLE;
+    portEXIT_CRITICAL(&s_prov_lock);
+    return err == ESP_ERR_WIFI_STATE ? ESP_ERR_INVALID_STATE : err;
+  }
+  if (mode != WIFI_MODE_AP) {
+    if (conn_running()) {
+      esp_event_post(CONN_EVENT, CONN_EV_RETRY, NULL, 0, 0);
+    } else {
+      esp_wifi_connect();
+    }
+  }
+  return ESP_OK;
+}
+
+void prov_status_json(char *buf, size_t len)
+{
+  portENTER_CRITICAL(&s_prov_lock);
+  prov_state_t state = s_prov_state;
+  int reason = s_prov_reason;
+  uint32_t elapsed_ms = s_prov_elapsed_ms;
+  portEXIT_CRITICAL(&s_prov_lock);
+
+  snprintf(buf, len, "{\"estado\":\"%s\",\"ssid\":\"%s\",\"ip\":\"%s\",\"reason\":%d,\"ms\":%" PRIu32 "}",
+           prov_state_names[state], s_prov_ssid, s_prov_ip, reason, elapsed_ms);
+}
+
+static void prov_on_sta_start(void)
+{
+  if (s_prov_state == PROV_TESTING && !conn_running()) {
+    esp_wifi_connect();
+  }
+}
+
+static void prov_on_sta_disconnected(int reason)
+{
+  if (prov_finish(PROV_FAILED, reason)) {
+    esp_timer_stop(s_prov_timer);
+    ESP_LOGW(TAG_STA, "Provisionamento: falha ao conectar em %s (reason:%d)", s_prov_ssid, reason);
+  }
+}
+
+static void prov_on_got_ip(const esp_ip4_addr_t *ip)
+{
+  snprintf(s_prov_ip, sizeof(s_prov_ip), IPSTR, IP2STR(ip));
+  if (!prov_finish(PROV_OK, 0)) return;
+
+  esp_timer_stop(s_prov_timer);
+  ESP_LOGI(TAG_STA, "Provisionamento: conectado em %s após %" PRIu32 " ms. Salvando no NVS",
+           s_prov_ssid, s_prov_elapsed_ms);
+
+  nvs_handle handle;
+  if (nvs_open("storage", NVS_READWRITE, &handle) == ESP_OK) {
+    nvs_set_str(handle, "ssid", s_prov_ssid);
+    nvs_set_str(handle, "password", s_prov_pass);
+    nvs_commit(handle);
+    nvs_close(handle);
+  }
+
+  if (!conn_running()) {
+    // Boot sem credenciais: a máquina assume a partir daqui e desliga o AP quando ficar ONLINE
+    conn_start();
+    s_conn.ap_active = true;
+    start_sta_jobs();
+  }
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// SINCRONIZAÇÃO DE HORA
+// -----------------------------------------------------------------------------------------------------------
+
+// Roda na task do lwIP a cada acerto. Do segundo acerto em diante, o salto entre a base nova e a
+// anterior é a deriva do relógio no intervalo: é o que dá a margem de erro dos carimbos de tempo.
+static void sntp_on_sync(struct timeval *tv)
+{
+  int64_t now_us = esp_timer_get_time();
+  int64_t offset_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec - now_us;
+
+  if (s_sntp_syncs > 0) {
+    s_sntp_step_ms = (int32_t)((offset_us - s_sntp_offset_us) / 1000);
+  }
+  s_sntp_offset_us = offset_us;
+  s_sntp_sync_us = now_us;
+  s_sntp_syncs++;
+}
+
+static void sntp_start(void)
+{
+  static bool started = false;
+  if (started) return;
+
+  esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(SNTP_SERVER);
+  config.sync_cb = sntp_on_sync;
+  if (esp_netif_sntp_init(&config) == ESP_OK) {
+    started = true;
+  }
+}
+
 // -----------------------------------------------------------------------------------------------------------
 // WIFI_EVENTS HANDLER
 // -----------------------------------------------------------------------------------------------------------
@@ -777,20 +2611,32 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
             MAC2STR(event->mac), event->aid, event->reason);
   } 
   else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-    esp_wifi_connect();
     ESP_LOGI(TAG_STA, "Modo STA iniciado");
+    prov_on_sta_start();
+    if (conn_running()) {
+      conn_fsm_handle(&s_conn, CONN_EV_START);
+    }
   } 
   else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-    ESP_LOGW(TAG_STA, "Falha na conexão. Tentando novamente...");
-    esp_wifi_connect();
+    wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *) event_data;
+    ESP_LOGW(TAG_STA, "Falha na conexão (reason:%d)", event->reason);
+    xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    prov_on_sta_disconnected(event->reason);
+    if (conn_running()) {
+      conn_fsm_handle(&s_conn, CONN_EV_STA_DISCONNECTED);
+    }
   }
   else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
     ip_event_got_ip_t *event = (ip_event_got_ip_t *) event_data;
     ESP_LOGI(TAG_STA, "IP obtido:" IPSTR, IP2STR(&event->ip_info.ip));
-    s_retry_num = 0;  
     xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     gpio_set_level(LED_CONFIG_GPIO, 0);
-    mqtt_app_start();
+    sntp_start();
+    start_api_server();
+    prov_on_got_ip(&event->ip_info.ip);
+    if (conn_running()) {
+      conn_fsm_handle(&s_conn, CONN_EV_GOT_IP);
+    }
   }
 }
 
@@ -800,6 +2646,9 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
 
 void app_main(void)
 {
+  // Log assíncrono antes de tudo para que nenhuma task espere a UART
+  log_sink_init(LOG_SINK_UART | LOG_SINK_HTTP);
+
   ESP_ERROR_CHECK(esp_netif_init());
   ESP_ERROR_CHECK(esp_event_loop_create_default());
 
@@ -814,6 +2663,32 @@ void app_main(void)
   // Configura hardware
   config_button();
   config_led();
+  sensor_init();
+  sensor_health_reset(&s_sensor_health);
+
+  char ssid[32] = {0};
+  char password[64] = {0};
+
+  wifi_read_sta_config(ssid, password);
+  app_config_defaults(&s_cfg);
+  publish_config_load();
+  alarm_configure(&s_alarms[METRIC_UMIDADE], &s_cfg.alarm[METRIC_UMIDADE]);
+  alarm_configure(&s_alarms[METRIC_TEMPERATURA], &s_cfg.alarm[METRIC_TEMPERATURA]);
+
+  // Baixo consumo: o botão acorda em modo normal (manutenção); o timer só lê o sensor e volta a dormir
+  // até o buffer pedir envio, antes de gastar tempo com histórico e Wi-Fi
+  bool low_power = s_cfg.low_power && strlen(ssid) > 0 && esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_EXT0;
+  if (low_power) {
+    low_power_boot();
+    low_power_sample_cycle();
+  }
+
+  // Depois do ciclo de baixo consumo: um despertar que volta a dormir não precisa da task do agendador
+  ESP_ERROR_CHECK(worker_init(PRIO_SAIDA, CORE_REDE));
+  sched_jobs_init();
+
+  // Histórico local em flash
+  flash_log_init();
 
   // Inicializa Wifi event group
   s_wifi_event_group = xEventGroupCreate();
@@ -830,11 +2705,6 @@ void app_main(void)
                   NULL,
                   NULL));
 
-  char ssid[32] = {0};
-  char password[64] = {0};
-
-  wifi_read_sta_config(ssid, password);
-
   wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
   ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
@@ -846,17 +2716,56 @@ void app_main(void)
     ESP_LOGE(TAG_MQTT, "Falha ao obter o MAC Address. Usando ID padrão");
   }
 
-  sprintf(topic_umidade, "%s/umidade", device_mac_str);
-  sprintf(topic_temperatura, "%s/temperatura", device_mac_str);
+  app_format_topic(topic_umidade, sizeof(topic_umidade), device_mac_str, "umidade");
+  app_format_topic(topic_temperatura, sizeof(topic_temperatura), device_mac_str, "temperatura");
+  app_format_topic(topic_umidade_agg, sizeof(topic_umidade_agg), device_mac_str, "umidade/agg");
+  app_format_topic(topic_temperatura_agg, sizeof(topic_temperatura_agg), device_mac_str, "temperatura/agg");
+  app_format_topic(topic_log, sizeof(topic_log), device_mac_str, "log");
+  app_format_topic(topic_amostragem, sizeof(topic_amostragem), device_mac_str, "amostragem");
+  app_format_topic(topic_nack, sizeof(topic_nack), device_mac_str, "nack");
+  app_format_topic(topic_conectividade, sizeof(topic_conectividade), device_mac_str, "conectividade");
+  app_format_topic(topic_lote, sizeof(topic_lote), device_mac_str, "lote");
+  app_format_topic(topic_alarme, sizeof(topic_alarme), device_mac_str, "alarme");
+  app_format_topic(topic_energia, sizeof(topic_energia), device_mac_str, "energia");
+  app_format_topic(topic_sensor, sizeof(topic_sensor), device_mac_str, "sensor");
+  app_format_topic(topic_bench, sizeof(topic_bench), device_mac_str, "bench");
+  app_format_topic(topic_estado, sizeof(topic_estado), device_mac_str, "estado");
+  app_format_topic(topic_presenca, sizeof(topic_presenca), device_mac_str, "presenca");
+
+  // Console de diagnóstico na UART; no baixo consumo o dispositivo volta a dormir antes de alguém usá-la
+  if (!low_power) {
+    static const diag_console_ops_t console_ops = {
+      .stats_json = stats_format_json,
+      .config_json = config_format_json,
+      .config_set = config_apply,
+      .bench_topic = topic_bench,
+    };
+    diag_console_start(&console_ops, CORE_REDE);
+  }
+
+  // Outbox do MQTT num bloco só, antes que o heap comece a fragmentar
+  msg_pool_init(s_cfg.pool_slots);
+  sample_seq_init(boot_epoch_next(), sample_topics, 2);
 
   if (strlen(ssid) > 0 && strlen(password) > 0) {
     ESP_LOGI(TAG_STA, "Iniciando STA com dados do NVS...");
+    conn_start();
+    if (low_power) {
+      // Acorda sozinho, em horário próprio, e cada ms com o rádio ligado custa bateria
+      s_conn.spread_ms = 0;
+    }
     esp_wifi_set_mode(WIFI_MODE_STA);
-    wifi_init_sta(ssid, password);
+    ESP_ERROR_CHECK(wifi_init_sta(ssid, password));
+    if (low_power) {
+      low_power_fast_reconnect();
+    }
     esp_wifi_start();
-    xTaskCreate(wifi_reset_task, "wifi_reset_task", 2048, NULL, 5, NULL);
-    xTaskCreate(sta_monitor_task, "sta_monitor_task", 4096, NULL, 5, NULL);
-    xTaskCreate(dht_task, "dht_task", 4096, NULL, 5, NULL);
+    if (low_power) {
+      low_power_radio_on();
+      xTaskCreatePinnedToCore(low_power_task, "low_power_task", 4096, NULL, PRIO_BOTAO, NULL, CORE_REDE);
+    } else {
+      start_sta_jobs();
+    }
   } else {
     ESP_LOGI(TAG_AP, "Iniciando Access Point...");
     esp_wifi_set_mode(WIFI_MODE_AP);
@@ -864,6 +2773,6 @@ void app_main(void)
     esp_wifi_start();
     prepare_wifi_page(device_mac_str);
     start_webserver();
-    xTaskCreate(ap_blink_task, "ap_blink_task", 2048, NULL, 5, NULL);
+    sched_job_start_periodic(s_ap_blink_job, LED_BLINK_MS);
   }
 }
@@ -0,0 +1,303 @@
+#include <stdbool.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "mqtt_outbox.h"
+#include "msg_pool.h"
+
+static const char *TAG_POOL = "MQTT";
+
+struct outbox_item {
+  bool in_use;
+  uint32_t seq;               // ordem de chegada, como a fila do outbox padrão
+  uint16_t first_slot;
+  uint16_t nslots;
+  uint8_t *buffer;
+  size_t len;
+  int msg_id;
+  int msg_type;
+  int msg_qos;
+  outbox_tick_t tick;
+  pending_state_t pending;
+};
+
+struct outbox_list_t {
+  struct outbox_item *items;  // um por slot: o máximo de mensagens que cabem
+  uint8_t *slots;
+  uint16_t nslots;
+  uint32_t used_map[MSG_POOL_SLOTS_MAX / 32];
+  uint32_t next_seq;
+  uint32_t items_used;
+  uint32_t slots_used;
+  uint32_t high_water;
+  uint32_t rejected;
+  uint64_t size;
+};
+
+static struct outbox_list_t s_pool;
+
+// -----------------------------------------------------------------------------------------------------------
+// SLOTS
+// -----------------------------------------------------------------------------------------------------------
+
+static bool slot_used(uint16_t slot)
+{
+  return (s_pool.used_map[slot / 32] & (1u << (slot % 32))) != 0;
+}
+
+static void slots_mark(uint16_t first, uint16_t count, bool used)
+{
+  for (uint16_t slot = first; slot < first + count; slot++) {
+    if (used) {
+      s_pool.used_map[slot / 32] |= 1u << (slot % 32);
+    } else {
+      s_pool.used_map[slot / 32] &= ~(1u << (slot % 32));
+    }
+  }
+}
+
+// First-fit por slots contíguos; devolve false se não houver espaço
+static bool slots_alloc(uint16_t count, uint16_t *first)
+{
+  uint16_t run = 0;
+  for (uint16_t slot = 0; slot < s_pool.nslots; slot++) {
+    run = slot_used(slot) ? 0 : run + 1;
+    if (run == count) {
+      *first = slot + 1 - count;
+      slots_mark(*first, count, true);
+      s_pool.slots_used += count;
+      if (s_pool.slots_used > s_pool.high_water) s_pool.high_water = s_pool.slots_used;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void item_release(struct outbox_item *item)
+{
+  slots_mark(item->first_slot, item->nslots, false);
+  s_pool.slots_used -= item->nslots;
+  s_pool.items_used--;
+  s_pool.size -= item->len;
+  item->in_use = false;
+}
+
+esp_err_t msg_pool_init(uint16_t slots)
+{
+  if (s_pool.slots != NULL) return ESP_ERR_INVALID_STATE;
+  if (slots == 0 || slots > MSG_POOL_SLOTS_MAX) slots = MSG_POOL_SLOTS_DEFAULT;
+
+  // Uma alocação só, feita no boot enquanto o heap ainda está inteiro
+  size_t items_size = slots * sizeof(struct outbox_item);
+  uint8_t *area = heap_caps_malloc(items_size + (size_t)slots * MSG_POOL_SLOT_SIZE, MALLOC_CAP_8BIT);
+  if (area == NULL) {
+    ESP_LOGE(TAG_POOL, "Sem memória para o pool de %u slots", slots);
+    return ESP_ERR_NO_MEM;
+  }
+  memset(area, 0, items_size);
+  s_pool.items = (struct outbox_item *)area;
+  s_pool.slots = area + items_size;
+  s_pool.nslots = slots;
+
+  ESP_LOGI(TAG_POOL, "Outbox em pool: %u slots de %d B", slots, MSG_POOL_SLOT_SIZE);
+  return ESP_OK;
+}
+
+void msg_pool_get_stats(msg_pool_stats_t *stats)
+{
+  stats->slots = s_pool.nslots;
+  stats->used = s_pool.slots_used;
+  stats->high_water = s_pool.high_water;
+  stats->items = s_pool.items_used;
+  stats->bytes = (uint32_t)s_pool.size;
+  stats->rejected = s_pool.rejected;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// API DO OUTBOX (mqtt_outbox.h)
+// -----------------------------------------------------------------------------------------------------------
+
+outbox_handle_t outbox_init(void)
+{
+  if (s_pool.slots == NULL && msg_pool_init(MSG_POOL_SLOTS_DEFAULT) != ESP_OK) {
+    return NULL;
+  }
+  return &s_pool;
+}
+
+outbox_item_handle_t outbox_enqueue(outbox_handle_t outbox, outbox_message_handle_t message, outbox_tick_t tick)
+{
+  size_t len = message->len + message->remaining_len;
+  uint16_t nslots = (len + MSG_POOL_SLOT_SIZE - 1) / MSG_POOL_SLOT_SIZE;
+  uint16_t first;
+
+  if (nslots == 0 || nslots > outbox->nslots || !slots_alloc(nslots, &first)) {
+    outbox->rejected++;
+    ESP_LOGW(TAG_POOL, "Pool cheio: msg_id %d (%u B) recusada", message->msg_id, (unsigned)len);
+    return NULL;
+  }
+
+  // Há tantos itens quanto slots, então sempre existe um livre se os slots couberam
+  struct outbox_item *item = NULL;
+  for (uint16_t i = 0; i < outbox->nslots; i++) {
+    if (!outbox->items[i].in_use) {
+      item = &outbox->items[i];
+      break;
+    }
+  }
+
+  *item = (struct outbox_item){
+    .in_use = true,
+    .seq = outbox->next_seq++,
+    .first_slot = first,
+    .nslots = nslots,
+    .buffer = outbox->slots + (size_t)first * MSG_POOL_SLOT_SIZE,
+    .len = len,
+    .msg_id = message->msg_id,
+    .msg_type = message->msg_type,
+    .msg_qos = message->msg_qos,
+    .tick = tick,
+    .pending = QUEUED,
+  };
+  memcpy(item->buffer, message->data, message->len);
+  if (message->remaining_data != NULL) {
+    memcpy(item->buffer + message->len, message->remaining_data, message->remaining_len);
+  }
+  outbox->items_used++;
+  outbox->size += len;
+  return item;
+}
+
+// Mais antigo primeiro, como a STAILQ do outbox padrão
+static struct outbox_item *oldest(outbox_handle_t outbox, bool (*match)(const struct outbox_item *, const void *),
+                                  const void *arg)
+{
+  struct outbox_item *found = NULL;
+  for (uint16_t i = 0; i < outbox->nslots; i++) {
+    struct outbox_item *item = &outbox->items[i];
+    if (item->in_use && match(item, arg) && (found == NULL || (int32_t)(item->seq - found->seq) < 0)) {
+      found = item;
+    }
+  }
+  return found;
+}
+
+static bool match_pending(const struct outbox_item *item, const void *arg)
+{
+  return item->pending == *(const pending_state_t *)arg;
+}
+
+static bool match_msg_id(const struct outbox_item *item, const void *arg)
+{
+  return item->msg_id == *(const int *)arg;
+}
+
+outbox_item_handle_t outbox_dequeue(outbox_handle_t outbox, pending_state_t pending, outbox_tick_t *tick)
+{
+  struct outbox_item *item = oldest(outbox, match_pending, &pending);
+  if (item != NULL && tick != NULL) {
+    *tick = item->tick;
+  }
+  return item;
+}
+
+outbox_item_handle_t outbox_get(outbox_handle_t outbox, int msg_id)
+{
+  return oldest(outbox, match_msg_id, &msg_id);
+}
+
+uint8_t *outbox_item_get_data(outbox_item_handle_t item, size_t *len, uint16_t *msg_id, int *msg_type, int *qos)
+{
+  if (item == NULL) return NULL;
+  *len = item->len;
+  *msg_id = item->msg_id;
+  *msg_type = item->msg_type;
+  *qos = item->msg_qos;
+  return item->buffer;
+}
+
+esp_err_t outbox_delete_item(outbox_handle_t outbox, outbox_item_handle_t item)
+{
+  if (item == NULL || !item->in_use) return ESP_FAIL;
+  item_release(item);
+  return ESP_OK;
+}
+
+esp_err_t outbox_delete(outbox_handle_t outbox, int msg_id, int msg_type)
+{
+  for (uint16_t i = 0; i < outbox->nslots; i++) {
+    struct outbox_item *item = &outbox->items[i];
+    if (item->in_use && item->msg_id == msg_id && (0xFF & item->msg_type) == (0xFF & msg_type)) {
+      item_release(item);
+      return ESP_OK;
+    }
+  }
+  return ESP_FAIL;
+}
+
+int outbox_delete_single_expired(outbox_handle_t outbox, outbox_tick_t current_tick, outbox_tick_t timeout)
+{
+  for (uint16_t i = 0; i < outbox->nslots; i++) {
+    struct outbox_item *item = &outbox->items[i];
+    if (item->in_use && current_tick - item->tick > timeout) {
+      int msg_id = item->msg_id;
+      item_release(item);
+      return msg_id;
+    }
+  }
+  return -1;
+}
+
+int outbox_delete_expired(outbox_handle_t outbox, outbox_tick_t current_tick, outbox_tick_t timeout)
+{
+  int deleted = 0;
+  for (uint16_t i = 0; i < outbox->nslots; i++) {
+    struct outbox_item *item = &outbox->items[i];
+    if (item->in_use && current_tick - item->tick > timeout) {
+      item_release(item);
+      deleted++;
+    }
+  }
+  return deleted;
+}
+
+esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t pending)
+{
+  outbox_item_handle_t item = outbox_get(outbox, msg_id);
+  if (item == NULL) return ESP_FAIL;
+  item->pending = pending;
+  return ESP_OK;
+}
+
+pending_state_t outbox_item_get_pending(outbox_item_handle_t item)
+{
+  return item != NULL ? item->pending : QUEUED;
+}
+
+esp_err_t outbox_set_tick(outbox_handle_t outbox, int msg_id, outbox_tick_t tick)
+{
+  outbox_item_handle_t item = outbox_get(outbox, msg_id);
+  if (item == NULL) return ESP_FAIL;
+  item->tick = tick;
+  return ESP_OK;
+}
+
+uint64_t outbox_get_size(outbox_handle_t outbox)
+{
+  return outbox->size;
+}
+
+void outbox_delete_all_items(outbox_handle_t outbox)
+{
+  for (uint16_t i = 0; i < outbox->nslots; i++) {
+    if (outbox->items[i].in_use) {
+      item_release(&outbox->items[i]);
+    }
+  }
+}
+
+// O pool vive até o fim: destruir o cliente só esvazia
+void outbox_destroy(outbox_handle_t outbox)
+{
+  outbox_delete_all_items(outbox);
+}
@@ -0,0 +1,34 @@
+#ifndef MSG_POOL_H
+#define MSG_POOL_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// POOL DE MENSAGENS (OUTBOX DO MQTT)
+//
+// Implementa o outbox do esp-mqtt (CONFIG_MQTT_CUSTOM_OUTBOX) sobre uma área alocada uma única vez no
+// boot. O outbox padrão faz dois malloc por mensagem QoS>0 e mais um free no PUBACK, o que fragmenta
+// o heap ao longo de meses de reconexões TLS. Aqui cada pacote ocupa slots contíguos de tamanho fixo,
+// devolvidos no PUBACK, na expiração ou quando o cliente descarta o outbox. Pool cheio = publicação
+// recusada (o publisher conta como falha), nunca mais heap.
+// -----------------------------------------------------------------------------------------------------------
+
+#define MSG_POOL_SLOT_SIZE      128
+#define MSG_POOL_SLOTS_DEFAULT  96      // 12 KB
+#define MSG_POOL_SLOTS_MAX      256
+
+typedef struct {
+  uint32_t slots;
+  uint32_t used;
+  uint32_t high_water;
+  uint32_t items;
+  uint32_t bytes;
+  uint32_t rejected;
+} msg_pool_stats_t;
+
+// Deve ser chamado antes de esp_mqtt_client_init(); a capacidade não muda depois
+esp_err_t msg_pool_init(uint16_t slots);
+void msg_pool_get_stats(msg_pool_stats_t *stats);
+
+#endif // MSG_POOL_H
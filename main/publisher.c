@@ -0,0 +1,242 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "publisher.h"
+
+#ifdef CONFIG_MQTT_PROTOCOL_5
+static const char *TAG_PUB = "MQTT";
+#endif
+
+static esp_mqtt_client_handle_t s_client = NULL;
+static esp_mqtt_protocol_ver_t s_protocol = MQTT_PROTOCOL_V_3_1_1;
+static SemaphoreHandle_t s_lock = NULL;
+
+static bool s_aliases = false;
+#ifdef CONFIG_MQTT_PROTOCOL_5
+static const char *s_alias_topics[PUBLISHER_TOPIC_ALIAS_MAX];
+#endif
+static uint16_t s_alias_max;    // maior alias aceito pelo broker nesta sessão
+static uint32_t s_alias_sent;   // bit por alias: tópico completo já enviado nesta sessão
+
+static uint32_t s_msgs = 0;
+static uint32_t s_aliased = 0;
+static uint32_t s_bytes = 0;
+static uint32_t s_failed = 0;
+static uint32_t s_deferred = 0;
+static uint32_t s_inflight = 0;
+static int64_t s_first_publish_us = 0;
+
+typedef struct {
+  int msg_id;
+  int64_t sent_us;
+} latency_slot_t;
+
+static latency_slot_t s_latency[PUBLISHER_LATENCY_SLOTS];
+static uint32_t s_acked = 0;
+static uint32_t s_latency_min_us = UINT32_MAX;
+static uint32_t s_latency_max_us = 0;
+static uint64_t s_latency_sum_us = 0;
+
+// -----------------------------------------------------------------------------------------------------------
+// AUXILIARES
+// -----------------------------------------------------------------------------------------------------------
+
+// Tamanho do PUBLISH no fio: cabeçalho fixo + tópico + packet id + propriedades + payload
+static uint32_t wire_size(size_t topic_len, size_t props_len, size_t payload_len, int qos)
+{
+  size_t remaining = 2 + topic_len + (qos > 0 ? 2 : 0) + props_len + payload_len;
+  size_t len_bytes = remaining < 128 ? 1 : (remaining < 16384 ? 2 : 3);
+  return 1 + len_bytes + remaining;
+}
+
+#ifdef CONFIG_MQTT_PROTOCOL_5
+// Os tópicos da aplicação são buffers estáticos, então o ponteiro identifica o tópico
+static uint16_t topic_alias(const char *topic)
+{
+  for (int i = 0; i < PUBLISHER_TOPIC_ALIAS_MAX; i++) {
+    if (s_alias_topics[i] == topic) return i + 1;
+    if (s_alias_topics[i] == NULL) {
+      s_alias_topics[i] = topic;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+#endif
+
+// -----------------------------------------------------------------------------------------------------------
+// API
+// -----------------------------------------------------------------------------------------------------------
+
+void publisher_init(esp_mqtt_client_handle_t client, esp_mqtt_protocol_ver_t protocol)
+{
+  if (s_lock == NULL) {
+    s_lock = xSemaphoreCreateMutex();
+  }
+  s_client = client;
+  s_protocol = protocol;
+
+#ifdef CONFIG_MQTT_PROTOCOL_5
+  if (protocol == MQTT_PROTOCOL_V_5) {
+    esp_mqtt5_connection_property_config_t connect_property = {
+      .receive_maximum = PUBLISHER_RECEIVE_MAXIMUM,
+      .topic_alias_maximum = PUBLISHER_TOPIC_ALIAS_MAX,
+    };
+    esp_mqtt5_client_set_connect_property(client, &connect_property);
+  }
+#endif
+}
+
+void publisher_on_connected(void)
+{
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  // Aliases valem só por sessão: a primeira publicação de cada tópico volta a levar o nome completo
+  s_aliases = (s_protocol == MQTT_PROTOCOL_V_5);
+  s_alias_max = PUBLISHER_TOPIC_ALIAS_MAX;
+  s_alias_sent = 0;
+  s_inflight = 0;
+  memset(s_latency, 0, sizeof(s_latency));
+  xSemaphoreGive(s_lock);
+}
+
+void publisher_on_disconnected(void)
+{
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  // Sem sessão não há aliases: o que for publicado até o próximo CONNACK leva o tópico completo
+  s_aliases = false;
+  s_alias_sent = 0;
+  xSemaphoreGive(s_lock);
+}
+
+void publisher_on_published(int msg_id)
+{
+  int64_t now = esp_timer_get_time();
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (s_inflight > 0) s_inflight--;
+
+  latency_slot_t *slot = &s_latency[msg_id % PUBLISHER_LATENCY_SLOTS];
+  if (slot->msg_id == msg_id && slot->sent_us != 0) {
+    uint32_t latency = now - slot->sent_us;
+    if (latency < s_latency_min_us) s_latency_min_us = latency;
+    if (latency > s_latency_max_us) s_latency_max_us = latency;
+    s_latency_sum_us += latency;
+    s_acked++;
+    slot->sent_us = 0;
+  }
+  xSemaphoreGive(s_lock);
+}
+
+static int publish(const char *topic, const char *data, int len, int qos, int retain, bool urgent)
+{
+  if (s_client == NULL) return -1;
+  if (len == 0) len = strlen(data);
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+
+  size_t topic_len = strlen(topic);
+  size_t props_len = 0;
+  int msg_id;
+
+#ifdef CONFIG_MQTT_PROTOCOL_5
+  uint16_t alias = 0;
+  if (s_protocol == MQTT_PROTOCOL_V_5) {
+    // Só QoS 0, que vai direto para o socket ou é descartado. QoS>0 passa pelo outbox e pode ser
+    // retransmitido em outra sessão, onde o alias não existe mais
+    if (s_aliases && qos == 0) alias = topic_alias(topic);
+    if (alias > s_alias_max) alias = 0;
+    // A propriedade vale só para a próxima publicação; o cliente omite o tópico quando o alias já é conhecido
+    esp_mqtt5_publish_property_config_t property = {
+      .message_expiry_interval = retain ? 0 : PUBLISHER_MESSAGE_EXPIRY_S,
+      .topic_alias = alias,
+    };
+    esp_mqtt5_client_set_publish_property(s_client, &property);
+    props_len = 1 + (retain ? 0 : 5) + (alias ? 3 : 0);
+    if (alias && (s_alias_sent & (1u << alias))) topic_len = 0;
+  }
+#endif
+
+  // Controle de fluxo: acima do limite de mensagens sem PUBACK a publicação vai só para o outbox
+  if (qos > 0 && !urgent && s_inflight >= PUBLISHER_INFLIGHT_MAX) {
+    msg_id = esp_mqtt_client_enqueue(s_client, topic, data, len, qos, retain, true);
+    s_deferred++;
+  } else {
+    msg_id = esp_mqtt_client_publish(s_client, topic, data, len, qos, retain);
+  }
+
+#ifdef CONFIG_MQTT_PROTOCOL_5
+  // O cliente recusa alias acima do topic alias maximum do CONNACK: aprende o limite da sessão e manda o
+  // tópico inteiro. Se nem assim sair, a falha não era do alias e o limite volta ao que era
+  if (msg_id < 0 && alias) {
+    uint16_t alias_max = s_alias_max;
+    s_alias_max = alias - 1;
+    esp_mqtt5_publish_property_config_t property = {
+      .message_expiry_interval = retain ? 0 : PUBLISHER_MESSAGE_EXPIRY_S,
+    };
+    esp_mqtt5_client_set_publish_property(s_client, &property);
+    msg_id = esp_mqtt_client_publish(s_client, topic, data, len, qos, retain);
+    props_len = 1 + (retain ? 0 : 5);
+    topic_len = strlen(topic);
+    alias = 0;
+    if (msg_id < 0) {
+      s_alias_max = alias_max;
+    } else {
+      ESP_LOGW(TAG_PUB, "Topic alias acima de %u recusado pelo broker", s_alias_max);
+    }
+  }
+  // QoS 0 aceito já foi escrito no socket: daqui em diante o broker conhece o alias
+  if (msg_id >= 0 && alias && topic_len > 0) s_alias_sent |= (1u << alias);
+#endif
+
+  if (msg_id >= 0) {
+    if (s_first_publish_us == 0) s_first_publish_us = esp_timer_get_time();
+    s_msgs++;
+    if (topic_len == 0) s_aliased++;
+    s_bytes += wire_size(topic_len, props_len, len, qos);
+    if (qos > 0) {
+      s_inflight++;
+      s_latency[msg_id % PUBLISHER_LATENCY_SLOTS] = (latency_slot_t) { .msg_id = msg_id, .sent_us = esp_timer_get_time() };
+    }
+  } else {
+    s_failed++;
+  }
+
+  xSemaphoreGive(s_lock);
+  return msg_id;
+}
+
+int publisher_publish(const char *topic, const char *data, int len, int qos, int retain)
+{
+  return publish(topic, data, len, qos, retain, false);
+}
+
+int publisher_publish_urgent(const char *topic, const char *data, int len)
+{
+  return publish(topic, data, len, 1, 0, true);
+}
+
+void publisher_get_stats(publisher_stats_t *stats)
+{
+  if (s_lock == NULL) {
+    memset(stats, 0, sizeof(*stats));
+    return;
+  }
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  stats->protocol = s_protocol;
+  stats->aliases = s_aliases;
+  stats->msgs = s_msgs;
+  stats->aliased = s_aliased;
+  stats->bytes = s_bytes;
+  stats->failed = s_failed;
+  stats->deferred = s_deferred;
+  stats->inflight = s_inflight;
+  stats->acked = s_acked;
+  stats->latency_min_us = s_acked ? s_latency_min_us : 0;
+  stats->latency_avg_us = s_acked ? s_latency_sum_us / s_acked : 0;
+  stats->latency_max_us = s_latency_max_us;
+  stats->first_publish_ms = s_first_publish_us / 1000;
+  xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,57 @@
+#ifndef PUBLISHER_H
+#define PUBLISHER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "mqtt_client.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// PUBLICAÇÃO MQTT
+//
+// Ponto único por onde passam as publicações da aplicação. No modo MQTT 5 toda publicação leva um message
+// expiry, para que o broker descarte leituras velhas em vez de entregar um backlog inteiro (publicações
+// retidas vão sem expiry: são o estado atual e precisam ficar no broker até serem substituídas). Também
+// contabiliza mensagens e bytes estimados no fio, para comparar os dois protocolos.
+//
+// Topic alias só em QoS 0, onde o tópico completo vai no primeiro envio da sessão e os seguintes levam só
+// o alias. QoS>0 fica sem alias: o outbox guarda o pacote já montado e o retransmite depois de uma
+// reconexão, numa sessão em que o alias não existe. Na prática só as amostras de delivery=seq (QoS 0)
+// economizam; o caminho padrão das amostras, os agregados e os alarmes vão em QoS 1 com o tópico inteiro.
+// O campo aliased das estatísticas conta as publicações que saíram só com o alias.
+// -----------------------------------------------------------------------------------------------------------
+
+#define PUBLISHER_TOPIC_ALIAS_MAX   8
+#define PUBLISHER_MESSAGE_EXPIRY_S  600
+#define PUBLISHER_RECEIVE_MAXIMUM   8     // mensagens QoS>0 do broker em voo
+#define PUBLISHER_INFLIGHT_MAX      8     // publicações QoS>0 nossas sem PUBACK
+#define PUBLISHER_LATENCY_SLOTS     16    // publicações QoS>0 acompanhadas até o PUBACK
+
+typedef struct {
+  esp_mqtt_protocol_ver_t protocol;
+  bool aliases;
+  uint32_t msgs;
+  uint32_t aliased;          // publicações sem o nome do tópico, só com o alias
+  uint32_t bytes;
+  uint32_t failed;
+  uint32_t deferred;
+  uint32_t inflight;
+  uint32_t acked;
+  uint32_t latency_min_us;   // publish -> PUBACK
+  uint32_t latency_avg_us;
+  uint32_t latency_max_us;
+  uint32_t first_publish_ms;   // desde o boot; 0 = nada publicado ainda
+} publisher_stats_t;
+
+// Deve ser chamado depois de esp_mqtt_client_init() e antes de esp_mqtt_client_start()
+void publisher_init(esp_mqtt_client_handle_t client, esp_mqtt_protocol_ver_t protocol);
+void publisher_on_connected(void);
+void publisher_on_disconnected(void);
+void publisher_on_published(int msg_id);
+
+// Mesma semântica de esp_mqtt_client_publish(); devolve o msg_id ou -1
+int publisher_publish(const char *topic, const char *data, int len, int qos, int retain);
+// QoS 1 que ignora o controle de fluxo: vai para o socket mesmo com a janela de PUBACKs cheia
+int publisher_publish_urgent(const char *topic, const char *data, int len);
+void publisher_get_stats(publisher_stats_t *stats);
+
+#endif // PUBLISHER_H
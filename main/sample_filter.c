@@ -0,0 +1,90 @@
+#include <string.h>
+#include "sample_filter.h"
+
+// 1,4826 em décimos de milésimo: MAD * 1,4826 estima o desvio-padrão de uma normal
+#define MAD_SCALE_E4  14826
+
+void sample_filter_reset(sample_filter_t *filter)
+{
+  memset(filter, 0, sizeof(*filter));
+}
+
+// Inserção sobre uma cópia: com no máximo 9 valores ganha de qualquer seleção mais esperta
+int16_t sample_filter_median(const int16_t *values, uint8_t n)
+{
+  int16_t sorted[SAMPLE_FILTER_MAX_WINDOW];
+
+  for (uint8_t i = 0; i < n; i++) {
+    int16_t v = values[i];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > v) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = v;
+  }
+  return sorted[(n - 1) / 2];
+}
+
+static bool hampel_outlier(const sample_filter_t *filter, uint8_t k, int16_t value, int16_t median)
+{
+  int16_t deviations[SAMPLE_FILTER_MAX_WINDOW];
+  for (uint8_t i = 0; i < filter->count; i++) {
+    int32_t d = filter->ring[i] - median;
+    deviations[i] = d < 0 ? -d : d;
+  }
+  int32_t mad = sample_filter_median(deviations, filter->count);
+
+  int32_t limit = ((int32_t)k * mad * MAD_SCALE_E4 + 5000) / 10000;
+  if (limit < SAMPLE_FILTER_MIN_DEV) limit = SAMPLE_FILTER_MIN_DEV;
+
+  int32_t distance = value - median;
+  return (distance < 0 ? -distance : distance) > limit;
+}
+
+bool sample_filter_apply(sample_filter_t *filter, const sample_filter_config_t *cfg, int16_t *value)
+{
+  uint8_t window = cfg->window;
+  if (window < 1) window = 1;
+  if (window > SAMPLE_FILTER_MAX_WINDOW) window = SAMPLE_FILTER_MAX_WINDOW;
+
+  // Janela alterada em tempo de execução: recomeça com a leitura atual
+  if (filter->window != window) {
+    filter->window = window;
+    filter->count = 0;
+    filter->head = 0;
+  }
+
+  // A janela guarda as leituras brutas, inclusive as rejeitadas: um degrau real vira maioria e passa
+  int16_t raw = *value;
+  filter->ring[filter->head] = raw;
+  filter->head = (filter->head + 1) % window;
+  if (filter->count < window) filter->count++;
+  filter->samples++;
+
+  int16_t out = raw;
+  if (filter->count >= 3 && (cfg->hampel_k || cfg->median)) {
+    int16_t median = sample_filter_median(filter->ring, filter->count);
+    if (cfg->hampel_k && filter->has_out && hampel_outlier(filter, cfg->hampel_k, raw, median)) {
+      filter->rejected++;
+      *value = filter->out;
+      return false;
+    }
+    if (cfg->median) out = median;
+  }
+
+  if (cfg->ema_shift) {
+    if (!filter->has_out) {
+      filter->ema_q8 = (int32_t)out * 256;
+    } else {
+      filter->ema_q8 += ((int32_t)out * 256 - filter->ema_q8) / (1 << cfg->ema_shift);
+    }
+    // Arredonda para o décimo mais próximo, simétrico em torno de zero
+    out = filter->ema_q8 >= 0 ? (filter->ema_q8 + 128) / 256 : -((-filter->ema_q8 + 128) / 256);
+  }
+
+  filter->has_out = true;
+  filter->out = out;
+  *value = out;
+  return true;
+}
@@ -0,0 +1,57 @@
+#ifndef SAMPLE_FILTER_H
+#define SAMPLE_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------------------------------------
+// FILTRO DE LEITURAS
+//
+// Estágio entre sensor_read() e o resto da aquisição. O AM2301 às vezes devolve um valor com checksum
+// válido e obviamente errado (um salto de 20 °C numa amostra só); sem filtro, o pico é publicado e
+// dispara alarme. Por canal, sobre as últimas `window` leituras brutas:
+//   - Hampel: rejeita a leitura cuja distância à mediana da janela passa de k * 1,4826 * MAD (o MAD
+//     escalado estima o desvio-padrão sem ser puxado pelos próprios picos), com piso de
+//     SAMPLE_FILTER_MIN_DEV para sinais parados (MAD 0). Uma mudança de nível real é aceita quando já
+//     ocupa metade da janela;
+//   - mediana: publica a mediana da janela em vez da leitura;
+//   - EMA: suaviza a saída com alfa = 1 / 2^ema_shift.
+// Tudo em décimos inteiros, sem ponto flutuante, com memória fixa por canal.
+// -----------------------------------------------------------------------------------------------------------
+
+#define SAMPLE_FILTER_MAX_WINDOW  9
+#define SAMPLE_FILTER_MIN_DEV     10    // décimos: abaixo de 1,0 °C / 1,0 % nada é rejeitado
+#define SAMPLE_FILTER_MAX_K       10
+#define SAMPLE_FILTER_MAX_EMA     6
+
+typedef struct {
+  uint8_t window;           // leituras na janela (1..SAMPLE_FILTER_MAX_WINDOW); 1 desliga Hampel e mediana
+  uint8_t median;           // 1: a saída é a mediana da janela
+  uint8_t hampel_k;         // 0 desliga a rejeição
+  uint8_t ema_shift;        // 0 desliga a EMA
+} sample_filter_config_t;
+
+#define SAMPLE_FILTER_CONFIG_DEFAULT() { .window = 5, .median = 0, .hampel_k = 3, .ema_shift = 0 }
+
+typedef struct {
+  int16_t ring[SAMPLE_FILTER_MAX_WINDOW];
+  uint8_t window;           // tamanho com que a janela foi preenchida
+  uint8_t count;
+  uint8_t head;
+  bool has_out;
+  int16_t out;              // última saída: repetida quando a leitura é rejeitada
+  int32_t ema_q8;           // EMA em décimos * 256
+  uint32_t samples;
+  uint32_t rejected;
+} sample_filter_t;
+
+void sample_filter_reset(sample_filter_t *filter);
+
+// Passa uma leitura pelo filtro. Devolve false se ela foi rejeitada; nesse caso *value recebe a última
+// saída aceita. Senão *value recebe a saída (leitura, mediana e/ou EMA).
+bool sample_filter_apply(sample_filter_t *filter, const sample_filter_config_t *cfg, int16_t *value);
+
+// Mediana de n valores (n <= SAMPLE_FILTER_MAX_WINDOW); para n par, o menor dos dois centrais
+int16_t sample_filter_median(const int16_t *values, uint8_t n);
+
+#endif // SAMPLE_FILTER_H
@@ -0,0 +1,116 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "app_publish.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "publisher.h"
+#include "sample_seq.h"
+
+typedef struct {
+  uint32_t seq;
+  uint8_t metric;
+  int16_t value;
+} seq_entry_t;
+
+static const char *TAG_SEQ = "MQTT";
+
+static SemaphoreHandle_t s_lock = NULL;
+static const char *const *s_topics = NULL;
+static uint8_t s_num_topics = 0;
+static uint32_t s_epoch = 0;
+static uint32_t s_seq = 0;   // último número usado; o primeiro publicado é 1
+static seq_entry_t s_ring[SAMPLE_SEQ_RING_SIZE];
+
+static int format_sample(char *buf, size_t len, uint32_t seq, int16_t value)
+{
+  char tenths[APP_TENTHS_MAX_LEN];
+  app_format_tenths(value, tenths);
+  return snprintf(buf, len, "%" PRIu32 ",%" PRIu32 ",%s", s_epoch, seq, tenths);
+}
+
+void sample_seq_init(uint32_t boot_epoch, const char *const *topics, uint8_t num_topics)
+{
+  if (s_lock == NULL) {
+    s_lock = xSemaphoreCreateMutex();
+  }
+  s_epoch = boot_epoch;
+  s_topics = topics;
+  s_num_topics = num_topics;
+}
+
+int sample_seq_publish(uint8_t metric, int16_t value, const app_stamps_t *stamps)
+{
+  char msg[40 + APP_STAMPS_MAX_LEN];
+
+  if (s_lock == NULL || metric >= s_num_topics) return -1;
+
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  uint32_t seq = ++s_seq;
+  s_ring[seq % SAMPLE_SEQ_RING_SIZE] = (seq_entry_t) { .seq = seq, .metric = metric, .value = value };
+  xSemaphoreGive(s_lock);
+
+  int len = format_sample(msg, sizeof(msg), seq, value);
+  if (stamps) len = app_append_stamps(msg, sizeof(msg), len, stamps);
+  return publisher_publish(s_topics[metric], msg, len, 0, 0);
+}
+
+void sample_seq_handle_nack(const char *data, int len)
+{
+  char buf[48];
+  char msg[40];
+  uint32_t epoch, from, to;
+
+  if (s_lock == NULL || len <= 0 || len >= (int)sizeof(buf)) return;
+  memcpy(buf, data, len);
+  buf[len] = '\0';
+
+  if (sscanf(buf, "%" SCNu32 ",%" SCNu32 ",%" SCNu32, &epoch, &from, &to) != 3 || from > to) {
+    ESP_LOGW(TAG_SEQ, "NACK inválido: %s", buf);
+    return;
+  }
+
+  // Pedido de outro boot: as amostras daquela época não existem mais
+  if (epoch != s_epoch) {
+    ESP_LOGW(TAG_SEQ, "NACK para época %" PRIu32 " ignorado (atual %" PRIu32 ")", epoch, s_epoch);
+    return;
+  }
+
+  // Só existe o que já foi publicado: pedido além da última sequência é lixo ou de outro dispositivo
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  uint32_t last = s_seq;
+  xSemaphoreGive(s_lock);
+  if (from == 0 || from > last) {
+    ESP_LOGW(TAG_SEQ, "NACK [%" PRIu32 ", %" PRIu32 "] fora do publicado (última %" PRIu32 ")", from, to, last);
+    return;
+  }
+  if (to > last) to = last;
+  if (to - from >= SAMPLE_SEQ_RESEND_MAX) {
+    to = from + SAMPLE_SEQ_RESEND_MAX - 1;
+  }
+
+  // Laço por contagem: com to == UINT32_MAX, seq <= to nunca ficaria falso
+  uint32_t resent = 0;
+  for (uint32_t i = 0; i <= to - from; i++) {
+    uint32_t seq = from + i;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    seq_entry_t entry = s_ring[seq % SAMPLE_SEQ_RING_SIZE];
+    xSemaphoreGive(s_lock);
+
+    // Já sobrescrita no anel (ou ainda não publicada)
+    if (entry.seq != seq) continue;
+
+    int n = format_sample(msg, sizeof(msg), seq, entry.value);
+    if (publisher_publish(s_topics[entry.metric], msg, n, 0, 0) >= 0) {
+      resent++;
+    }
+  }
+
+  ESP_LOGI(TAG_SEQ, "NACK [%" PRIu32 ", %" PRIu32 "]: %" PRIu32 " amostras reenviadas", from, to, resent);
+}
+
+uint32_t sample_seq_last(void)
+{
+  return s_seq;
+}
@@ -0,0 +1,30 @@
+#ifndef SAMPLE_SEQ_H
+#define SAMPLE_SEQ_H
+
+#include <stdint.h>
+#include "app_publish.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// PUBLICAÇÃO QoS 0 COM NÚMERO DE SEQUÊNCIA
+//
+// Cada amostra sai em QoS 0 como "<epoch>,<seq>,<valor>", onde epoch é o contador de boots guardado
+// no NVS e seq cresce a cada publicação. Quem consome detecta perdas e reordenação pelos buracos na
+// sequência e pode pedir reenvio publicando "<epoch>,<de>,<até>" em <mac>/nack; as últimas amostras
+// ficam num anel em RAM para isso.
+// -----------------------------------------------------------------------------------------------------------
+
+#define SAMPLE_SEQ_RING_SIZE   256
+#define SAMPLE_SEQ_RESEND_MAX  64    // limite de amostras reenviadas por NACK
+
+void sample_seq_init(uint32_t boot_epoch, const char *const *topics, uint8_t num_topics);
+
+// Publica o valor (décimos) no tópico de índice 'metric', com os carimbos se stamps != NULL (reenvios
+// por NACK saem sem eles); devolve o msg_id ou -1
+int sample_seq_publish(uint8_t metric, int16_t value, const app_stamps_t *stamps);
+
+// Trata uma mensagem recebida em <mac>/nack
+void sample_seq_handle_nack(const char *data, int len);
+
+uint32_t sample_seq_last(void);
+
+#endif // SAMPLE_SEQ_H
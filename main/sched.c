@@ -0,0 +1,176 @@
+#include <stdbool.h>
+#include <string.h>
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sched.h"
+
+static const char *TAG_SCHED = "SCHED";
+
+ESP_EVENT_DEFINE_BASE(SCHED_EVENT);
+
+typedef struct {
+  uint32_t gen;
+  int64_t fired_us;
+} sched_fire_t;
+
+struct sched_job {
+  const char *name;
+  sched_fn_t fn;
+  void *arg;
+  esp_timer_handle_t timer;
+  volatile uint32_t gen;      // muda a cada (re)agendamento: disparos antigos ainda na fila são descartados
+  volatile bool queued;
+  uint32_t period_ms;
+  uint32_t runs;
+  uint32_t coalesced;
+  uint64_t latency_sum_us;
+  uint32_t latency_max_us;
+  uint64_t run_sum_us;
+  uint32_t run_max_us;
+};
+
+static esp_event_loop_handle_t s_loop = NULL;
+static sched_job_t s_jobs[SCHED_MAX_JOBS];
+static size_t s_num_jobs = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// -----------------------------------------------------------------------------------------------------------
+// DISPARO E EXECUÇÃO
+// -----------------------------------------------------------------------------------------------------------
+
+// Task do esp_timer: só posta, sem bloquear
+static void sched_timer_cb(void *arg)
+{
+  sched_job_t *job = arg;
+  sched_fire_t fire = { .gen = job->gen, .fired_us = esp_timer_get_time() };
+
+  if (job->queued) {
+    job->coalesced++;
+    return;
+  }
+  job->queued = true;
+  if (esp_event_post_to(s_loop, SCHED_EVENT, job - s_jobs, &fire, sizeof(fire), 0) != ESP_OK) {
+    job->queued = false;
+    ESP_LOGW(TAG_SCHED, "Fila cheia: disparo de %s perdido", job->name);
+  }
+}
+
+static void sched_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+  sched_job_t *job = &s_jobs[event_id];
+  const sched_fire_t *fire = event_data;
+
+  // Reagendado ou parado depois do disparo
+  if (fire->gen != job->gen) return;
+  job->queued = false;
+
+  int64_t start_us = esp_timer_get_time();
+  job->fn(job->arg);
+  int64_t end_us = esp_timer_get_time();
+
+  uint32_t latency_us = start_us - fire->fired_us;
+  uint32_t run_us = end_us - start_us;
+  portENTER_CRITICAL(&s_lock);
+  job->runs++;
+  job->latency_sum_us += latency_us;
+  if (latency_us > job->latency_max_us) job->latency_max_us = latency_us;
+  job->run_sum_us += run_us;
+  if (run_us > job->run_max_us) job->run_max_us = run_us;
+  portEXIT_CRITICAL(&s_lock);
+}
+
+static void sched_rearm(sched_job_t *job, uint32_t period_ms)
+{
+  esp_timer_stop(job->timer);
+  portENTER_CRITICAL(&s_lock);
+  job->gen++;
+  job->queued = false;
+  job->period_ms = period_ms;
+  portEXIT_CRITICAL(&s_lock);
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// API
+// -----------------------------------------------------------------------------------------------------------
+
+esp_err_t sched_init(UBaseType_t priority, BaseType_t core)
+{
+  esp_event_loop_args_t args = {
+    .queue_size = SCHED_QUEUE_SIZE,
+    .task_name = "sched",
+    .task_priority = priority,
+    .task_stack_size = SCHED_TASK_STACK,
+    .task_core_id = core,
+  };
+
+  esp_err_t err = esp_event_loop_create(&args, &s_loop);
+  if (err != ESP_OK) return err;
+  return esp_event_handler_register_with(s_loop, SCHED_EVENT, ESP_EVENT_ANY_ID, sched_event_handler, NULL);
+}
+
+sched_job_t *sched_job_create(const char *name, sched_fn_t fn, void *arg)
+{
+  if (s_loop == NULL || s_num_jobs >= SCHED_MAX_JOBS) {
+    ESP_LOGE(TAG_SCHED, "Sem espaço para o trabalho %s", name);
+    return NULL;
+  }
+
+  sched_job_t *job = &s_jobs[s_num_jobs];
+  memset(job, 0, sizeof(*job));
+  job->name = name;
+  job->fn = fn;
+  job->arg = arg;
+
+  const esp_timer_create_args_t timer_args = {
+    .callback = sched_timer_cb,
+    .arg = job,
+    .name = name,
+  };
+  if (esp_timer_create(&timer_args, &job->timer) != ESP_OK) return NULL;
+
+  s_num_jobs++;
+  return job;
+}
+
+esp_err_t sched_job_start_periodic(sched_job_t *job, uint32_t period_ms)
+{
+  if (job == NULL) return ESP_ERR_INVALID_ARG;
+  sched_rearm(job, period_ms);
+  return esp_timer_start_periodic(job->timer, (uint64_t)(period_ms ? period_ms : 1) * 1000);
+}
+
+esp_err_t sched_job_start_once(sched_job_t *job, uint32_t delay_ms)
+{
+  if (job == NULL) return ESP_ERR_INVALID_ARG;
+  sched_rearm(job, 0);
+  return esp_timer_start_once(job->timer, (uint64_t)delay_ms * 1000);
+}
+
+void sched_job_stop(sched_job_t *job)
+{
+  if (job == NULL) return;
+  sched_rearm(job, 0);
+}
+
+size_t sched_get_stats(sched_job_stats_t *stats, size_t max)
+{
+  size_t n = s_num_jobs < max ? s_num_jobs : max;
+
+  portENTER_CRITICAL(&s_lock);
+  for (size_t i = 0; i < n; i++) {
+    const sched_job_t *job = &s_jobs[i];
+    stats[i] = (sched_job_stats_t) {
+      .name = job->name,
+      .period_ms = job->period_ms,
+      .runs = job->runs,
+      .coalesced = job->coalesced,
+      .latency_avg_us = job->runs ? (uint32_t)(job->latency_sum_us / job->runs) : 0,
+      .latency_max_us = job->latency_max_us,
+      .run_avg_us = job->runs ? (uint32_t)(job->run_sum_us / job->runs) : 0,
+      .run_max_us = job->run_max_us,
+    };
+  }
+  portEXIT_CRITICAL(&s_lock);
+  return n;
+}
@@ -0,0 +1,57 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// AGENDADOR COOPERATIVO
+//
+// Trabalhos periódicos e avulsos que antes tinham task própria (botão de reset, pisca do AP, aquisição)
+// viram callbacks num único loop esp_event dedicado: uma task, uma pilha. O esp_timer de cada trabalho
+// só posta o evento; a callback roda na task do loop, uma de cada vez, e não pode dormir. Quem precisa
+// esperar se reagenda com sched_job_start_once() e guarda o estado entre execuções (máquina de estados);
+// gravação na flash e publicações vão para a task de saída (worker.h). A exceção é a leitura do DHT, que
+// ocupa o loop pelos ~25 ms do protocolo.
+// Disparos que chegam com o trabalho ainda na fila são fundidos num só.
+//
+// Por trabalho são medidos execuções, atraso do disparo do timer até a callback começar e duração
+// (GET /api/jobs).
+// -----------------------------------------------------------------------------------------------------------
+
+#define SCHED_MAX_JOBS      12     // 8 em uso (7 no main.c, bench_sensor na console)
+#define SCHED_TASK_STACK    4096   // a aquisição lê o sensor, formata as mensagens e loga com float
+#define SCHED_QUEUE_SIZE    16
+
+typedef struct sched_job sched_job_t;
+typedef void (*sched_fn_t)(void *arg);
+
+typedef struct {
+  const char *name;
+  uint32_t period_ms;         // 0 = avulso
+  uint32_t runs;
+  uint32_t coalesced;         // disparos fundidos porque o anterior ainda não tinha rodado
+  uint32_t latency_avg_us;    // disparo do timer -> início da callback
+  uint32_t latency_max_us;
+  uint32_t run_avg_us;
+  uint32_t run_max_us;
+} sched_job_stats_t;
+
+// Cria o loop e sua task; chamar uma vez, antes de qualquer outro sched_*
+esp_err_t sched_init(UBaseType_t priority, BaseType_t core);
+
+// Registra um trabalho parado; NULL se a tabela estiver cheia
+sched_job_t *sched_job_create(const char *name, sched_fn_t fn, void *arg);
+
+// (Re)arma o trabalho; substitui o agendamento anterior. Podem ser chamadas de qualquer task e de
+// dentro da própria callback.
+esp_err_t sched_job_start_periodic(sched_job_t *job, uint32_t period_ms);
+esp_err_t sched_job_start_once(sched_job_t *job, uint32_t delay_ms);
+void sched_job_stop(sched_job_t *job);
+
+// Devolve quantos trabalhos foram copiados para stats
+size_t sched_get_stats(sched_job_stats_t *stats, size_t max);
+
+#endif // SCHED_H
@@ -0,0 +1,306 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "sensor.h"
+
+// Escolha do menuconfig (main/Kconfig.projbuild)
+#define SENSOR_BACKEND_DHT        0
+#define SENSOR_BACKEND_SYNTHETIC  1
+#define SENSOR_BACKEND_REPLAY     2
+
+#if defined(CONFIG_SENSOR_BACKEND_SYNTHETIC)
+#define SENSOR_BACKEND            SENSOR_BACKEND_SYNTHETIC
+#elif defined(CONFIG_SENSOR_BACKEND_REPLAY)
+#define SENSOR_BACKEND            SENSOR_BACKEND_REPLAY
+#else
+#define SENSOR_BACKEND            SENSOR_BACKEND_DHT
+#endif
+
+#if SENSOR_BACKEND == SENSOR_BACKEND_DHT
+#include "dht.h"
+#elif CONFIG_FREERTOS_HZ < 1000
+#warning "Backend rápido do sensor com tick de 100 Hz: ver sdkconfig.defaults.fast"
+#endif
+
+static const char *TAG_SENSOR = "Sensor";
+
+static uint32_t s_reads = 0;
+static uint32_t s_failures = 0;
+static sensor_fault_t s_last_fault = SENSOR_FAULT_OTHER;
+static int64_t s_last_read_us = 0;
+
+static const char *const fault_names[SENSOR_FAULTS] = {
+  [SENSOR_FAULT_PHASE_B] = "B",
+  [SENSOR_FAULT_PHASE_C] = "C",
+  [SENSOR_FAULT_PHASE_D] = "D",
+  [SENSOR_FAULT_BITS] = "bits",
+  [SENSOR_FAULT_CRC] = "crc",
+  [SENSOR_FAULT_TIMEOUT] = "timeout",
+  [SENSOR_FAULT_OTHER] = "outro",
+};
+
+// -----------------------------------------------------------------------------------------------------------
+// DHT
+// -----------------------------------------------------------------------------------------------------------
+
+#if SENSOR_BACKEND == SENSOR_BACKEND_DHT
+
+static const char *const backend_name = "dht";
+
+static uint32_t s_awaits = 0;
+static sensor_fault_t s_timeout_fault = SENSOR_FAULT_TIMEOUT;
+
+// O dht.c é compilado com gpio_set_direction trocado por esta função (main/CMakeLists.txt). Cada espera
+// de dht_await_pin_state() começa pondo o pino como entrada: a 1ª é a fase B, a 2ª a C, a 3ª a D e as
+// seguintes os 40 bits. Roda dentro da seção crítica da leitura, então só conta.
+esp_err_t sensor_dht_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+  if (mode == GPIO_MODE_INPUT) s_awaits++;
+  return gpio_set_direction(gpio_num, mode);
+}
+
+static esp_err_t backend_init(void)
+{
+  return ESP_OK;
+}
+
+// Num timeout, a espera em que a leitura parou diz a fase
+static esp_err_t backend_read(int16_t *temperatura, int16_t *umidade)
+{
+  s_awaits = 0;
+  esp_err_t err = dht_read_data(SENSOR_TYPE, SENSOR_GPIO, umidade, temperatura);
+  if (s_awaits == 0) {
+    s_timeout_fault = SENSOR_FAULT_TIMEOUT;
+  } else if (s_awaits <= 3) {
+    s_timeout_fault = SENSOR_FAULT_PHASE_B + (s_awaits - 1);
+  } else {
+    s_timeout_fault = SENSOR_FAULT_BITS;
+  }
+  return err;
+}
+
+static sensor_fault_t backend_timeout_fault(void)
+{
+  return s_timeout_fault;
+}
+
+uint32_t sensor_min_interval_ms(void)
+{
+  return SENSOR_DHT_MIN_INTERVAL_MS;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// SINTÉTICO
+// -----------------------------------------------------------------------------------------------------------
+
+#elif SENSOR_BACKEND == SENSOR_BACKEND_SYNTHETIC
+
+#define SENSOR_WAVE_SINE          0
+#define SENSOR_WAVE_SQUARE        1
+#define SENSOR_WAVE_RAMP          2
+#define SENSOR_WAVE_STEP          3       // degrau na metade de cada período
+
+#if defined(CONFIG_SENSOR_SYNTH_WAVE_SQUARE)
+#define SENSOR_SYNTH_WAVE         SENSOR_WAVE_SQUARE
+#elif defined(CONFIG_SENSOR_SYNTH_WAVE_RAMP)
+#define SENSOR_SYNTH_WAVE         SENSOR_WAVE_RAMP
+#elif defined(CONFIG_SENSOR_SYNTH_WAVE_STEP)
+#define SENSOR_SYNTH_WAVE         SENSOR_WAVE_STEP
+#else
+#define SENSOR_SYNTH_WAVE         SENSOR_WAVE_SINE
+#endif
+
+// Décimos, como as leituras
+#define SENSOR_SYNTH_PERIOD_MS    CONFIG_SENSOR_SYNTH_PERIOD_MS
+#define SENSOR_SYNTH_T_BASE       (CONFIG_SENSOR_SYNTH_T_BASE)
+#define SENSOR_SYNTH_T_AMPLITUDE  CONFIG_SENSOR_SYNTH_T_AMPLITUDE
+#define SENSOR_SYNTH_U_BASE       CONFIG_SENSOR_SYNTH_U_BASE
+#define SENSOR_SYNTH_U_AMPLITUDE  CONFIG_SENSOR_SYNTH_U_AMPLITUDE
+#define SENSOR_SYNTH_NOISE        CONFIG_SENSOR_SYNTH_NOISE
+#define SENSOR_SYNTH_FAIL_PERMILLE CONFIG_SENSOR_SYNTH_FAIL_PERMILLE
+
+static const char *const backend_name = "synthetic";
+
+static uint32_t s_rng = 0x2545f491;
+
+// xorshift32: determinístico entre execuções, para comparar uma rodada com a outra
+static uint32_t rng_next(void)
+{
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng;
+}
+
+static int16_t noise(void)
+{
+  if (SENSOR_SYNTH_NOISE == 0) return 0;
+  return (int16_t)(rng_next() % (2 * SENSOR_SYNTH_NOISE + 1)) - SENSOR_SYNTH_NOISE;
+}
+
+// Forma de onda normalizada em [-1, 1]
+static float wave(uint32_t t_ms)
+{
+  float phase = (float)(t_ms % SENSOR_SYNTH_PERIOD_MS) / SENSOR_SYNTH_PERIOD_MS;
+
+  switch (SENSOR_SYNTH_WAVE) {
+  case SENSOR_WAVE_SQUARE:
+    return phase < 0.5f ? 1.0f : -1.0f;
+  case SENSOR_WAVE_RAMP:
+    return 2.0f * phase - 1.0f;
+  case SENSOR_WAVE_STEP:
+    return phase < 0.5f ? 0.0f : 1.0f;
+  default:
+    return sinf(2.0f * (float)M_PI * phase);
+  }
+}
+
+static esp_err_t backend_init(void)
+{
+  return ESP_OK;
+}
+
+static sensor_fault_t backend_timeout_fault(void)
+{
+  return SENSOR_FAULT_TIMEOUT;
+}
+
+static esp_err_t backend_read(int16_t *temperatura, int16_t *umidade)
+{
+#if SENSOR_SYNTH_FAIL_PERMILLE > 0
+  if (rng_next() % 1000 < SENSOR_SYNTH_FAIL_PERMILLE) {
+    return ESP_ERR_TIMEOUT;
+  }
+#endif
+
+  float w = wave((uint32_t)(esp_timer_get_time() / 1000));
+  *temperatura = SENSOR_SYNTH_T_BASE + (int16_t)lroundf(w * SENSOR_SYNTH_T_AMPLITUDE) + noise();
+  *umidade = SENSOR_SYNTH_U_BASE + (int16_t)lroundf(w * SENSOR_SYNTH_U_AMPLITUDE) + noise();
+  return ESP_OK;
+}
+
+uint32_t sensor_min_interval_ms(void)
+{
+  return SENSOR_FAST_MIN_INTERVAL_MS;
+}
+
+// -----------------------------------------------------------------------------------------------------------
+// REPLAY
+// -----------------------------------------------------------------------------------------------------------
+
+#elif SENSOR_BACKEND == SENSOR_BACKEND_REPLAY
+
+static const char *const backend_name = "replay";
+
+// Embutido via EMBED_TXTFILES (terminado em '\0')
+extern const char replay_csv_start[] asm("_binary_replay_csv_start");
+extern const char replay_csv_end[] asm("_binary_replay_csv_end");
+
+static const char *s_cursor = NULL;
+
+static esp_err_t backend_init(void)
+{
+  s_cursor = replay_csv_start;
+  ESP_LOGI(TAG_SENSOR, "Replay de %u bytes", (unsigned)(replay_csv_end - replay_csv_start));
+  return ESP_OK;
+}
+
+static sensor_fault_t backend_timeout_fault(void)
+{
+  return SENSOR_FAULT_TIMEOUT;
+}
+
+// Uma linha "temperatura,umidade" por leitura; comentários (#) e linhas vazias são pulados e o traço
+// recomeça do início quando acaba
+static esp_err_t backend_read(int16_t *temperatura, int16_t *umidade)
+{
+  for (int wrapped = 0; wrapped < 2; ) {
+    if (*s_cursor == '\0') {
+      s_cursor = replay_csv_start;
+      wrapped++;
+      continue;
+    }
+
+    const char *line = s_cursor;
+    while (*s_cursor != '\0' && *s_cursor != '\n') s_cursor++;
+    if (*s_cursor == '\n') s_cursor++;
+
+    if (*line == '#' || *line == '\n' || *line == '\r') continue;
+
+    char *end;
+    long t = strtol(line, &end, 10);
+    if (*end != ',') continue;
+    long u = strtol(end + 1, &end, 10);
+    *temperatura = (int16_t)t;
+    *umidade = (int16_t)u;
+    return ESP_OK;
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+uint32_t sensor_min_interval_ms(void)
+{
+  return SENSOR_FAST_MIN_INTERVAL_MS;
+}
+
+#else
+#error "SENSOR_BACKEND desconhecido"
+#endif
+
+// -----------------------------------------------------------------------------------------------------------
+// API
+// -----------------------------------------------------------------------------------------------------------
+
+esp_err_t sensor_init(void)
+{
+  ESP_LOGI(TAG_SENSOR, "Backend: %s (intervalo mínimo %" PRIu32 " ms)", backend_name, sensor_min_interval_ms());
+  return backend_init();
+}
+
+esp_err_t sensor_read(int16_t *temperatura, int16_t *umidade)
+{
+  s_reads++;
+  esp_err_t err = backend_read(temperatura, umidade);
+  s_last_read_us = esp_timer_get_time();
+  if (err != ESP_OK) {
+    s_failures++;
+    if (err == ESP_ERR_TIMEOUT) {
+      s_last_fault = backend_timeout_fault();
+    } else if (err == ESP_ERR_INVALID_CRC) {
+      s_last_fault = SENSOR_FAULT_CRC;
+    } else {
+      s_last_fault = SENSOR_FAULT_OTHER;
+    }
+  }
+  return err;
+}
+
+uint32_t sensor_ready_in_ms(void)
+{
+  if (s_last_read_us == 0) return 0;
+  int64_t elapsed_ms = (esp_timer_get_time() - s_last_read_us) / 1000;
+  uint32_t min_ms = sensor_min_interval_ms();
+  return elapsed_ms >= min_ms ? 0 : min_ms - (uint32_t)elapsed_ms;
+}
+
+sensor_fault_t sensor_last_fault(void)
+{
+  return s_last_fault;
+}
+
+const char *sensor_fault_name(sensor_fault_t fault)
+{
+  return fault < SENSOR_FAULTS ? fault_names[fault] : "?";
+}
+
+void sensor_get_stats(sensor_stats_t *stats)
+{
+  stats->backend = backend_name;
+  stats->reads = s_reads;
+  stats->failures = s_failures;
+}
@@ -0,0 +1,60 @@
+#ifndef SENSOR_H
+#define SENSOR_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// SENSOR
+//
+// Camada entre a aquisição e a origem dos dados. O backend DHT lê o AM2301 de verdade; o sintético gera
+// formas de onda com ruído e o replay repete um traço embutido no firmware (main/traces/replay.csv).
+// Os dois últimos não têm o limite de 2 s do AM2301 e alimentam o pipeline inteiro (alarmes, agregação,
+// publicação, outbox) a 100+ Hz, sem hardware, na placa ou no QEMU.
+//
+// O backend e os parâmetros do sinal sintético vêm do menuconfig ("Sensor", main/Kconfig.projbuild).
+// sdkconfig.defaults.fast escolhe o sintético e liga o tick de 1 ms; para o replay, trocar a escolha lá:
+//
+//   idf.py -D SDKCONFIG_DEFAULTS="sdkconfig.defaults;sdkconfig.defaults.fast" build
+// -----------------------------------------------------------------------------------------------------------
+
+// DHT
+#define SENSOR_TYPE               DHT_TYPE_AM2301
+#define SENSOR_GPIO               33
+#define SENSOR_DHT_MIN_INTERVAL_MS 2000   // AM2301 não aceita leituras mais rápidas
+
+// Sintético e replay
+#define SENSOR_FAST_MIN_INTERVAL_MS 5
+
+// Causa da última falha de leitura. O dht.c não devolve a fase em que o timeout aconteceu; o backend DHT
+// conta as esperas pelo pino em sensor_dht_set_direction (o componente é compilado com
+// gpio_set_direction trocado por ela, ver main/CMakeLists.txt) e deduz a fase de quantas já começaram.
+typedef enum {
+  SENSOR_FAULT_PHASE_B = 0,       // sensor não respondeu ao pulso de início: sem alimentação, fio solto
+  SENSOR_FAULT_PHASE_C,           // resposta de início incompleta
+  SENSOR_FAULT_PHASE_D,
+  SENSOR_FAULT_BITS,              // timeout no meio dos 40 bits: ruído na linha, interrupção longa
+  SENSOR_FAULT_CRC,               // quadro completo com checksum errado
+  SENSOR_FAULT_TIMEOUT,           // timeout sem fase conhecida
+  SENSOR_FAULT_OTHER,
+  SENSOR_FAULTS,
+} sensor_fault_t;
+
+typedef struct {
+  const char *backend;
+  uint32_t reads;
+  uint32_t failures;
+} sensor_stats_t;
+
+esp_err_t sensor_init(void);
+// Mesma convenção de dht_read_data(): décimos de °C e de %
+esp_err_t sensor_read(int16_t *temperatura, int16_t *umidade);
+uint32_t sensor_min_interval_ms(void);
+// Quanto falta para o intervalo mínimo desde a última leitura (de quem quer que seja); 0 = pode ler
+uint32_t sensor_ready_in_ms(void);
+// Válido depois de um sensor_read() que falhou
+sensor_fault_t sensor_last_fault(void);
+const char *sensor_fault_name(sensor_fault_t fault);
+void sensor_get_stats(sensor_stats_t *stats);
+
+#endif // SENSOR_H
@@ -0,0 +1,88 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "sensor_health.h"
+
+static const char *const state_names[] = {
+  [SENSOR_HEALTH_OK] = "ok",
+  [SENSOR_HEALTH_RETRYING] = "repetindo",
+  [SENSOR_HEALTH_DEGRADED] = "degradado",
+};
+
+const char *sensor_health_state_name(sensor_health_state_t state)
+{
+  return state <= SENSOR_HEALTH_DEGRADED ? state_names[state] : "?";
+}
+
+void sensor_health_reset(sensor_health_t *health)
+{
+  memset(health, 0, sizeof(*health));
+  health->state = SENSOR_HEALTH_OK;
+  health->last_fault = SENSOR_FAULT_OTHER;
+}
+
+uint32_t sensor_health_record(sensor_health_t *health, bool ok, sensor_fault_t fault, uint32_t interval_ms,
+                              uint32_t min_interval_ms)
+{
+  health->reads++;
+  health->recent = (health->recent << 1) | (ok ? 1 : 0);
+  if (health->recent_count < 32) health->recent_count++;
+
+  if (ok) {
+    health->successes++;
+    health->consecutive = 0;
+    health->backoff_ms = 0;
+    health->state = SENSOR_HEALTH_OK;
+    return interval_ms;
+  }
+
+  if (fault >= SENSOR_FAULTS) fault = SENSOR_FAULT_OTHER;
+  health->faults[fault]++;
+  health->last_fault = fault;
+  health->consecutive++;
+
+  // Falha isolada: tenta de novo assim que o sensor aceitar, nunca depois do intervalo normal
+  if (health->consecutive <= SENSOR_HEALTH_RETRIES) {
+    health->state = SENSOR_HEALTH_RETRYING;
+    health->retries++;
+    return min_interval_ms < interval_ms ? min_interval_ms : interval_ms;
+  }
+
+  if (health->state != SENSOR_HEALTH_DEGRADED) {
+    health->state = SENSOR_HEALTH_DEGRADED;
+    health->degraded++;
+  }
+
+  // Degradado: dobra a cada falha a partir do intervalo normal, sem ler mais devagar que o teto
+  // (a não ser que o próprio intervalo normal já passe dele)
+  uint32_t shift = health->consecutive - SENSOR_HEALTH_RETRIES - 1;
+  uint64_t delay = shift < 32 ? (uint64_t)interval_ms << shift : UINT64_MAX;
+  if (delay > SENSOR_HEALTH_BACKOFF_MAX_MS) delay = SENSOR_HEALTH_BACKOFF_MAX_MS;
+  if (delay < interval_ms) delay = interval_ms;
+  health->backoff_ms = (uint32_t)delay;
+  return health->backoff_ms;
+}
+
+uint32_t sensor_health_recent_permille(const sensor_health_t *health)
+{
+  if (health->recent_count == 0) return 1000;
+
+  uint32_t mask = health->recent_count < 32 ? (1u << health->recent_count) - 1 : UINT32_MAX;
+  uint32_t bits = health->recent & mask;
+  uint32_t ok = 0;
+  for (; bits; bits &= bits - 1) ok++;
+  return ok * 1000 / health->recent_count;
+}
+
+int sensor_health_format(const sensor_health_t *health, char *buf, size_t len)
+{
+  const uint32_t *f = health->faults;
+  return snprintf(buf, len, "{\"estado\":\"%s\",\"n\":%" PRIu32 ",\"ok\":%" PRIu32 ",\"recente\":%" PRIu32
+                  ",\"seguidas\":%" PRIu32 ",\"retries\":%" PRIu32 ",\"degradado\":%" PRIu32 ",\"backoff_ms\":%" PRIu32
+                  ",\"falhas\":{\"B\":%" PRIu32 ",\"C\":%" PRIu32 ",\"D\":%" PRIu32 ",\"bits\":%" PRIu32
+                  ",\"crc\":%" PRIu32 ",\"timeout\":%" PRIu32 ",\"outro\":%" PRIu32 "}}",
+                  sensor_health_state_name(health->state), health->reads, health->successes,
+                  sensor_health_recent_permille(health), health->consecutive, health->retries, health->degraded,
+                  health->backoff_ms, f[SENSOR_FAULT_PHASE_B], f[SENSOR_FAULT_PHASE_C], f[SENSOR_FAULT_PHASE_D],
+                  f[SENSOR_FAULT_BITS], f[SENSOR_FAULT_CRC], f[SENSOR_FAULT_TIMEOUT], f[SENSOR_FAULT_OTHER]);
+}
@@ -0,0 +1,63 @@
+#ifndef SENSOR_HEALTH_H
+#define SENSOR_HEALTH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sensor.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// SAÚDE DO SENSOR
+//
+// Decide quando ler de novo depois de uma falha. Uma falha isolada do AM2301 costuma passar na leitura
+// seguinte, então ela é repetida assim que o intervalo mínimo do sensor permite, em vez de esperar o
+// intervalo inteiro do amostrador. Depois de SENSOR_HEALTH_RETRIES repetições sem sucesso o sensor é
+// considerado degradado: as tentativas passam a ser espaçadas por backoff exponencial, até
+// SENSOR_HEALTH_BACKOFF_MAX_MS, e a primeira leitura boa volta ao normal.
+//
+// Também guarda o histograma de falhas por causa (sensor_fault_t) e o resultado das últimas 32
+// leituras, publicados em <mac>/sensor e em /api/stats.
+// -----------------------------------------------------------------------------------------------------------
+
+#define SENSOR_HEALTH_RETRIES         2
+#define SENSOR_HEALTH_BACKOFF_MAX_MS  120000
+#define SENSOR_HEALTH_REPORT_MS       600000   // telemetria periódica, além das mudanças de estado
+#define SENSOR_HEALTH_JSON_MAX_LEN    288
+
+typedef enum {
+  SENSOR_HEALTH_OK = 0,
+  SENSOR_HEALTH_RETRYING,       // falhou, repetindo no intervalo mínimo
+  SENSOR_HEALTH_DEGRADED,       // repetições esgotadas, em backoff
+} sensor_health_state_t;
+
+typedef struct {
+  sensor_health_state_t state;
+  uint32_t reads;
+  uint32_t successes;
+  uint32_t retries;             // leituras feitas fora do ritmo do amostrador
+  uint32_t degraded;            // entradas no estado degradado
+  uint32_t consecutive;         // falhas seguidas
+  uint32_t recent;              // bit 0 = última leitura; 1 = sucesso
+  uint8_t recent_count;
+  uint32_t backoff_ms;          // último atraso de backoff, 0 fora do degradado
+  sensor_fault_t last_fault;
+  uint32_t faults[SENSOR_FAULTS];
+} sensor_health_t;
+
+void sensor_health_reset(sensor_health_t *health);
+
+// Registra o resultado de uma leitura (fault é ignorado se ok) e devolve em quantos ms ler de novo.
+// interval_ms é o intervalo normal (amostrador) e min_interval_ms o piso do sensor.
+uint32_t sensor_health_record(sensor_health_t *health, bool ok, sensor_fault_t fault, uint32_t interval_ms,
+                              uint32_t min_interval_ms);
+
+// Sucessos entre as últimas 32 leituras, em milésimos
+uint32_t sensor_health_recent_permille(const sensor_health_t *health);
+
+const char *sensor_health_state_name(sensor_health_state_t state);
+
+// {"estado":..,"n":..,"ok":..,"recente":..,"seguidas":..,"retries":..,"degradado":..,"backoff_ms":..,
+//  "falhas":{"B":..,"C":..,...}}; devolve o tamanho como snprintf
+int sensor_health_format(const sensor_health_t *health, char *buf, size_t len);
+
+#endif // SENSOR_HEALTH_H
@@ -0,0 +1,188 @@
+#include <inttypes.h>
+#include <string.h>
+#include "esp_crt_bundle.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/ssl.h"
+#include "tls_profile.h"
+
+static const char *TAG_TLS = "TLS";
+
+static uint32_t s_handshakes = 0;
+static uint32_t s_last_ms = 0;
+static uint32_t s_min_ms = UINT32_MAX;
+static uint32_t s_max_ms = 0;
+static uint32_t s_heap_peak = 0;
+static uint32_t s_heap_session = 0;
+
+static int64_t s_connect_us = 0;
+static size_t s_free_before = 0;
+
+// -----------------------------------------------------------------------------------------------------------
+// PERFIL FIXADO
+// -----------------------------------------------------------------------------------------------------------
+
+#if TLS_PROFILE == TLS_PROFILE_PINNED
+
+#ifndef TLS_PINNED_SPKI_SHA256
+#error "TLS_PROFILE_PINNED exige TLS_PINNED_SPKI_SHA256 (ver tls_profile.h)"
+#endif
+
+static const uint8_t s_pins[][32] = { TLS_PINNED_SPKI_SHA256 };
+
+// Cadeia de CAs vazia: o mbedTLS recusa VERIFY_REQUIRED sem nenhuma (MBEDTLS_ERR_SSL_CA_CHAIN_REQUIRED)
+static mbedtls_x509_crt s_empty_ca;
+
+static const int s_ciphersuites[] = {
+  MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+  MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+  0
+};
+
+static bool spki_pinned(mbedtls_x509_crt *crt)
+{
+  // mbedtls_pk_write_pubkey_der escreve no fim do buffer
+  unsigned char der[TLS_SPKI_DER_MAX];
+  int len = mbedtls_pk_write_pubkey_der(&crt->pk, der, sizeof(der));
+  if (len <= 0) return false;
+
+  unsigned char hash[32];
+  if (mbedtls_sha256(der + sizeof(der) - len, len, hash, 0) != 0) return false;
+
+  for (size_t i = 0; i < sizeof(s_pins) / sizeof(s_pins[0]); i++) {
+    if (memcmp(hash, s_pins[i], sizeof(hash)) == 0) return true;
+  }
+  return false;
+}
+
+// Com a ca_chain vazia, o mbedTLS marca NOT_TRUSTED no topo da cadeia recebida; as assinaturas entre
+// os certificados de baixo já foram conferidas por ele. Aceita a cadeia se esse topo tem a chave fixada.
+static int tls_pin_verify(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+  if ((*flags & MBEDTLS_X509_BADCERT_NOT_TRUSTED) == 0) {
+    return 0;
+  }
+  if (spki_pinned(crt)) {
+    // Como o esp_crt_bundle: a validade não é checada porque o SNTP pode não ter sincronizado ainda
+    *flags = 0;
+  } else {
+    ESP_LOGE(TAG_TLS, "Chave pública do certificado (profundidade %d) não está fixada", depth);
+  }
+  return 0;
+}
+
+// Entra no lugar de esp_crt_bundle_attach: o esp-tls nos entrega a mbedtls_ssl_config do cliente
+static esp_err_t tls_pin_attach(void *conf)
+{
+  mbedtls_ssl_config *ssl_conf = (mbedtls_ssl_config *)conf;
+
+  // Mesmo truque do esp_crt_bundle_attach: um certificado zerado passa na checagem de ca_chain não nula
+  // e não é pai de ninguém, então a confiança fica toda com tls_pin_verify
+  mbedtls_x509_crt_init(&s_empty_ca);
+  mbedtls_ssl_conf_ca_chain(ssl_conf, &s_empty_ca, NULL);
+  mbedtls_ssl_conf_authmode(ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+  mbedtls_ssl_conf_verify(ssl_conf, tls_pin_verify, NULL);
+  // Registros de até 4 KB nos dois sentidos, se o broker aceitar a extensão
+  mbedtls_ssl_conf_max_frag_len(ssl_conf, MBEDTLS_SSL_MAX_FRAG_LEN_4096);
+  return ESP_OK;
+}
+
+#endif // TLS_PROFILE_PINNED
+
+// -----------------------------------------------------------------------------------------------------------
+// PERFIL PSK
+// -----------------------------------------------------------------------------------------------------------
+
+#if TLS_PROFILE == TLS_PROFILE_PSK
+
+#if !defined(TLS_PSK_IDENTITY) || !defined(TLS_PSK_KEY)
+#error "TLS_PROFILE_PSK exige TLS_PSK_IDENTITY e TLS_PSK_KEY (ver tls_profile.h)"
+#endif
+
+static const uint8_t s_psk_key[] = TLS_PSK_KEY;
+
+static const psk_hint_key_t s_psk = {
+  .key = s_psk_key,
+  .key_size = sizeof(s_psk_key),
+  .hint = TLS_PSK_IDENTITY,
+};
+
+static const int s_ciphersuites[] = {
+  MBEDTLS_TLS_PSK_WITH_AES_128_GCM_SHA256,
+  MBEDTLS_TLS_PSK_WITH_AES_128_CBC_SHA256,
+  0
+};
+
+#endif // TLS_PROFILE_PSK
+
+// -----------------------------------------------------------------------------------------------------------
+// API
+// -----------------------------------------------------------------------------------------------------------
+
+static const char *profile_name(void)
+{
+#if TLS_PROFILE == TLS_PROFILE_PINNED
+  return "pinned";
+#elif TLS_PROFILE == TLS_PROFILE_PSK
+  return "psk";
+#else
+  return "bundle";
+#endif
+}
+
+void tls_profile_apply(esp_mqtt_client_config_t *cfg)
+{
+#if TLS_PROFILE == TLS_PROFILE_PINNED
+  cfg->broker.verification.crt_bundle_attach = tls_pin_attach;
+  cfg->broker.verification.ciphersuites_list = s_ciphersuites;
+#elif TLS_PROFILE == TLS_PROFILE_PSK
+  cfg->broker.verification.psk_hint_key = &s_psk;
+  cfg->broker.verification.ciphersuites_list = s_ciphersuites;
+#else
+  cfg->broker.verification.crt_bundle_attach = esp_crt_bundle_attach;
+#endif
+  ESP_LOGI(TAG_TLS, "Perfil TLS: %s", profile_name());
+}
+
+void tls_profile_on_before_connect(void)
+{
+  s_connect_us = esp_timer_get_time();
+  s_free_before = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+}
+
+void tls_profile_on_connected(void)
+{
+  if (s_connect_us == 0) return;
+
+  uint32_t ms = (uint32_t)((esp_timer_get_time() - s_connect_us) / 1000);
+  s_connect_us = 0;
+
+  // A marca d'água mínima é global desde o boot: se a conexão não a baixou, o valor é um limite superior
+  size_t free_after = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+  size_t min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+  uint32_t peak = s_free_before > min_free ? (uint32_t)(s_free_before - min_free) : 0;
+
+  s_handshakes++;
+  s_last_ms = ms;
+  if (ms < s_min_ms) s_min_ms = ms;
+  if (ms > s_max_ms) s_max_ms = ms;
+  if (peak > s_heap_peak) s_heap_peak = peak;
+  s_heap_session = s_free_before > free_after ? (uint32_t)(s_free_before - free_after) : 0;
+
+  ESP_LOGI(TAG_TLS, "Conectado em %" PRIu32 " ms (heap: pico %" PRIu32 " B, sessão %" PRIu32 " B)",
+           ms, peak, s_heap_session);
+}
+
+void tls_profile_get_stats(tls_stats_t *stats)
+{
+  stats->profile = profile_name();
+  stats->handshakes = s_handshakes;
+  stats->handshake_last_ms = s_last_ms;
+  stats->handshake_min_ms = s_handshakes ? s_min_ms : 0;
+  stats->handshake_max_ms = s_max_ms;
+  stats->heap_peak = s_heap_peak;
+  stats->heap_session = s_heap_session;
+}
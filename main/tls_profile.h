@@ -0,0 +1,58 @@
+#ifndef TLS_PROFILE_H
+#define TLS_PROFILE_H
+
+#include <stdint.h>
+#include "mqtt_client.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// PERFIL TLS
+//
+// O bundle completo da Mozilla verifica o broker contra ~150 CAs para mandar payloads de poucos bytes.
+// O perfil fixado confia só na chave pública do nosso broker (SHA-256 do SubjectPublicKeyInfo), pede
+// max fragment length de 4 KB e limita as cifras a ECDHE + AES-128-GCM, que usam o AES e o MPI em
+// hardware do ESP32. O perfil PSK dispensa certificados (broker local, p.ex. mosquitto com psk_hint).
+// Os buffers do mbedTLS ficam em sdkconfig.defaults. Tempo de handshake e pico de heap de cada
+// conexão saem em /api/stats.
+// -----------------------------------------------------------------------------------------------------------
+
+#define TLS_PROFILE_BUNDLE    0   // bundle de CAs do IDF (comportamento original)
+#define TLS_PROFILE_PINNED    1   // chave pública do broker fixada
+#define TLS_PROFILE_PSK       2   // TLS-PSK, sem certificados
+
+#ifndef TLS_PROFILE
+#define TLS_PROFILE           TLS_PROFILE_BUNDLE
+#endif
+
+// Hashes aceitos no perfil fixado, como inicializadores de uint8_t[32]. A chave pode ser a do próprio
+// broker (certificado autoassinado) ou a do certificado no topo da cadeia que ele envia. Para obter:
+//   openssl s_client -connect <broker>:8883 -showcerts </dev/null | openssl x509 -pubkey -noout |
+//   openssl pkey -pubin -outform der | openssl dgst -sha256 -c
+// Deixe mais de um durante uma troca de certificado.
+// #define TLS_PINNED_SPKI_SHA256  { 0x00, ... }, { 0x00, ... }
+
+// Perfil PSK: identidade e chave compartilhadas com o broker (psk_file do mosquitto, em hex)
+// #define TLS_PSK_IDENTITY  "warehouse-monitor"
+// #define TLS_PSK_KEY       { 0x00, ... }
+
+#define TLS_SPKI_DER_MAX      600   // SPKI de RSA-4096 cabe com folga
+
+typedef struct {
+  const char *profile;
+  uint32_t handshakes;
+  uint32_t handshake_last_ms;   // BEFORE_CONNECT -> CONNECTED: TCP + TLS + CONNECT/CONNACK
+  uint32_t handshake_min_ms;
+  uint32_t handshake_max_ms;
+  uint32_t heap_peak;           // maior queda de heap livre durante uma conexão
+  uint32_t heap_session;        // heap que continua ocupado depois da última conexão
+} tls_stats_t;
+
+// Preenche a parte de verificação do broker conforme TLS_PROFILE
+void tls_profile_apply(esp_mqtt_client_config_t *cfg);
+
+// Chamados pelo handler MQTT em MQTT_EVENT_BEFORE_CONNECT e MQTT_EVENT_CONNECTED
+void tls_profile_on_before_connect(void);
+void tls_profile_on_connected(void);
+
+void tls_profile_get_stats(tls_stats_t *stats);
+
+#endif // TLS_PROFILE_H
@@ -0,0 +1,110 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "worker.h"
+
+static const char *TAG_WORKER = "SAIDA";
+
+typedef struct {
+  worker_fn_t fn;
+  int64_t posted_us;
+  int64_t data[(WORKER_DATA_MAX + 7) / 8];   // alinhado para structs com int64_t
+} worker_item_t;
+
+static QueueHandle_t s_queue = NULL;
+static QueueHandle_t s_urgent = NULL;
+static SemaphoreHandle_t s_pending = NULL;   // um "give" por item postado, em qualquer das filas
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t s_runs = 0;
+static uint32_t s_dropped = 0;
+static uint32_t s_queue_max = 0;
+static uint64_t s_latency_sum_us = 0;
+static uint32_t s_latency_max_us = 0;
+static uint64_t s_run_sum_us = 0;
+static uint32_t s_run_max_us = 0;
+
+static void worker_task(void *arg)
+{
+  worker_item_t item;
+
+  for (;;) {
+    if (xSemaphoreTake(s_pending, portMAX_DELAY) != pdTRUE) continue;
+    if (xQueueReceive(s_urgent, &item, 0) != pdTRUE && xQueueReceive(s_queue, &item, 0) != pdTRUE) continue;
+
+    int64_t start_us = esp_timer_get_time();
+    item.fn(item.data);
+    int64_t end_us = esp_timer_get_time();
+
+    uint32_t latency_us = start_us - item.posted_us;
+    uint32_t run_us = end_us - start_us;
+    portENTER_CRITICAL(&s_lock);
+    s_runs++;
+    s_latency_sum_us += latency_us;
+    if (latency_us > s_latency_max_us) s_latency_max_us = latency_us;
+    s_run_sum_us += run_us;
+    if (run_us > s_run_max_us) s_run_max_us = run_us;
+    portEXIT_CRITICAL(&s_lock);
+  }
+}
+
+esp_err_t worker_init(UBaseType_t priority, BaseType_t core)
+{
+  s_queue = xQueueCreate(WORKER_QUEUE_SIZE, sizeof(worker_item_t));
+  s_urgent = xQueueCreate(WORKER_URGENT_SIZE, sizeof(worker_item_t));
+  s_pending = xSemaphoreCreateCounting(WORKER_QUEUE_SIZE + WORKER_URGENT_SIZE, 0);
+  if (s_queue == NULL || s_urgent == NULL || s_pending == NULL) return ESP_ERR_NO_MEM;
+  if (xTaskCreatePinnedToCore(worker_task, "saida", WORKER_TASK_STACK, NULL, priority, NULL, core) != pdPASS) {
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+static bool post(worker_fn_t fn, const void *data, size_t len, bool urgent)
+{
+  worker_item_t item = { .fn = fn, .posted_us = esp_timer_get_time() };
+
+  if (s_queue == NULL || len > WORKER_DATA_MAX) return false;
+  memcpy(item.data, data, len);
+
+  // O item entra na fila antes do "give": a task que acorda sempre acha alguma coisa
+  bool ok = xQueueSendToBack(urgent ? s_urgent : s_queue, &item, 0) == pdTRUE;
+  if (ok) xSemaphoreGive(s_pending);
+  uint32_t waiting = uxQueueMessagesWaiting(s_queue) + uxQueueMessagesWaiting(s_urgent);
+  portENTER_CRITICAL(&s_lock);
+  if (!ok) s_dropped++;
+  if (waiting > s_queue_max) s_queue_max = waiting;
+  portEXIT_CRITICAL(&s_lock);
+
+  if (!ok) ESP_LOGW(TAG_WORKER, "Fila cheia: item descartado");
+  return ok;
+}
+
+bool worker_post(worker_fn_t fn, const void *data, size_t len)
+{
+  return post(fn, data, len, false);
+}
+
+bool worker_post_urgent(worker_fn_t fn, const void *data, size_t len)
+{
+  return post(fn, data, len, true);
+}
+
+void worker_get_stats(worker_stats_t *stats)
+{
+  portENTER_CRITICAL(&s_lock);
+  *stats = (worker_stats_t) {
+    .runs = s_runs,
+    .dropped = s_dropped,
+    .queue_max = s_queue_max,
+    .latency_avg_us = s_runs ? (uint32_t)(s_latency_sum_us / s_runs) : 0,
+    .latency_max_us = s_latency_max_us,
+    .run_avg_us = s_runs ? (uint32_t)(s_run_sum_us / s_runs) : 0,
+    .run_max_us = s_run_max_us,
+  };
+  portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,49 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// -----------------------------------------------------------------------------------------------------------
+// TASK DE SAÍDA
+//
+// O que pode bloquear e não cabe no loop do agendador (sched.h): gravação no histórico em flash, que
+// apaga setores de 4 KB por centenas de ms, e publicações, que esperam o mutex do publisher e o lock do
+// esp-mqtt enquanto a task do MQTT escreve no socket. O agendador posta uma cópia dos dados e segue; a
+// função roda aqui, em ordem de chegada. Alarmes têm uma fila própria, também em ordem de chegada, que a
+// task esvazia antes da normal. Com a fila cheia o item é descartado e contado, sem esperar.
+// -----------------------------------------------------------------------------------------------------------
+
+#define WORKER_QUEUE_SIZE   16
+#define WORKER_URGENT_SIZE  8      // alarmes: ativo + normalizado das duas métricas, com folga para uma
+                                   // gravação lenta no histórico
+#define WORKER_DATA_MAX     304    // maior item: mensagem com o JSON de saúde do sensor (main.c)
+#define WORKER_TASK_STACK   4096   // publica, formata float e grava na flash
+
+typedef void (*worker_fn_t)(const void *data);
+
+typedef struct {
+  uint32_t runs;
+  uint32_t dropped;           // fila cheia
+  uint32_t queue_max;         // maior ocupação vista ao postar, somando as duas filas
+  uint32_t latency_avg_us;    // post -> início da função
+  uint32_t latency_max_us;
+  uint32_t run_avg_us;
+  uint32_t run_max_us;
+} worker_stats_t;
+
+// Cria a fila e a task; chamar uma vez, antes de worker_post()
+esp_err_t worker_init(UBaseType_t priority, BaseType_t core);
+
+// Copia len bytes de data e agenda fn(cópia) na task de saída; false se a fila estiver cheia
+bool worker_post(worker_fn_t fn, const void *data, size_t len);
+// Mesmo que worker_post(), mas na fila urgente: passa na frente das gravações pendentes no histórico e
+// mantém a ordem entre os urgentes (o "normalizado" de um alarme nunca sai antes do "ativo")
+bool worker_post_urgent(worker_fn_t fn, const void *data, size_t len);
+
+void worker_get_stats(worker_stats_t *stats);
+
+#endif // WORKER_H
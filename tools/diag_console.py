@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""Roda comandos na console de diagnóstico da UART e junta as respostas num JSON só.
+
+Cada comando é enviado como uma linha; a resposta é a primeira linha que começa com '{' ou '[' depois
+do envio (o log do firmware e o eco da REPL no meio são ignorados). Sai com código 1 se algum comando
+responder {"error":..} ou não responder dentro de --timeout segundos.
+
+    python tools/diag_console.py --port /dev/ttyUSB0 stats "bench sensor 20" "bench publish 200 1"
+    python tools/diag_console.py --out antes.json "config set filter_k=4" "config get"
+"""
+
+import argparse
+import json
+import sys
+import time
+
+import serial
+
+
+def run(port, command, timeout):
+    port.reset_input_buffer()
+    port.write(command.encode() + b"\r\n")
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        raw = port.readline()
+        if not raw:
+            continue
+        # O prompt "diag>" pode vir grudado na frente da resposta
+        line = raw.decode(errors="replace").strip()
+        start = min((i for i in (line.find("{"), line.find("[")) if i >= 0), default=-1)
+        if start < 0:
+            continue
+        try:
+            return json.loads(line[start:])
+        except json.JSONDecodeError:
+            continue
+    return {"error": f"sem resposta em {timeout:.0f} s"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("commands", nargs="+", help="comandos da console, um por argumento")
+    parser.add_argument("--port", default="/dev/ttyUSB0")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=120.0, help="segundos de espera por comando")
+    parser.add_argument("--out", help="grava o resultado neste arquivo em vez da saída padrão")
+    args = parser.parse_args()
+
+    results = []
+    failed = False
+    with serial.Serial(args.port, args.baud, timeout=0.5) as port:
+        for command in args.commands:
+            reply = run(port, command, args.timeout)
+            failed |= isinstance(reply, dict) and "error" in reply
+            results.append({"command": command, "reply": reply})
+
+    text = json.dumps(results, indent=2, ensure_ascii=False)
+    if args.out:
+        with open(args.out, "w", encoding="utf-8") as out:
+            out.write(text + "\n")
+    else:
+        print(text)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
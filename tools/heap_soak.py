@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""Soak de heap: acompanha /api/stats por horas e falha se o heap vazar ou fragmentar.
+
+Lê heap.free, heap.largest_block e o pool do outbox a cada --interval segundos. Descarta o
+aquecimento (--warmup), ajusta uma reta ao heap livre e termina com código 1 se a tendência passar de
+--max-growth bytes/hora ou se o maior bloco livre cair mais que --max-fragment bytes. Roda igual contra
+a placa ou contra o firmware no QEMU (com a porta 80 redirecionada).
+
+    python tools/heap_soak.py --url http://192.168.0.50 --hours 12
+"""
+
+import argparse
+import json
+import sys
+import time
+import urllib.request
+
+
+def fetch(url):
+    with urllib.request.urlopen(f"{url}/api/stats", timeout=10) as response:
+        return json.load(response)
+
+
+def slope_per_hour(samples):
+    """Mínimos quadrados de (segundos, bytes) -> bytes/hora."""
+    n = len(samples)
+    mean_t = sum(t for t, _ in samples) / n
+    mean_v = sum(v for _, v in samples) / n
+    num = sum((t - mean_t) * (v - mean_v) for t, v in samples)
+    den = sum((t - mean_t) ** 2 for t, _ in samples)
+    return num / den * 3600 if den else 0.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--url", default="http://192.168.4.1")
+    parser.add_argument("--hours", type=float, default=12.0)
+    parser.add_argument("--interval", type=float, default=30.0, help="segundos entre leituras")
+    parser.add_argument("--warmup", type=float, default=600.0, help="segundos ignorados no início")
+    parser.add_argument("--max-growth", type=float, default=64.0, help="queda de heap livre aceita, em bytes/hora")
+    parser.add_argument("--max-fragment", type=int, default=1024, help="queda aceita do maior bloco livre, em bytes")
+    args = parser.parse_args()
+
+    start = time.monotonic()
+    free = []
+    largest = []
+    errors = 0
+
+    print(f"{'tempo':>8} {'livre':>8} {'mínimo':>8} {'maior':>8} {'pool':>9} {'recusas':>7}")
+    while time.monotonic() - start < args.hours * 3600:
+        try:
+            stats = fetch(args.url)
+        except OSError as exc:
+            errors += 1
+            print(f"falha ao ler {args.url}: {exc}", file=sys.stderr)
+        else:
+            elapsed = time.monotonic() - start
+            heap, pool = stats["heap"], stats["pool"]
+            print(f"{elapsed:>7.0f}s {heap['free']:>8} {heap['min_free']:>8} {heap['largest_block']:>8} "
+                  f"{pool['used']:>4}/{pool['slots']:<4} {pool['rejected']:>7}")
+            if elapsed >= args.warmup:
+                free.append((elapsed, heap["free"]))
+                largest.append(heap["largest_block"])
+        time.sleep(args.interval)
+
+    if len(free) < 3:
+        print("amostras insuficientes depois do aquecimento", file=sys.stderr)
+        return 1
+
+    growth = -slope_per_hour(free)
+    fragment = largest[0] - min(largest)
+    print(f"\nperda de heap: {growth:.1f} B/h (limite {args.max_growth})")
+    print(f"queda do maior bloco: {fragment} B (limite {args.max_fragment})")
+    print(f"leituras com erro: {errors}")
+
+    ok = growth <= args.max_growth and fragment <= args.max_fragment
+    print("OK" if ok else "FALHOU")
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
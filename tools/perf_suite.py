@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+"""Suíte de desempenho ponta a ponta: mede o firmware rodando e compara com uma referência.
+
+`run` espera o dispositivo (placa ou QEMU) publicar pela primeira vez e coleta:
+  - boot até a primeira publicação (perf.first_publish_ms, relógio do próprio dispositivo);
+  - vazão em saturação: baixa interval_min/max via /api/config durante --window segundos e conta o
+    que chega no broker em +/umidade e +/temperatura (use o backend sintético do sensor);
+  - menor heap livre, pico de heap do TLS e folga de pilha de cada task (/api/tasks);
+  - tempo de reconexão, se --reconnect-cmd derrubar o broker (ex.: "docker restart mosquitto");
+  - CPU por amostra (perf.sample_us: leitura + alarmes + publicação, sem a espera);
+  - atraso máximo de cada trabalho do agendador, do disparo do timer até a callback (/api/jobs).
+O resultado vai em JSON; --launch sobe o alvo antes (ex.: o QEMU do IDF com a porta 80 redirecionada).
+Para comparar TLS e texto puro, rode uma vez com cada build do firmware e rotule com --label.
+
+`compare` confronta dois JSON e termina com 1 se alguma métrica piorar além de --tolerance %.
+
+    pip install paho-mqtt
+    python tools/perf_suite.py run --url http://localhost:8080 --broker localhost --label plain --out perf.json
+    python tools/perf_suite.py compare perf_baseline.json perf.json
+"""
+
+import argparse
+import json
+import shlex
+import subprocess
+import sys
+import time
+import urllib.parse
+import urllib.request
+
+import paho.mqtt.client as mqtt
+
+# Métrica -> direção boa. Folga de pilha entra como stack_free:<task> e atraso de trabalho como
+# job_latency_max_us:<trabalho>.
+DIRECTIONS = {
+    "boot_to_first_publish_ms": "lower",
+    "throughput_msgs_s": "higher",
+    "device_publish_rate": "higher",
+    "heap_min_free": "higher",
+    "tls_heap_peak": "lower",
+    "reconnect_ms": "lower",
+    "sample_us_avg": "lower",
+    "sample_us_max": "lower",
+}
+
+
+def get_json(url, path):
+    with urllib.request.urlopen(f"{url}{path}", timeout=10) as response:
+        return json.load(response)
+
+
+def post_config(url, **fields):
+    body = urllib.parse.urlencode(fields).encode()
+    request = urllib.request.Request(f"{url}/api/config", data=body, method="POST",
+                                     headers={"Content-Type": "application/x-www-form-urlencoded"})
+    with urllib.request.urlopen(request, timeout=10) as response:
+        return json.load(response)
+
+
+def wait_first_publish(url, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        try:
+            stats = get_json(url, "/api/stats")
+            if stats["perf"]["first_publish_ms"]:
+                return stats
+        except OSError:
+            pass
+        time.sleep(1)
+    raise TimeoutError(f"{url} não publicou em {timeout} s")
+
+
+def measure_throughput(args):
+    received = 0
+
+    def on_connect(client, userdata, flags, reason_code, properties=None):
+        client.subscribe([("+/umidade", 1), ("+/temperatura", 1)])
+
+    def on_message(client, userdata, msg):
+        nonlocal received
+        received += 1
+
+    client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    if args.username:
+        client.username_pw_set(args.username, args.password)
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(args.broker, args.port)
+    client.loop_start()
+
+    original = get_json(args.url, "/api/config")
+    try:
+        post_config(args.url, interval_min=args.saturate_ms, interval_max=args.saturate_ms)
+        time.sleep(2)  # o amostrador reinicia com os limites novos
+        before = get_json(args.url, "/api/stats")["mqtt"]["msgs"]
+        received = 0
+        time.sleep(args.window)
+        after = get_json(args.url, "/api/stats")["mqtt"]["msgs"]
+        broker_rate = received / args.window
+    finally:
+        post_config(args.url, interval_min=original["interval_min"], interval_max=original["interval_max"])
+        client.loop_stop()
+        client.disconnect()
+
+    return broker_rate, (after - before) / args.window
+
+
+def measure_reconnect(args):
+    before = get_json(args.url, "/api/stats")["perf"]["reconnects"]
+    subprocess.run(shlex.split(args.reconnect_cmd), check=True)
+    deadline = time.monotonic() + args.timeout
+    while time.monotonic() < deadline:
+        time.sleep(1)
+        try:
+            perf = get_json(args.url, "/api/stats")["perf"]
+        except OSError:
+            continue
+        if perf["reconnects"] > before:
+            return perf["reconnect_ms"][0]
+    raise TimeoutError(f"sem reconexão em {args.timeout} s")
+
+
+def run(args):
+    target = subprocess.Popen(shlex.split(args.launch)) if args.launch else None
+    try:
+        stats = wait_first_publish(args.url, args.timeout)
+        metrics = {"boot_to_first_publish_ms": stats["perf"]["first_publish_ms"]}
+
+        broker_rate, device_rate = measure_throughput(args)
+        metrics["throughput_msgs_s"] = round(broker_rate, 2)
+        metrics["device_publish_rate"] = round(device_rate, 2)
+
+        if args.reconnect_cmd:
+            metrics["reconnect_ms"] = measure_reconnect(args)
+
+        stats = get_json(args.url, "/api/stats")
+        metrics["heap_min_free"] = stats["heap"]["min_free"]
+        metrics["tls_heap_peak"] = stats["tls"]["heap_peak"]
+        metrics["sample_us_avg"], metrics["sample_us_max"] = stats["perf"]["sample_us"]
+
+        try:
+            for task in get_json(args.url, "/api/tasks"):
+                metrics[f"stack_free:{task['name']}"] = task["stack_free"]
+        except OSError as exc:
+            print(f"/api/tasks indisponível ({exc}); folga de pilha fica de fora", file=sys.stderr)
+
+        for job in get_json(args.url, "/api/jobs"):
+            metrics[f"job_latency_max_us:{job['name']}"] = job["latency_us"][1]
+    finally:
+        if target:
+            target.terminate()
+            target.wait()
+
+    result = {"label": args.label, "time": int(time.time()), "metrics": metrics}
+    text = json.dumps(result, indent=2, sort_keys=True)
+    if args.out:
+        with open(args.out, "w") as f:
+            f.write(text + "\n")
+    print(text)
+    return 0
+
+
+def compare(args):
+    with open(args.baseline) as f:
+        baseline = json.load(f)["metrics"]
+    with open(args.current) as f:
+        current = json.load(f)["metrics"]
+
+    regressions = 0
+    print(f"{'métrica':<32} {'referência':>12} {'atual':>12} {'variação':>9}")
+    for name in sorted(set(baseline) & set(current)):
+        if name.startswith("stack_free:"):
+            direction = "higher"
+        elif name.startswith("job_latency_max_us:"):
+            direction = "lower"
+        else:
+            direction = DIRECTIONS.get(name)
+        if direction is None:
+            continue
+        old, new = baseline[name], current[name]
+        change = (new - old) / old * 100 if old else 0.0
+        worse = change < -args.tolerance if direction == "higher" else change > args.tolerance
+        regressions += worse
+        print(f"{name:<32} {old:>12} {new:>12} {change:>+8.1f}%{'  PIOROU' if worse else ''}")
+
+    for name in sorted(set(baseline) - set(current)):
+        print(f"{name:<32} ausente na medição atual")
+
+    print("OK" if not regressions else f"{regressions} métrica(s) pioraram mais de {args.tolerance}%")
+    return 1 if regressions else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    run_parser = sub.add_parser("run", help="mede o dispositivo")
+    run_parser.add_argument("--url", default="http://192.168.4.1")
+    run_parser.add_argument("--broker", default="localhost")
+    run_parser.add_argument("--port", type=int, default=1883)
+    run_parser.add_argument("--username")
+    run_parser.add_argument("--password")
+    run_parser.add_argument("--label", default="")
+    run_parser.add_argument("--out")
+    run_parser.add_argument("--launch", help="comando que sobe o alvo (QEMU ou flash + monitor)")
+    run_parser.add_argument("--reconnect-cmd", help="comando que derruba e sobe o broker")
+    run_parser.add_argument("--saturate-ms", type=int, default=5, help="intervalo de amostragem na saturação")
+    run_parser.add_argument("--window", type=float, default=30.0, help="segundos de saturação")
+    run_parser.add_argument("--timeout", type=float, default=120.0)
+    run_parser.set_defaults(func=run)
+
+    compare_parser = sub.add_parser("compare", help="compara com a referência")
+    compare_parser.add_argument("baseline")
+    compare_parser.add_argument("current")
+    compare_parser.add_argument("--tolerance", type=float, default=10.0, help="piora aceita, em %%")
+    compare_parser.set_defaults(func=compare)
+
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
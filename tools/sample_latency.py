@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""Latência ponta a ponta das amostras, a partir dos carimbos de tempo gravados pelo dispositivo.
+
+Com stamps=1 em /api/config, cada registro de amostra (raw, seq ou agregado) carrega o instante em que
+a leitura saiu do sensor (a), o instante em que o registro foi entregue ao publisher (e) e há quantos
+segundos o SNTP acertou o relógio pela última vez (s). Este script assina os tópicos de amostra num
+broker local e usa o horário de chegada aqui como horário do broker (no mesmo host, a diferença é de
+fração de ms). Para cada dispositivo calcula as distribuições leitura->broker e entrega->broker
+(p50/p99/max).
+
+Relógios: dispositivo e host são acertados por SNTP/NTP, então a diferença entre eles fica dentro de
+  margem = --sntp-error-ms + s * --drift-ppm / 1000
+(erro de um acerto SNTP mais a deriva do cristal desde o último acerto, com o maior s visto). Além
+disso estima-se o desvio real pelo envelope inferior: o menor entrega->broker observado não pode ser
+menor que --floor-ms, então desvio = --floor-ms - min(entrega->broker). Um desvio estimado fora da
+margem marca o dispositivo com "RELÓGIO"; --correct subtrai o desvio estimado em vez de confiar no SNTP.
+
+--slo-acq-p99-ms / --slo-enq-p99-ms transformam a medição em critério de aceitação: termina com 1 se
+algum dispositivo passar do limite. Registros sem carimbo (stamps=0 ou reenvio por NACK) são contados e
+ignorados.
+
+    pip install paho-mqtt
+    curl -d stamps=1 http://192.168.4.1/api/config
+    python tools/sample_latency.py --broker localhost --duration 300 --slo-enq-p99-ms 250
+"""
+
+import argparse
+import json
+import math
+import sys
+import threading
+import time
+from collections import defaultdict
+
+import paho.mqtt.client as mqtt
+
+TOPICS = [("+/umidade", 1), ("+/temperatura", 1), ("+/umidade/agg", 1), ("+/temperatura/agg", 1)]
+
+
+def parse_stamps(payload):
+    """(a, e, s) de um registro, ou None se ele não tiver carimbos."""
+    text = payload.decode(errors="replace")
+    if text.startswith("{"):
+        try:
+            record = json.loads(text)
+        except ValueError:
+            return None
+        fields = record
+    else:
+        fields = {}
+        for part in text.split(";")[1:]:
+            key, _, value = part.partition("=")
+            fields[key] = value
+    try:
+        return int(fields["a"]), int(fields["e"]), int(fields["s"])
+    except (KeyError, ValueError):
+        return None
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    index = max(0, math.ceil(len(ordered) * p) - 1)
+    return ordered[index]
+
+
+class Device:
+    def __init__(self):
+        self.acq = []      # chegada - a, em ms, sem correção
+        self.enq = []      # chegada - e
+        self.max_age_s = -1
+        self.unsynced = 0
+
+
+def collect(args):
+    devices = defaultdict(Device)
+    missing = 0
+    lock = threading.Lock()
+
+    def on_connect(client, userdata, flags, reason_code, properties=None):
+        client.subscribe(TOPICS)
+
+    def on_message(client, userdata, msg):
+        nonlocal missing
+        arrival_ms = time.time() * 1000
+        stamps = parse_stamps(msg.payload)
+        mac = msg.topic.split("/", 1)[0]
+        with lock:
+            if stamps is None:
+                missing += 1
+                return
+            acquired, enqueued, age = stamps
+            device = devices[mac]
+            device.acq.append(arrival_ms - acquired)
+            device.enq.append(arrival_ms - enqueued)
+            if age < 0:
+                device.unsynced += 1
+            device.max_age_s = max(device.max_age_s, age)
+
+    client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    if args.username:
+        client.username_pw_set(args.username, args.password)
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(args.broker, args.port)
+    client.loop_start()
+    try:
+        time.sleep(args.duration)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        client.loop_stop()
+        client.disconnect()
+
+    return devices, missing
+
+
+def analyze(args, mac, device):
+    margin = args.sntp_error_ms + max(device.max_age_s, 0) * args.drift_ppm / 1000
+    offset = args.floor_ms - min(device.enq)
+    suspect = device.unsynced > 0 or abs(offset) > margin
+    shift = offset if args.correct else 0.0
+    acq = [v + shift for v in device.acq]
+    enq = [v + shift for v in device.enq]
+    return {
+        "device": mac,
+        "n": len(enq),
+        "acq_ms": [percentile(acq, 0.50), percentile(acq, 0.99), max(acq)],
+        "enq_ms": [percentile(enq, 0.50), percentile(enq, 0.99), max(enq)],
+        "sync_age_s": device.max_age_s,
+        "margin_ms": margin,
+        "offset_ms": offset,
+        "suspect": suspect,
+        "unsynced": device.unsynced,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--broker", default="localhost")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--username")
+    parser.add_argument("--password")
+    parser.add_argument("--duration", type=float, default=60.0, help="segundos de coleta")
+    parser.add_argument("--min-samples", type=int, default=10, help="dispositivos com menos registros ficam de fora")
+    parser.add_argument("--sntp-error-ms", type=float, default=50.0, help="erro de um acerto SNTP pela internet")
+    parser.add_argument("--drift-ppm", type=float, default=40.0, help="deriva do cristal entre acertos")
+    parser.add_argument("--floor-ms", type=float, default=0.0, help="menor entrega->broker fisicamente possível")
+    parser.add_argument("--correct", action="store_true", help="corrige pelo desvio estimado em vez de confiar no SNTP")
+    parser.add_argument("--slo-acq-p99-ms", type=float, help="limite de p99 leitura->broker")
+    parser.add_argument("--slo-enq-p99-ms", type=float, help="limite de p99 entrega->broker")
+    parser.add_argument("--json", help="grava o resultado por dispositivo neste arquivo")
+    args = parser.parse_args()
+
+    devices, missing = collect(args)
+    results = [analyze(args, mac, device) for mac, device in sorted(devices.items())
+               if len(device.enq) >= args.min_samples]
+    if missing:
+        print(f"{missing} registro(s) sem carimbo ignorados (stamps=0 ou reenvio por NACK)", file=sys.stderr)
+    if not results:
+        print(f"nenhum dispositivo com {args.min_samples}+ registros carimbados em {args.duration:.0f} s",
+              file=sys.stderr)
+        return 2
+
+    violations = 0
+    print(f"{'dispositivo':<18} {'n':>6} {'leit. p50':>9} {'p99':>8} {'max':>8} {'entr. p50':>9} {'p99':>8} "
+          f"{'max':>8} {'sync s':>7} {'margem':>7} {'desvio':>8}")
+    for r in results:
+        acq_p50, acq_p99, acq_max = r["acq_ms"]
+        enq_p50, enq_p99, enq_max = r["enq_ms"]
+        flags = []
+        if r["suspect"]:
+            flags.append("RELÓGIO")
+        if args.slo_acq_p99_ms is not None and acq_p99 > args.slo_acq_p99_ms:
+            flags.append("SLO leitura")
+        if args.slo_enq_p99_ms is not None and enq_p99 > args.slo_enq_p99_ms:
+            flags.append("SLO entrega")
+        violations += any(f.startswith("SLO") for f in flags)
+        print(f"{r['device']:<18} {r['n']:>6} {acq_p50:>9.1f} {acq_p99:>8.1f} {acq_max:>8.1f} {enq_p50:>9.1f} "
+              f"{enq_p99:>8.1f} {enq_max:>8.1f} {r['sync_age_s']:>7} {r['margin_ms']:>7.1f} {r['offset_ms']:>+8.1f}"
+              f"{'  ' + ', '.join(flags) if flags else ''}")
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"time": int(time.time()), "corrected": args.correct, "devices": results}, f, indent=2)
+
+    if args.slo_acq_p99_ms is not None or args.slo_enq_p99_ms is not None:
+        print("SLO: ok" if not violations else f"SLO: {violations} dispositivo(s) fora do limite")
+    return 1 if violations else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Consumidor das amostras QoS 0 com sequência (delivery=seq).
+
+Assina <mac>/umidade e <mac>/temperatura de todos os dispositivos, acompanha a sequência de cada um
+e imprime periodicamente perdas, reordenações e duplicatas. Com --nack, pede reenvio dos buracos em
+<mac>/nack.
+
+    pip install paho-mqtt
+    python tools/seq_monitor.py --host localhost --nack
+"""
+
+import argparse
+import time
+
+import paho.mqtt.client as mqtt
+
+METRICS = ("umidade", "temperatura")
+
+
+class Device:
+    def __init__(self, epoch):
+        self.epoch = epoch
+        self.highest = 0
+        self.missing = set()
+        self.received = 0
+        self.lost = 0
+        self.reordered = 0
+        self.duplicates = 0
+
+    def on_sample(self, seq):
+        self.received += 1
+        if seq > self.highest:
+            if self.highest and seq > self.highest + 1:
+                gap = range(self.highest + 1, seq)
+                self.missing.update(gap)
+                self.lost += len(gap)
+            self.highest = seq
+        elif seq in self.missing:
+            # Chegou atrasada (reordenação) ou pelo reenvio do NACK
+            self.missing.discard(seq)
+            self.lost -= 1
+            self.reordered += 1
+        else:
+            self.duplicates += 1
+
+    def missing_ranges(self):
+        """Buracos agrupados em faixas contíguas (de, até)."""
+        ranges = []
+        for seq in sorted(self.missing):
+            if ranges and seq == ranges[-1][1] + 1:
+                ranges[-1][1] = seq
+            else:
+                ranges.append([seq, seq])
+        return ranges
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="localhost")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--username")
+    parser.add_argument("--password")
+    parser.add_argument("--interval", type=float, default=10.0, help="segundos entre relatórios")
+    parser.add_argument("--nack", action="store_true", help="pede reenvio dos buracos detectados")
+    args = parser.parse_args()
+
+    devices = {}
+
+    def on_connect(client, userdata, flags, reason_code, properties=None):
+        for metric in METRICS:
+            client.subscribe(f"+/{metric}", qos=0)
+
+    def on_message(client, userdata, msg):
+        mac, _, metric = msg.topic.partition("/")
+        if metric not in METRICS:
+            return
+        try:
+            epoch, seq, _value = msg.payload.decode().split(",")
+            epoch, seq = int(epoch), int(seq)
+        except ValueError:
+            return  # publicação em modo qos1, sem sequência
+
+        dev = devices.get(mac)
+        if dev is None or epoch > dev.epoch:
+            # Boot novo: a sequência recomeça
+            dev = devices[mac] = Device(epoch)
+        elif epoch < dev.epoch:
+            return
+        dev.on_sample(seq)
+
+    def report(client):
+        print(f"{'dispositivo':<18} {'época':>5} {'recebidas':>9} {'perdidas':>8} {'perda%':>7} "
+              f"{'reordem':>7} {'duplic':>6}")
+        for mac, dev in sorted(devices.items()):
+            total = dev.received - dev.duplicates + dev.lost
+            loss = 100.0 * dev.lost / total if total else 0.0
+            print(f"{mac:<18} {dev.epoch:>5} {dev.received:>9} {dev.lost:>8} {loss:>6.2f}% "
+                  f"{dev.reordered:>7} {dev.duplicates:>6}")
+            if args.nack:
+                for start, end in dev.missing_ranges():
+                    client.publish(f"{mac}/nack", f"{dev.epoch},{start},{end}", qos=0)
+        print()
+
+    client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    if args.username:
+        client.username_pw_set(args.username, args.password)
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(args.host, args.port)
+    client.loop_start()
+
+    try:
+        while True:
+            time.sleep(args.interval)
+            report(client)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        client.loop_stop()
+
+
+if __name__ == "__main__":
+    main()